@@ -0,0 +1,71 @@
+/*--------------------------------------------------------
+                        bench_core.c
+
+     Laufzeitmessungen im Simulator fuer my_printf, die
+     Ausgabe auf 4-stelliger 7-Segmentanzeige und die
+     Temperaturberechnung des NTC-Thermometers
+
+     Aufruf aus diesem Verzeichnis:
+
+       make bench          : messen und mit bench_core.bench
+                             vergleichen
+       make bench-update   : Referenz neu schreiben
+
+     Compiler  : SDCC 4.0.3
+     MCU       : PFS154 / PFS173
+
+     R. Seelig
+
+  -------------------------------------------------------- */
+
+#include <stdint.h>
+#include "pdk_init.h"
+#include "pfs1xx_gpio.h"
+#include "my_printf.h"
+#include "seg7mpx_dig4.h"
+#include "ntc.h"
+#include "bench.h"
+
+volatile char benchout;
+volatile int16_t benchtemp;
+
+/* --------------------------------------------------------
+                          my_putchar
+
+     Ausgabe von my_printf, im Simulator ohne Hardware
+   -------------------------------------------------------- */
+void my_putchar(char ch)
+{
+  benchout= ch;
+}
+
+/* --------------------------------------------------------
+                              main
+   -------------------------------------------------------- */
+void main(void)
+{
+  seg7_pin_init();
+
+  BENCH(putint_zero,      putint(0, 0));
+  BENCH(putint_pos,       putint(12345, 0));
+  BENCH(putint_neg_komma, putint(-12345, 2));
+  BENCH(printf_text,      my_printf("Hallo Welt\n\r"));
+  BENCH(printf_int,       my_printf("T= %d", 1234));
+  BENCH(printf_hex,       my_printf("%x", 0xa5a5));
+  BENCH(printf_mixed,     printfkomma= 1; my_printf("%s: %k %c", "U", 1234, 'V'));
+
+  BENCH(hex2bcd16_small,  s7buf= hex2bcd16(7));
+  BENCH(hex2bcd16_max,    s7buf= hex2bcd16(9999));
+
+  // 4 Aufrufe = ein vollstaendiger Durchlauf des Multiplexens
+  BENCH(seg7_mpx_digit,   seg7_mpx());
+  BENCH(seg7_mpx_cycle,   seg7_mpx(); seg7_mpx(); seg7_mpx(); seg7_mpx());
+
+  // genau auf einem Stuetzpunkt, interpoliert bei positiver und negativer
+  // Temperatur
+  BENCH(ntc_gettemp_exact, benchtemp= ntc_gettemp(0x40));
+  BENCH(ntc_gettemp_pos,   benchtemp= ntc_gettemp(0x4f));
+  BENCH(ntc_gettemp_neg,   benchtemp= ntc_gettemp(0xfa));
+
+  bench_end();
+}
@@ -0,0 +1,54 @@
+/*--------------------------------------------------------
+                        bench_i2c.c
+
+     Laufzeitmessungen im Simulator fuer den Software-
+     I2C Bus, den zweiten Bus i2c_b (src/i2c_b.c) und
+     die Zeichenausgabe auf einem SSD1306 OLED-Display
+
+     Aufruf aus diesem Verzeichnis:
+
+       make bench          : messen und mit bench_i2c.bench
+                             vergleichen
+       make bench-update   : Referenz neu schreiben
+
+     Compiler  : SDCC 4.0.3
+     MCU       : PFS154 / PFS173
+
+     R. Seelig
+
+  -------------------------------------------------------- */
+
+#include <stdint.h>
+#include "pdk_init.h"
+#include "pfs1xx_gpio.h"
+#include "delay.h"
+#include "i2c.h"
+#include "oled1306_i2c.h"
+#include "bench.h"
+
+/* --------------------------------------------------------
+                              main
+   -------------------------------------------------------- */
+void main(void)
+{
+  i2c_master_init();
+  i2c_b_master_init();
+
+  BENCH(i2c_start,         i2c_start(0x78));
+  BENCH(i2c_write,         i2c_write(0x55));
+  BENCH(i2c_stop,          i2c_stop());
+
+  // derselbe Code aus src/i2c.c, fuer den zweiten Bus uebersetzt
+  BENCH(i2c_b_start,       i2c_b_start(0x78));
+  BENCH(i2c_b_write,       i2c_b_write(0x55));
+  BENCH(i2c_b_stop,        i2c_b_stop());
+
+  BENCH(oled_putchar,      oled_putchar('A'));
+  doublechar= 1;
+  BENCH(oled_putchar_dbl,  oled_putchar('A'));
+  doublechar= 0;
+  textcolor= 0;
+  BENCH(oled_putchar_inv,  oled_putchar('A'));
+
+  bench_end();
+}
@@ -0,0 +1,56 @@
+/*--------------------------------------------------------
+                        bench_i2cfast.c
+
+     Laufzeitmessungen im Simulator fuer den Software-
+     I2C Bus im Fast-Mode (i2c_fastmode 1 in ./i2c.h,
+     F_CPU 16 MHz) und die Zeichenausgabe auf einem
+     SSD1306 OLED-Display. Vergleich mit dem Standard-
+     Mode: bench_i2c
+
+     Aufruf aus diesem Verzeichnis:
+
+       make bench          : messen und mit bench_i2cfast.bench
+                             vergleichen
+       make bench-update   : Referenz neu schreiben
+
+     Die Zyklen des Simulators dienen nur dem Erkennen
+     von Regressionen, spdk zaehlt jeden Befehl als einen
+     Takt. Die Mindestzeiten tLOW / tHIGH des Fast-Mode
+     prueft "make delaycheck" im Hauptverzeichnis mit den
+     Takten lt. Datenblatt.
+
+     Compiler  : SDCC 4.0.3
+     MCU       : PFS154 / PFS173
+
+     R. Seelig
+
+  -------------------------------------------------------- */
+
+#include <stdint.h>
+#include "pdk_init.h"
+#include "pfs1xx_gpio.h"
+#include "delay.h"
+#include "i2c.h"
+#include "oled1306_i2c.h"
+#include "bench.h"
+
+/* --------------------------------------------------------
+                              main
+   -------------------------------------------------------- */
+void main(void)
+{
+  i2c_master_init();
+
+  BENCH(i2c_start,         i2c_start(0x78));
+  BENCH(i2c_write,         i2c_write(0x55));
+  BENCH(i2c_stop,          i2c_stop());
+
+  BENCH(oled_putchar,      oled_putchar('A'));
+  doublechar= 1;
+  BENCH(oled_putchar_dbl,  oled_putchar('A'));
+  doublechar= 0;
+  textcolor= 0;
+  BENCH(oled_putchar_inv,  oled_putchar('A'));
+
+  bench_end();
+}
@@ -0,0 +1,216 @@
+/* -----------------------------------------------------
+                          i2c.h
+
+    Header fuer Softwareimplementierung des I2C-Buses
+    (Bitbanging)
+
+      Compiler  : SDCC 4.0.3
+      MCU       : PFS154 / PFS173
+
+    14.10.2020   R. Seelig
+  ------------------------------------------------------ */
+
+
+#ifndef in_sw_i2c
+  #define in_sw_i2c
+
+  #include <stdint.h>
+  #include "pfs1xx_gpio.h"
+  #include "delay.h"
+
+  #define config_i2c_pa     1
+  #define config_i2c_pb     0
+
+  // Anschluesse des zweiten Busses (src/i2c_b.c, Funktionen i2c_b_...),
+  // muessen sich von denen des ersten Busses unterscheiden
+  #define config_i2c_b_pa   0
+  #define config_i2c_b_pb   1
+
+  /* --------------------------------------------------
+       i2c_fastmode
+         0 : Wartezeiten mit i2c_delay in Einheiten von
+             1 us (Standard-Mode)
+         1 : Fast-Mode (400 kHz), die Mindestzeiten des
+             Busses werden taktgenau als Befehlsfolge
+             eingefuegt (_delay_ns_exact, delay.h). Die
+             Laufzeit der Befehle zwischen zwei Flanken
+             kommt hinzu, 400 kHz werden erst bei hohem
+             F_CPU (16 MHz) annaehernd erreicht. Die
+             Mindestzeiten prueft "make delaycheck"
+
+       i2c_clkstretch
+         1 : nach jedem Freigeben von SCL wird gewartet,
+             bis die Leitung high ist (ein Slave darf
+             den Takt verlaengern). Haelt ein Slave SCL
+             dauerhaft low, bleibt das Programm stehen
+     -------------------------------------------------- */
+  #define i2c_fastmode      1
+  #define i2c_clkstretch    0
+
+  #if (config_i2c_pb == 1)
+    #define i2c_sdapin        PB7     // Dataanschluss
+    #define i2c_sclpin        PB6     // Clockanschluss
+  #endif
+
+  #if (config_i2c_pa == 1)
+    #define i2c_sdapin        PA5     // Dataanschluss
+    #define i2c_sclpin        PA6     // Clockanschluss
+  #endif
+
+  #if (config_i2c_b_pb == 1)
+    #define i2c_b_sdapin      PB7     // Dataanschluss zweiter Bus
+    #define i2c_b_sclpin      PB6     // Clockanschluss zweiter Bus
+  #endif
+
+  #if (config_i2c_b_pa == 1)
+    #define i2c_b_sdapin      PA5     // Dataanschluss zweiter Bus
+    #define i2c_b_sclpin      PA6     // Clockanschluss zweiter Bus
+  #endif
+
+  #if (i2c_fastmode == 1)
+
+    // Mindestzeiten Fast-Mode in ns: SCL low (= Busfreigabe zwischen Stop
+    // und Start), SCL high (= Setup / Hold fuer Start und Stop)
+    #define i2c_tlow       1300
+    #define i2c_thigh      600
+
+  #else
+
+    #define short_puls     1            // Einheiten fuer einen langen Taktimpuls
+    #define long_puls      1            // Einheiten fuer einen kurzen Taktimpuls
+    #define del_wait       1            // Wartezeit fuer garantierten 0 Pegel SCL-Leitung
+
+  #endif
+
+  // ----------------------------------------------------------------
+  // Praeprozessormacros um 2 Stringtexte zur weiteren Verwendung
+  // innerhalb des Praeprozessors  zu verknuepfen
+  //
+  // Bsp.:
+  //        #define ionr      3
+  //        #define ioport    conc2(PA, ionr)
+  //
+  //        ioport wird nun als "PA3" behandelt
+  #define CONC2EXP(a,b)     a ## b
+  #define conc2(a,b)        CONC2EXP(a, b)
+  // ----------------------------------------------------------------
+
+  /* --------------------------------------------------
+       mehrere Busse
+
+       src/i2c.c ist fuer beliebige Anschluesse ge-
+       schrieben. Ohne weitere Angaben uebersetzt
+       erzeugt es den Bus i2c_... an i2c_sdapin /
+       i2c_sclpin. Fuer jeden weiteren Bus wird es von
+       einer eigenen Datei mit Namen und Anschluessen
+       eingebunden (Bsp. src/i2c_b.c):
+
+         #define i2c_bus        i2c_b
+         #define i2c_bus_sda    PB7
+         #define i2c_bus_scl    PB6
+         #include "i2c.c"
+
+       Die Funktionen heissen dann i2c_b_start,
+       i2c_b_write usw., die Prototypen liefert
+       i2c_bus_prototypes(i2c_b). Jeder Bus belegt
+       eigenen Code. bench_i2c misst i2c_... und
+       i2c_b_... nebeneinander.
+     -------------------------------------------------- */
+
+  #define i2c_bus_prototypes(bus)                                  \
+    void conc2(bus,_master_init)(void);                            \
+    void conc2(bus,_sendstart)(void);                              \
+    uint8_t conc2(bus,_start)(uint8_t addr);                       \
+    void conc2(bus,_stop)(void);                                   \
+    void conc2(bus,_startaddr)(uint8_t addr, uint8_t rwflag);      \
+    void conc2(bus,_write_nack)(uint8_t data);                     \
+    uint8_t conc2(bus,_write)(uint8_t data);                       \
+    uint8_t conc2(bus,_write16)(uint16_t data);                    \
+    uint8_t conc2(bus,_read)(uint8_t ack)
+
+  // --------------------------------------------------------------------
+  //                      Prototypenbeschreibung
+  // --------------------------------------------------------------------
+
+  /* -------------------------------------------------------
+
+      ############### i2c_master_init ##############
+
+      setzt die Pins die fuer den I2C Bus verwendet werden
+      als Ausgaenge
+
+
+      ############## i2c_sendstart(void) ###############
+
+      erzeugt die Startcondition auf dem I2C Bus
+
+
+      ############## i2c_start(uint8_t addr) ##############
+
+      erzeugt die Startcondition auf dem I2C Bus und
+      schreibt eine Deviceadresse auf den Bus
+
+
+      ############## i2c_stop(void) ##############
+
+      erzeugt die Stopcondition auf dem I2C Bus
+
+
+      ############## i2c_write_nack(uint8_t data) ##############
+
+      schreibt einen Wert auf dem I2C Bus OHNE ein Ack-
+      nowledge einzulesen
+
+
+      ############## i2c_write(uint8_t data) ##############
+
+      schreibt einen Wert auf dem I2C Bus.
+
+      Rueckgabe:
+                 > 0 wenn Slave ein Acknowledge gegeben hat
+                 == 0 wenn kein Acknowledge vom Slave
+
+
+      ############## i2c_write16(uint16_t data) ##############
+
+      schreibt einen 16 Bit Wert (2Bytes) auf dem I2C Bus.
+
+      Rueckgabe:
+                 > 0 wenn Slave ein Acknowledge gegeben hat
+                 == 0 wenn kein Acknowledge vom Slave
+
+
+      ############## i2c_read(uint8_t ack) ##############
+
+      liest ein Byte vom I2c Bus.
+
+      Uebergabe:
+                 1 : nach dem Lesen wird dem Slave ein
+                     Acknowledge gesendet
+                 0 : es wird kein Acknowledge gesendet
+
+      Rueckgabe:
+                  gelesenes Byte
+     ------------------------------------------------------- */
+
+  void i2c_master_init(void);
+  void i2c_sendstart(void);
+  uint8_t i2c_start(uint8_t addr);
+  void i2c_stop();
+  void i2c_startaddr(uint8_t addr, uint8_t rwflag);
+  void i2c_write_nack(uint8_t data);
+  uint8_t i2c_write(uint8_t data);
+  uint8_t i2c_write16(uint16_t data);
+  uint8_t i2c_read(uint8_t ack);
+
+  #define i2c_read_ack()    i2c_read(1)
+  #define i2c_read_nack()   i2c_read(0)
+
+  // zweiter Bus
+  i2c_bus_prototypes(i2c_b);
+
+  #define i2c_b_read_ack()  i2c_b_read(1)
+  #define i2c_b_read_nack() i2c_b_read(0)
+
+
+#endif
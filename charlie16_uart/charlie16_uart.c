@@ -5,15 +5,10 @@
      Charlieplexing. Der anzuzeigende 16-Bit Wert wird
      ueber den UART mit 2400 Bd empfangen.
 
-     Da das Plexing der Anzeige mittels Timerinterrupt
-     das Timing der seriellen Schnittstelle veraendert,
-     muss fuer die Datenuebertragung der Interrupt-
-     handler ausgeschaltet werden, was zu einem kurzen
-     Flackern der Anzeige fuehrt.
-
-     Zwischen dem 1. und 2. Byte des Senders muss
-     mindestens eine Wartezeit von 40 ms  eingehalten
-     werden.
+     Die serielle Schnittstelle arbeitet im Interrupt
+     von Timer2 (uart_irq 2 in uart.h), das Plexing der
+     Anzeige im Interrupt des 16-Bit Timers laeuft
+     waehrend des Empfangs weiter.
 
      Compiler  : SDCC 4.0.3
      MCU       : PFS154
@@ -29,55 +24,7 @@
 
 #include "delay.h"
 #include "charlie16.h"
-
-/*
-              Delay-Werte Tabelle fuer unterschiedliche Baudraten
-
-    F_CPU   | 2400 Bd | 4800 Bd | 9600 Bd | 19200 Bd | 38400 Bd |  57600 Bd | 115200 Bd |
-    -------------------------------------------------------------------------------------
-       8    |   182   |   88    |   44    |    22    |    10    |     6     |
-      16    |         |  182    |   88    |    44    |    22    |    14     |     6
-*/
-
-#define uart_delfak       182               // 2400 Bd / 8 MHz
-
-#define uartrx_init()     PA4_input_init()
-#define is_uartrx()        is_PA4()
-
-/* --------------------------------------------------
-                       uart_delay
-      Warteschleife zum Einstellen der Baudraten
-   -------------------------------------------------- */
-void uart_delay(uint16_t cnt)
-{
-  volatile int i;              // Volatile, damit der Compiler die Warteschleife
-                               // nicht "wegoptimiert"
-
-  for (i= 0; i< cnt; i++);
-}
-
-
-/* --------------------------------------------------
-                    uart_getchar
-      Zeichen von serieller Schnittstelle lesen
-   -------------------------------------------------- */
-uint8_t uart_getchar()
-{
-  char ch= 0;
-  uint8_t mask= 1;
-
-  while (is_uartrx());                  // auf Startbit warten
-  __disgint();                          // Interrupts aus
-  uart_delay(uart_delfak+(uart_delfak/2));
-  for (char i= 0; i< 8; i++)
-  {
-    if (is_uartrx()) ch |= mask; else ch &= ~(mask);
-    uart_delay(uart_delfak);
-    mask <<= 1;
-  }
-  return ch;
-}
-
+#include "uart.h"
 
 /* --------------------------------------------------------
                        interrupt
@@ -115,6 +62,13 @@ void interrupt(void) __interrupt(0)
 
     INTRQ &= ~INTRQ_T16;                    // Interruptanforderung quittieren
   }
+
+  // Bittakt der seriellen Schnittstelle
+  if (INTRQ & INTRQ_TM2)
+  {
+    uart_isr();
+    INTRQ &= ~INTRQ_TM2;                    // Interruptanforderung quittieren
+  }
 }
 
 /* ------------------------------------------------------
@@ -131,23 +85,19 @@ void interrupt(void) __interrupt(0)
 uint8_t charlie16_getword(uint16_t *value)
 {
   uint16_t  b1, b2;
-  uint32_t  timout;
+  uint8_t   timout;
 
-  timout= 0;
   b1= uart_getchar();
 
-  while (is_uartrx() && (timout < 1000000))    // auf Startbit warten
+  timout= 0;
+  while (!uart_available())                 // auf das zweite Zeichen warten
   {
+    delay(1);
     timout++;
-  }
-  if (timout> 999999)
-  {
-  __engint();
-    return 0;                             // das zweite Zeichen ist nicht angekommen
+    if (timout > 200) return 0;             // das zweite Zeichen ist nicht angekommen
   }
   b2= uart_getchar();
   *value= ((b1 << 8) & 0xff00) | ( b2 & 0x00ff);
-  __engint();
   return 1;
 }
 
@@ -162,7 +112,7 @@ int main(void)
 
   charlie16_init();
   charlie16_buf= 0xaaaa;
-  uartrx_init();
+  uart_init();
 
   while(1)
   {
@@ -0,0 +1,153 @@
+/* ------------------------------------------------------
+                         uart.h
+
+     Header fuer Softwaremodul einer Bitbanging er-
+     zeugten seriellen Schnittstelle
+
+     Compiler  : SDCC 4.0.3
+     MCU       : PFS154 / PFS173
+
+     hier verfuegbare Stringausgabe  kann mittels
+     Wertzuweisung an
+
+                    uart_puts_enable
+
+     an- bzw. abgeschaltet werden. Immer dann
+     empfehlenswert wenn der Speicherplatz knapp wird !!
+
+     06.10.2020        R. Seelig
+
+  ------------------------------------------------------- */
+
+#ifndef in_uart
+  #define in_uart
+
+  #include <pdk/device.h>
+  #include "pfs1xx_gpio.h"
+
+
+  #define uart_txbit        PA3              // Anschlusspin der TX-Leitung
+  #define uart_rxbit        PA4              // Anschlusspin der RX-Leitung
+
+  #define uart_puts_enable  1                // 0 : nicht verfuegbar
+                                             // 1 : verfuegbar
+
+  /* ---------------------------------------------------------------------------
+                               Interruptbetrieb
+
+      uart_irq 0  : Bitbanging mit Warteschleifen (uart_delfak), uart_putchar
+                    und uart_getchar blockieren fuer die Dauer eines Zeichens
+
+      uart_irq 2  : die Bits werden im Interrupt des 8-Bit Timer2 (uart_irq 2)
+      uart_irq 16 : bzw. des 16-Bit Timers (uart_irq 16) getaktet, Senden und
+                    Empfangen laufen ueber Ringpuffer im Hintergrund
+
+      Im Interruptbetrieb wird 3 mal je Bit abgetastet, der Interrupt laeuft
+      mit 3 * uart_baud (s.u.), bei F_CPU 8 MHz sind bis 4800 Bd sinnvoll. Der
+      Interrupthandler des Projekts muss uart_isr aufrufen:
+
+        if (INTRQ & INTRQ_TM2)            // bzw. INTRQ_T16
+        {
+          uart_isr();
+          INTRQ &= ~INTRQ_TM2;
+        }
+
+      uart_putchar kehrt sofort zurueck, solange im Sendepuffer Platz ist,
+      uart_available liefert die Anzahl empfangener Zeichen. uart_getchar
+      wartet nur dann, wenn noch kein Zeichen empfangen wurde. uart_flush
+      wartet, bis alle Zeichen des Sendepuffers gesendet sind.
+     --------------------------------------------------------------------------- */
+
+  #define uart_irq          2                // 0, 2 oder 16 (s.o.)
+
+  #if (uart_irq != 0)
+    #define uart_txbufsize  8                // Puffergroessen, nur Zweierpotenzen
+    #define uart_rxbufsize  8
+  #endif
+
+  /* ---------------------------------------------------------------------------
+                                 Baudratentabelle
+
+      Die Implementierung der seriellen Schnittstelle auf dem PFS154 wird
+      mittels Bitbanging realisiert. Anstelle eine sehr grosse Macro-Kette
+      im Quellcode zu haben gibt es hier eine Tabelle fuer die Konstante
+      uart_delfak, die die Baudrate der Schnittstelle fuer unterschiedliche
+      Coretakte einstellt (Werte wurden impirisch mittels Logicanalyzer er-
+      mitteln):
+
+                           Werte fuer uart_delfak
+
+      F_CPU   | 2400 Bd | 4800 Bd | 9600 Bd | 19200 Bd | 38400 Bd |  57600 Bd | 115200 Bd |
+      -------------------------------------------------------------------------------------
+         8    |   182   |   88    |   44    |    22    |    10    |     6     |
+        16    |         |  182    |   88    |    44    |    22    |    14     |     6
+  */
+  
+  // ToDo : Wartezeiten sind fuer einen PFS173 leicht abweichend, hier ist noch
+  //        eine Tabelle zu erstellen
+
+
+  #define uart_delfak    22               // 19200 Bd [F_CPU== 8 MHz]
+
+  /* ---------------------------------------------------------------------------
+                             Bittakt aus einem Timer
+
+      Mit uart_timer 2 bzw. 3 wird der Bittakt im blockierenden Betrieb nicht
+      aus der Warteschleife (uart_delfak), sondern aus dem 8-Bit Timer2 bzw.
+      Timer3 abgeleitet, der Teiler wird aus F_CPU und uart_baud berechnet.
+      Die Baudrate haengt dann nicht von Compiler und Optimierung ab und
+      Interrupts waehrend eines Zeichens verfaelschen das Timing nicht, mit
+      F_CPU 16 MHz sind auch 57600 und 115200 Bd moeglich. Der gewaehlte Timer
+      steht dem Projekt nicht mehr zur Verfuegung.
+     --------------------------------------------------------------------------- */
+
+  #define uart_timer     0                // 0 : Warteschleife, 2 : Timer2, 3 : Timer3
+  #define uart_baud      2400             // fuer uart_timer 2 / 3 und uart_irq 2 / 16
+  
+
+
+  /* --------------------------------------------------
+                       Prototypen
+     -------------------------------------------------- */
+
+  void uart_init(void);
+  void uart_putchar (char c);
+  char uart_getchar(void);
+  #if (uart_irq != 0)
+
+    uint8_t uart_available(void);
+    void uart_flush(void);
+    void uart_isr(void);
+
+  #endif
+  #if ( uart_puts_enable == 1 )
+
+    void uart_puts(char *p);
+
+  #endif
+
+
+  // ----------------------------------------------------------------
+  // Praeprozessormacros um 2 Stringtexte zur weiteren Verwendung
+  // innerhalb des Praeprozessors  zu verknuepfen
+  //
+  // Bsp.:
+  //        #define ionr      3
+  //        #define ioport    conc2(PA, ionr)
+  //
+  //        ioport wird nun als "PA3" behandelt
+  #define CONC2EXP(a,b)     a ## b
+  #define conc2(a,b)        CONC2EXP(a, b)
+  // ----------------------------------------------------------------
+
+  // define-Stringtexte der Anschlusspins erzeugen
+
+  #define uarttx_set()    conc2(uart_txbit,_set())
+  #define uarttx_clr()    conc2(uart_txbit,_clr())
+  #define uarttx_init()   { conc2(uart_txbit,_output_init()); uarttx_set(); }
+
+  #define uartrx_init()   conc2(uart_rxbit,_input_init())
+  #define is_uartrx()     conc2(is_,uart_rxbit())
+
+#endif
+
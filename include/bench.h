@@ -0,0 +1,38 @@
+/* ------------------------------------------------------
+                         bench.h
+
+     Header fuer Laufzeitmessungen im Simulator spdk
+     (ucsim, tools/bin/spdk), ausgewertet vom Host-
+     programm pfsbench (tools/pfsbench, "make bench").
+
+     Jede Messung wird zwischen die Aufrufe der leeren
+     Funktionen bench_start und bench_stop eingebettet.
+     pfsbench setzt auf beide Funktionen einen Break-
+     point und misst die Zyklen dazwischen. Die Namen
+     der Messungen entnimmt pfsbench in der Reihenfolge
+     ihres Auftretens dem Quelltext des Projekts:
+
+       BENCH(putint_neg, putint(-12345, 2));
+
+     Das Messprogramm endet mit bench_end().
+
+     Compiler  : SDCC 4.0.3
+     MCU       : PFS154 / PFS173
+
+     R. Seelig
+
+  ------------------------------------------------------- */
+
+#ifndef in_bench
+  #define in_bench
+
+  #include <stdint.h>
+
+  #define BENCH(name, ...)  { bench_start(); __VA_ARGS__; bench_stop(); }
+
+  #define bench_end()       { while(1); }
+
+  void bench_start(void);
+  void bench_stop(void);
+
+#endif
@@ -47,6 +47,62 @@
   #define delay(ms)      _delay_ms(ms)
   #define delay_us(us)   _delay_us(us)
 
+  /* --------------------------------------------------
+       taktgenaue Verzoegerungen
+
+       _delay_cycles(cyc) erzeugt zur Uebersetzungs-
+       zeit eine Befehlsfolge, die (nach Datenblatt)
+       genau cyc Takte benoetigt:
+
+         je 765 Takte   : mov a,#255 / dzsn a / goto .-1
+         Rest / 3       : dieselbe Schleife, verkuerzt
+         Rest % 3       : nop
+
+       Es wird keine Funktion aufgerufen, die Folge
+       steht direkt im Code (3 Words je angefangene 765
+       Takte + max. 2 nop).
+
+       Einschraenkungen:
+         - cyc muss ein konstanter, ganzzahliger Aus-
+           druck OHNE Suffix (L, UL) sein, er wird vom
+           Assembler ausgewertet. Dieser rechnet mit
+           24 Bit (vorzeichenbehaftet), alle Zwischen-
+           ergebnisse muessen kleiner 8388608 bleiben
+         - Register A wird veraendert
+         - genau nur bei gesperrten Interrupts
+
+       _delay_us_exact und _delay_ns_exact runden auf
+       ganze Takte auf (Mindestzeiten, z.B. I2C),
+       _delay_ns_exact liefert hoechstens 1 Takt mehr
+       als noetig. Beide sind fuer kurze Zeiten bis ca.
+       500 us (bei 16 MHz) gedacht.
+     -------------------------------------------------- */
+
+  #include "pdk/util.h"
+
+  #define _delay_cycles(cyc)      __asm__(                         \
+                                    ".rept (" _STR(cyc) ") / 765\n"  \
+                                    "mov a, #255\n"                 \
+                                    "dzsn a\n"                      \
+                                    "goto .-1\n"                    \
+                                    ".endm\n"                       \
+                                    ".if ((" _STR(cyc) ") % 765) / 3\n" \
+                                    "mov a, #((" _STR(cyc) ") % 765) / 3\n" \
+                                    "dzsn a\n"                      \
+                                    "goto .-1\n"                    \
+                                    ".endif\n"                      \
+                                    ".rept ((" _STR(cyc) ") % 765) % 3\n" \
+                                    "nop\n"                         \
+                                    ".endm\n")
+
+  // F_CPU / 1000 und F_CPU / 8000, F_CPU selbst ist fuer 24 Bit zu gross
+  #define _DELAY_KHZ              ((((F_CPU) >> 3) & 0x1fffff) / 125)
+  #define _DELAY_K8               ((((F_CPU) >> 3) & 0x1fffff) / 1000)
+
+  #define _delay_us_exact(us)     _delay_cycles((_DELAY_KHZ * (us) + 999) / 1000)
+  #define _delay_ns_exact(ns)     _delay_cycles((_DELAY_KHZ * ((ns) / 1000) + 999) / 1000 + \
+                                                (_DELAY_K8 * ((ns) % 1000) + 124999) / 125000)
+
   /* --------------------------------------------------
                        Prototyps
      -------------------------------------------------- */
@@ -0,0 +1,22 @@
+/*--------------------------------------------------------
+                           ntc.h
+
+     Header fuer die Umrechnung des 8-Bit ADC-Wertes
+     eines NTC-Spannungsteilers (NTC 10k, beta 3950
+     an 10k Pullup) in eine Temperatur.
+
+     Compiler  : SDCC 4.0.3
+     MCU       : PFS154 / PFS173
+
+     03.11.2020        R. Seelig
+  -------------------------------------------------------- */
+
+#ifndef in_ntc
+  #define in_ntc
+
+  #include <stdint.h>
+
+  // Temperatur in 0.1 Grad Celsius
+  int16_t ntc_gettemp(uint8_t adc_value);
+
+#endif
@@ -32,6 +32,39 @@
   #define uart_puts_enable  1                // 0 : nicht verfuegbar
                                              // 1 : verfuegbar
 
+  /* ---------------------------------------------------------------------------
+                               Interruptbetrieb
+
+      uart_irq 0  : Bitbanging mit Warteschleifen (uart_delfak), uart_putchar
+                    und uart_getchar blockieren fuer die Dauer eines Zeichens
+
+      uart_irq 2  : die Bits werden im Interrupt des 8-Bit Timer2 (uart_irq 2)
+      uart_irq 16 : bzw. des 16-Bit Timers (uart_irq 16) getaktet, Senden und
+                    Empfangen laufen ueber Ringpuffer im Hintergrund
+
+      Im Interruptbetrieb wird 3 mal je Bit abgetastet, der Interrupt laeuft
+      mit 3 * uart_baud (s.u.), bei F_CPU 8 MHz sind bis 4800 Bd sinnvoll. Der
+      Interrupthandler des Projekts muss uart_isr aufrufen:
+
+        if (INTRQ & INTRQ_TM2)            // bzw. INTRQ_T16
+        {
+          uart_isr();
+          INTRQ &= ~INTRQ_TM2;
+        }
+
+      uart_putchar kehrt sofort zurueck, solange im Sendepuffer Platz ist,
+      uart_available liefert die Anzahl empfangener Zeichen. uart_getchar
+      wartet nur dann, wenn noch kein Zeichen empfangen wurde. uart_flush
+      wartet, bis alle Zeichen des Sendepuffers gesendet sind.
+     --------------------------------------------------------------------------- */
+
+  #define uart_irq          0                // 0, 2 oder 16 (s.o.)
+
+  #if (uart_irq != 0)
+    #define uart_txbufsize  8                // Puffergroessen, nur Zweierpotenzen
+    #define uart_rxbufsize  8
+  #endif
+
   /* ---------------------------------------------------------------------------
                                  Baudratentabelle
 
@@ -55,6 +88,21 @@
 
 
   #define uart_delfak    22               // 19200 Bd [F_CPU== 8 MHz]
+
+  /* ---------------------------------------------------------------------------
+                             Bittakt aus einem Timer
+
+      Mit uart_timer 2 bzw. 3 wird der Bittakt im blockierenden Betrieb nicht
+      aus der Warteschleife (uart_delfak), sondern aus dem 8-Bit Timer2 bzw.
+      Timer3 abgeleitet, der Teiler wird aus F_CPU und uart_baud berechnet.
+      Die Baudrate haengt dann nicht von Compiler und Optimierung ab und
+      Interrupts waehrend eines Zeichens verfaelschen das Timing nicht, mit
+      F_CPU 16 MHz sind auch 57600 und 115200 Bd moeglich. Der gewaehlte Timer
+      steht dem Projekt nicht mehr zur Verfuegung.
+     --------------------------------------------------------------------------- */
+
+  #define uart_timer     0                // 0 : Warteschleife, 2 : Timer2, 3 : Timer3
+  #define uart_baud      19200            // fuer uart_timer 2 / 3 und uart_irq 2 / 16
   
 
 
@@ -65,6 +113,13 @@
   void uart_init(void);
   void uart_putchar (char c);
   char uart_getchar(void);
+  #if (uart_irq != 0)
+
+    uint8_t uart_available(void);
+    void uart_flush(void);
+    void uart_isr(void);
+
+  #endif
   #if ( uart_puts_enable == 1 )
 
     void uart_puts(char *p);
@@ -35,7 +35,24 @@ TOOLPATH     = ../tools/bin/
 CC           = $(TOOLPATH)sdcc
 LD           = $(TOOLPATH)sdld
 OBJCOPY      = $(TOOLPATH)sdobjcopy
-SIZEPROG     = @../tools/bin/pfsreadhex
+# Flash- / RAM-Bedarf (tools/pfsreadhex), wird bei Bedarf mit HOSTCC gebaut
+SIZEPROG     = ../tools/pfsreadhex/pfsreadhex
+HOSTCC       = gcc
+
+# Zusatzparameter fuer pfsreadhex, "make report" setzt hier den Report je
+# Modul / Symbol (aus den .lk / .map Dateien und obj/*.sym)
+SIZEREPORT   =
+
+# statische Zyklenanalyse (tools/pfscycles), "make cycles" prueft die Interrupt-
+# handler gegen ISRBUDGET (Zyklen oder bspw. 20us), Schleifen mit ISRLOOPS Durch-
+# laeufen (leer = unbegrenzt)
+CYCLEPROG    = ../tools/pfscycles/pfscycles
+CYCLECHECK   =
+
+# Laufzeitmessung im Simulator spdk (tools/pfsbench), "make bench" vergleicht mit
+# der Referenz $(PROJECT).bench, "make bench-update" schreibt diese neu
+BENCHPROG    = ../tools/pfsbench/pfsbench
+BENCHOPT     =
 
 
 # -----------------------------------------------------------------------------------------------------
@@ -72,40 +89,121 @@ NOWAIT       = nowait
 
 #NOWAIT       =
 
+# Hostprogramm fuer den AVR basierenden Programmer (PROGRAMMER = 2), alternativ
+# das native pfsflash (tools/pfsflash), das ohne FreePascal auskommt:
+#   PFSPROG = ../tools/pfsflash/pfsflash
+ifeq ($(PFSPROG),)
+	PFSPROG = ../tools/bin/pfsprog
+endif
+
 # Speicherorganisation des Padauk-Controllers
 LIBSPEC      = -m$(MEMORG)
 
 
-OBJS         = $(PROJECT).rel $(SRCS)
+# Objektdateien und Zwischendateien (.asm, .lst, .sym, .d ...) eines Projekts
+# liegen in einem eigenen Verzeichnis. Es wird nur neu uebersetzt, was sich
+# geaendert hat, und Projekte koennen gleichzeitig gebaut werden (make -j),
+# da kein Projekt mehr in ../src schreibt.
+OBJDIR       = obj
+
+# Verzeichnis fuer .ihx, .map, .lk (bspw. fuer die Groessenmatrix im Haupt-
+# verzeichnis, die jedes Projekt fuer mehrere Controller baut)
+OUTDIR       = .
+
+# -----------------------------------------------------------------------------------------------------
+# Treiberbibliothek: die Module aus ../src werden je Kombination aus MEMORG, MCU,
+# F_CPU und FACTORYCAL einmal uebersetzt und in
+# ../drvlib/<MEMORG>_<MCU>_<F_CPU>_<FACTORYCAL>/ abgelegt. Alle Projekte mit
+# gleicher Kombination verwenden diese Objektdateien.
+#
+# Gelinkt werden nur die Module, die das Projekt in SRCS angibt, und zwar als
+# einzelne .rel Dateien, nicht aus einem Archiv: mehrere Module in ../src sind
+# alternative Implementierungen gleichnamiger Funktionen (bspw. hx1838 und
+# hx1838_nec, seg7mpx_dig2 und seg7mpx_dig4, gotoxy in hd44780, n5110 ...),
+# aus einem Archiv wuerde der Linker das erste passende Modul nehmen.
+#
+# Die Bibliothek wird mit denselben Compilerschaltern wie das Projekt, aber
+# nur mit den Headern aus ../include uebersetzt. Hat ein Projekt eigene, davon
+# abweichende Header (bspw. andere Pinbelegung) oder zusaetzliche Defines
+# (CC_SYMBOLS), werden die Module aus SRCS wie bisher fuer das Projekt ueber-
+# setzt (USE_DRVLIB = auto). Mit USE_DRVLIB = 0 im Makefile des Projekts wird
+# die Bibliothek nie verwendet.
+# -----------------------------------------------------------------------------------------------------
+
+ifeq ($(USE_DRVLIB),)
+	USE_DRVLIB = auto
+endif
+
+DRVLIBDIR    = ../drvlib/$(MEMORG)_$(MCU)_$(F_CPU)_$(FACTORYCAL)
+DRVFLAGS     = $(CC_FLAGS) -I../include
+
+ifeq ($(USE_DRVLIB),auto)
+  LOCALHDRS := $(shell for h in *.h; do [ -f "$$h" ] && [ -f "../include/$$h" ] && ! cmp -s "$$h" "../include/$$h" && echo "$$h"; done)
+  ifeq ($(LOCALHDRS)$(CC_SYMBOLS),)
+    USE_DRVLIB = 1
+  else
+    USE_DRVLIB = 0
+  endif
+endif
+
+# Module aus ../src in SRCS werden aus der Bibliothek gelinkt
+ifeq ($(USE_DRVLIB),1)
+	LIBSRCS    = $(filter $(patsubst ../src/%.c,../src/%.rel,$(wildcard ../src/*.c)),$(SRCS))
+	LINKLIBS   = $(patsubst ../src/%,$(DRVLIBDIR)/%,$(LIBSRCS))
+else
+	LIBSRCS    =
+	LINKLIBS   =
+endif
+
+# ../src/delay.rel bzw. ./charlie6.rel aus SRCS => obj/delay.rel, obj/charlie6.rel
+OBJS         = $(OBJDIR)/$(PROJECT).rel $(addprefix $(OBJDIR)/,$(notdir $(filter-out $(LIBSRCS),$(SRCS))))
 
 CC_FLAGS     = -m$(MEMORG) -D$(MCU) -DF_CPU=$(F_CPU) -DFACTORYCAL=$(FACTORYCAL)
 CC_FLAGS    += --std-sdcc11 --opt-code-size
 
 
-.PHONY: all compile clean flash complete run
+.PHONY: all compile clean flash complete run report cycles bench bench-update drvlib
 
-all: clean $(OBJS)
-	@echo "Linking $(PROJECT).c with libs, Intel-Hex-File: $(PROJECT).ihx" 1>&2
-	$(CC) -L ../tools/lib/ $(LIBSPEC) $(INC_DIR) --out-fmt-ihx $(OBJS) 1>&2
-#	$(OBJCOPY) -I ihex -O binary $(PROJECT).ihx $(PROJECT).bin	
-	@rm -f ../src/*.asm
-	@rm -f ../src/*.rst
-	@rm -f ../src/*.rel
-	@rm -f ../src/*.sym
-	@rm -f ../src/*.lst
-	@rm -f ../src/*.map
-	@rm -f ../src/*.cdb
-	@rm -f ../src/*.lk
-	@rm -f ../src/*.mem
+all: $(OUTDIR)/$(PROJECT).ihx $(SIZEPROG)
 	@echo "  " 1>&2
-	$(SIZEPROG) $(MCU) $(PROJECT) 1>&2
+	@$(SIZEPROG) $(MCU) $(OUTDIR)/$(PROJECT) $(SIZEREPORT) 1>&2
+	$(CYCLECHECK)
 	@echo "  " 1>&2
 	@echo " ------ Programm build sucessfull -----" 1>&2
 
-compile:
-	$(CC) -c $(CC_FLAGS) $(CC_SYMBOLS) $(INC_DIR) $(PROJECT).c -o $(PROJECT).rel 1>&2
+$(OUTDIR)/$(PROJECT).ihx: $(OBJS) $(LINKLIBS) | $(OBJDIR)
+	@echo "Linking $(PROJECT).c with libs, Intel-Hex-File: $(PROJECT).ihx" 1>&2
+	$(CC) -L ../tools/lib/ $(LIBSPEC) $(INC_DIR) --out-fmt-ihx $(OBJS) $(LINKLIBS) -o $@ 1>&2
+#	$(OBJCOPY) -I ihex -O binary $(PROJECT).ihx $(PROJECT).bin	
+
+# wie all, zusaetzlich Flash- / RAM-Bedarf je Modul und je Funktion,
+# als Tabelle und in $(PROJECT).size.json
+report: SIZEREPORT = report json=$(OUTDIR)/$(PROJECT).size.json
+report: all
+
+# wie all, zusaetzlich Zyklen je Funktion und Pruefung der Interrupthandler
+cycles: CYCLECHECK = $(CYCLEPROG) $(OUTDIR)/$(PROJECT) fcpu=$(F_CPU) $(if $(ISRBUDGET),budget=$(ISRBUDGET)) $(if $(ISRLOOPS),loops=$(ISRLOOPS)) 1>&2
+cycles: all
+
+# Projekt uebersetzen und die BENCH() Messungen im Simulator ausfuehren
+bench: all
+	$(BENCHPROG) $(PROJECT) cpu=$(MEMORG) fcpu=$(F_CPU) spdk=$(TOOLPATH)spdk $(BENCHOPT) 1>&2
+
+bench-update: BENCHOPT = update
+bench-update: bench
+
+compile: $(OBJDIR)/$(PROJECT).rel
+
+# pfsreadhex aus den Quellen in tools bauen, wenn es fehlt oder aelter ist.
+# Bei make -j koennen mehrere Projekte dies gleichzeitig tun, deshalb wird
+# unter eindeutigem Namen uebersetzt und erst fertig verschoben.
+$(SIZEPROG): $(SIZEPROG).c ../tools/ihex/ihex.c ../tools/ihex/ihex.h
+	@echo "Building $@" 1>&2
+	@tmp=$@.$$$$; $(HOSTCC) $< ../tools/ihex/ihex.c -I../tools/ihex -Os -lm -o $$tmp 1>&2 \
+	  && mv -f $$tmp $@ || { rm -f $$tmp; exit 1; }
 
 clean:
+	@rm -rf $(OBJDIR)
 	@rm -f *.asm
 	@rm -f *.rst
 	@rm -f *.ihx
@@ -117,20 +215,56 @@ clean:
 	@rm -f *.lk
 	@rm -f *.mem
 	@rm -f *.bin
-	@rm -f ../src/*.asm
-	@rm -f ../src/*.rst
-	@rm -f ../src/*.rel
-	@rm -f ../src/*.sym
-	@rm -f ../src/*.lst
-	@rm -f ../src/*.map
-	@rm -f ../src/*.cdb
-	@rm -f ../src/*.lk
-	@rm -f ../src/*.mem
+	@rm -f *.size.json
 
 	@echo "Cleaning done..."
 
-%.rel: %.c
+$(OBJDIR):
+	@mkdir -p $@
+
+# Uebersetzen, anschliessend die Abhaengigkeiten (Header) mittels sdcc -MM
+# in obj/name.d ablegen. Fuer jeden Header entsteht zusaetzlich eine leere
+# Regel, damit ein geloeschter Header den Build nicht abbricht.
+define compile_rel
 	$(CC) -c $(CC_FLAGS) $(CC_SYMBOLS) $(INC_DIR) $< -o $@ 1>&2
+	@$(CC) -MM $(CC_FLAGS) $(CC_SYMBOLS) $(INC_DIR) $< > $(@:.rel=.dtmp)
+	@sed -e 's|^[^:]*:|$@:|' $(@:.rel=.dtmp) > $(@:.rel=.d)
+	@sed -e 's|^[^:]*:||' -e 's|\\$$||' $(@:.rel=.dtmp) | tr -s ' \t' '\n\n' | sed -e '/^$$/d' -e 's|$$|:|' >> $(@:.rel=.d)
+	@rm -f $(@:.rel=.dtmp)
+endef
+
+# Quellen im Projektverzeichnis (Hauptprogramm, lokale Module), sonst ../src.
+# Aenderungen an den Makefiles (F_CPU, MCU ...) uebersetzen alles neu.
+$(OBJDIR)/%.rel: %.c Makefile ../makefile.mk | $(OBJDIR)
+	$(compile_rel)
+
+$(OBJDIR)/%.rel: ../src/%.c Makefile ../makefile.mk | $(OBJDIR)
+	$(compile_rel)
+
+-include $(wildcard $(OBJDIR)/*.d)
+
+# Module der Treiberbibliothek fuer dieses Projekt bauen. Mehrere Projekte
+# gleicher Variante koennen dies bei make -j gleichzeitig tun, deshalb wird
+# jede Datei unter einem eindeutigen Namen erzeugt und erst fertig an ihren
+# Platz verschoben. Die .asm bleibt fuer pfscycles (make cycles) erhalten.
+drvlib: $(LINKLIBS)
+
+$(DRVLIBDIR)/%.rel: ../src/%.c ../makefile.mk
+	@mkdir -p $(DRVLIBDIR)
+	@tmp=$(@:.rel=).$$$$; \
+	echo "$(CC) -c $(DRVFLAGS) $< -o $@" 1>&2; \
+	if $(CC) -c $(DRVFLAGS) $< -o $$tmp.rel 1>&2 && \
+	   $(CC) -MM $(DRVFLAGS) $< | sed -e 's|^[^:]*:|$@:|' > $$tmp.d; then \
+	  mv -f $$tmp.d $(@:.rel=.d); [ -f $$tmp.sym ] && mv -f $$tmp.sym $(@:.rel=.sym); \
+	  [ -f $$tmp.asm ] && mv -f $$tmp.asm $(@:.rel=.asm); \
+	  mv -f $$tmp.rel $@; rm -f $$tmp.*; \
+	else \
+	  rm -f $$tmp.*; exit 1; \
+	fi
+
+ifeq ($(USE_DRVLIB),1)
+-include $(wildcard $(DRVLIBDIR)/*.d)
+endif
 
 flash:
 
@@ -145,7 +279,7 @@ ifeq ($(CH340RESET),1)
 #	sleep 0.5
 endif
 
-	../tools/bin/pfsprog txwr $(SERPORT) $(PROJECT).ihx $(NOWAIT) 1>&2
+	$(PFSPROG) txwr $(SERPORT) $(PROJECT).ihx $(NOWAIT) 1>&2
 endif
 
 run:
@@ -160,7 +294,7 @@ ifeq ($(CH340RESET),1)
 #	sleep 0.5
 endif
 
-	../tools/bin/pfsprog run $(SERPORT) $(NOWAIT) 1>&2
+	$(PFSPROG) run $(SERPORT) $(NOWAIT) 1>&2
 endif
 
 stop:
@@ -171,7 +305,9 @@ ifeq ($(CH340RESET),1)
 #	sleep 0.5
 endif
 
-	../tools/bin/pfsprog stop $(SERPORT) $(NOWAIT) 1>&2
+	$(PFSPROG) stop $(SERPORT) $(NOWAIT) 1>&2
 endif
 
-complete: clean all flash
+# nacheinander, auch bei make -j
+complete: all
+	@$(MAKE) --no-print-directory flash
@@ -29,8 +29,10 @@
 #include "adc_pfs154.h"
 #include "seg7mpx_dig2.h"
 #include "uart.h"
+#include "ntc.h"
 
 uint8_t mpx_enable = 1;
+uint8_t uart_enable = 1;
 
 
 #define ledminus_init()    PA0_output_init()
@@ -100,40 +102,6 @@ void putint(int i, char komma)
   }
 }
 
-/* -------------------------------------------------
-     Lookup-table fuer NTC-Widerstand
-     R25-Wert: 10.00 kOhm
-     Pullup-Widerstand: 10.00 kOhm
-     Materialkonstante beta: 3950
-     Aufloesung des ADC: 8 Bit
-     Einheit eines Tabellenwertes: 0.1 Grad Celcius
-     Temperaturfehler der Tabelle: 0.7 Grad Celcius
-   -------------------------------------------------*/
-const int ntctable[] = {
-  1269, 1016, 763, 621, 520, 439, 370, 308,
-  250, 194, 139, 83, 22, -47, -132, -256,
-  -380
-};
-
-/* -------------------------------------------------
-                     ntc_gettemp
-
-    zuordnen des Temperaturwertes aus gegebenem
-    ADC-Wert.
-   ------------------------------------------------- */
-int16_t ntc_gettemp(uint8_t adc_value)
-{
-  int16_t p1,p2;
-
-  // Stuetzpunkt vor und nach dem ADC Wert ermitteln.
-  p1 = ntctable[ (adc_value >> 4)    ];
-  p2 = ntctable[ (adc_value >> 4) + 1];
-
-  // zwischen beiden Punkten interpolieren.
-  return p1 - ( (p1-p2) * (adc_value & 0x000f) ) / 16;
-}
-
-
 /* --------------------------------------------------------
                        interrupt
 
@@ -162,6 +130,16 @@ void interrupt(void) __interrupt(0)
                                   // der 2-stelligen Anzeige
     INTRQ &= ~INTRQ_TM2;          // Interruptanforderung quittieren
   }
+
+  // Interruptquelle Timer16
+  // Bittakt der seriellen Schnittstelle (uart_irq 16 in uart.h)
+  if (INTRQ & INTRQ_T16)
+  {
+    if (uart_enable)
+      uart_isr();                 // Bittakt, Empfang wird auf Startbit
+                                  // abgefragt, auch wenn nichts gesendet wird
+    INTRQ &= ~INTRQ_T16;          // Interruptanforderung quittieren
+  }
 }
 
 
@@ -188,8 +166,15 @@ void main(void)
   cx= 0;
   while(1)
   {
-    mpx_enable= 0;                      // Multiplex fuer Dauer der ADC aus.
+    // Timer3 zaehlt die Zeit bis zum Umschalten des Komparators in 8us
+    // Schritten (adc_count_ticks), jeder weitere laengere Durchlauf des
+    // Interrupthandlers verschluckt Schritte. Multiplex und UART (bei
+    // jedem Timer16 Interrupt, auch im Leerlauf) fuer Dauer der ADC aus
+    uart_flush();                       // vorher Sendepuffer leeren
+    uart_enable= 0;
+    mpx_enable= 0;
     adc_value= adc_getvalue();
+    uart_enable= 1;
     temp= ntc_gettemp(adc_value);
     if (temp< 0)
     {
@@ -136,7 +136,11 @@ uint8_t adc_getvalue(void)
   INTEN |= INTEN_TM3;               // Timerinterrupt zum "ticks" zaehlen zulassen
   while(!(GPCC & 0x40));            // Bit6 (Mask 0x40) ist das Ergebnisbit des Komparators
   INTEN &= ~(INTEN_TM3);            // Timerinterrupt sperren, damit die Delay-Zeiten
-                                    // u.a. fuer die serielle Schnittstelle wieder stimmen
+                                    // u.a. fuer die serielle Schnittstelle wieder stimmen.
+                                    // Andere Interrupts, die waehrend der Messung laenger
+                                    // als ein Timer3 Intervall brauchen (bspw. Multiplexen
+                                    // oder uart_isr im Interruptbetrieb), verfaelschen
+                                    // ticks und muessen vom Aufrufer abgeschaltet werden
   discharge();                      // Kondensator entladen
 
   delay(2);
@@ -0,0 +1,33 @@
+/* ------------------------------------------------------
+                         bench.c
+
+     Haltepunkte fuer Laufzeitmessungen im Simulator,
+     siehe bench.h
+
+     Die Funktionen muessen als eigenstaendige (nicht
+     inline expandierte) Funktionen erhalten bleiben,
+     pfsbench ermittelt ihre Adressen aus der .map
+     Datei des Projekts.
+
+     Compiler  : SDCC 4.0.3
+     MCU       : PFS154 / PFS173
+
+     R. Seelig
+
+  ------------------------------------------------------- */
+
+#include "bench.h"
+
+/* --------------------------------------------------
+                      bench_start
+   -------------------------------------------------- */
+void bench_start(void)
+{
+}
+
+/* --------------------------------------------------
+                      bench_stop
+   -------------------------------------------------- */
+void bench_stop(void)
+{
+}
@@ -3,6 +3,17 @@
 
     Softwareimplementierung  I2C-Bus (Bitbanging)
 
+    Die Anschluesse und der Name des Busses werden vor
+    dem Uebersetzen festgelegt, fuer jeden weiteren
+    Bus wird diese Datei von einer eigenen Datei mit
+    anderen Angaben eingebunden (siehe i2c.h, i2c_b.c):
+
+      i2c_bus     : Praefix der Funktionsnamen
+      i2c_bus_sda : Dataanschluss, bspw. PA5
+      i2c_bus_scl : Clockanschluss, bspw. PA6
+
+    Ohne Angaben: Bus i2c an i2c_sdapin / i2c_sclpin
+
       Compiler  : SDCC 4.0.3
       MCU       : PFS154 / PFS173
 
@@ -11,6 +22,38 @@
 
 #include "i2c.h"
 
+#if !defined(i2c_bus)
+  #define i2c_bus         i2c
+  #define i2c_bus_sda     i2c_sdapin
+  #define i2c_bus_scl     i2c_sclpin
+#endif
+
+// Name einer Funktion / Variable des Busses, i2c_fn(_start) => i2c_start
+#define i2c_fn(name)      conc2(i2c_bus,name)
+
+// Dataanschluss
+#define i2c_sda_hi()      conc2(i2c_bus_sda,_input_init())
+#define i2c_sda_lo()      { conc2(i2c_bus_sda,_output_init()); conc2(i2c_bus_sda,_clr()); }
+#define i2c_is_sda()      conc2(is_,i2c_bus_sda())
+
+// Clockanschluss
+#if (i2c_clkstretch == 1)
+  #define i2c_scl_hi()    { conc2(i2c_bus_scl,_input_init()); while(!conc2(is_,i2c_bus_scl())); }
+#else
+  #define i2c_scl_hi()    conc2(i2c_bus_scl,_input_init())
+#endif
+#define i2c_scl_lo()      { conc2(i2c_bus_scl,_output_init()); conc2(i2c_bus_scl,_clr()); }
+
+#if (i2c_fastmode == 1)
+  #define short_del()     _delay_ns_exact(i2c_tlow / 2)   // zweimal je Low-Phase
+  #define long_del()      _delay_ns_exact(i2c_tlow)
+  #define wait_del()      { }                             // short_del deckt i2c_thigh ab
+#else
+  #define short_del()     i2c_fn(_delay)(short_puls)
+  #define long_del()      i2c_fn(_delay)(long_puls)
+  #define wait_del()      i2c_fn(_delay)(del_wait)
+#endif
+
 // --------------------------------------------------------------------
 //                      Prototypen aus sw_i2c.h
 // --------------------------------------------------------------------
@@ -75,19 +118,23 @@ uint8_t i2c_read(uint8_t ack);
 
 */
 
-uint8_t I2C_CX;                // universelle Zaehlvariable, aus RAM
-                               // Speicherplatzgruenden hier ausnahmsweise
-                               // global
+// universelle Zaehlvariable und Acknowledge, aus RAM Speicherplatzgruenden
+// hier ausnahmsweise global (je Bus eigene Variable)
+#define I2C_CX            i2c_fn(_cx)
+#define ACK               i2c_fn(_ack)
 
+uint8_t I2C_CX;
 uint8_t ACK;
 
 
+#if (i2c_fastmode == 0)
+
 /* ---------------------------------------------------------
                            i2c_delay
        an die "Reaktionszeiten" der Register des STM8 an-
        gepasste Warteschleife
    --------------------------------------------------------- */
-void i2c_delay(uint8_t anz)
+void i2c_fn(_delay)(uint8_t anz)
 {
   volatile uint8_t count;
 
@@ -97,6 +144,8 @@ void i2c_delay(uint8_t anz)
   }
 }
 
+#endif
+
 /* #################################################################
      Funktionen fuer I2C - Bus (Softwareimplementierung)
    ################################################################# */
@@ -107,7 +156,7 @@ void i2c_delay(uint8_t anz)
     setzt die Pins die fuer den I2C Bus verwendet werden
     als Ausgaenge
    ------------------------------------------------------- */
-void i2c_master_init()
+void i2c_fn(_master_init)()
 {
   i2c_sda_hi();
   i2c_scl_hi();
@@ -117,7 +166,7 @@ void i2c_master_init()
                      i2c_sendstart(void)
     erzeugt die Startcondition auf dem I2C Bus
    ------------------------------------------------------- */
-void i2c_sendstart(void)
+void i2c_fn(_sendstart)(void)
 {
   i2c_scl_hi();
   long_del();
@@ -131,12 +180,12 @@ void i2c_sendstart(void)
     erzeugt die Startcondition und sendet anschliessend
     die Deviceadresse
    ------------------------------------------------------- */
-uint8_t i2c_start(uint8_t addr)
+uint8_t i2c_fn(_start)(uint8_t addr)
 {
 //  uint8_t ack;
 
-  i2c_sendstart();
-  ACK= i2c_write(addr);
+  i2c_fn(_sendstart)();
+  ACK= i2c_fn(_write)(addr);
   return ACK;
 }
 
@@ -147,19 +196,19 @@ uint8_t i2c_start(uint8_t addr)
    rwflag bestimmt, ob das Device beschrieben oder
    gelesen werden soll
   -------------------------------------------------- */
-void i2c_startaddr(uint8_t addr, uint8_t rwflag)
+void i2c_fn(_startaddr)(uint8_t addr, uint8_t rwflag)
 {
   addr = (addr << 1) | rwflag;
 
-  i2c_sendstart();
-  i2c_write(addr);
+  i2c_fn(_sendstart)();
+  i2c_fn(_write)(addr);
 }
 
 /* -------------------------------------------------------
                      i2c_stop
     erzeugt die Stopcondition auf dem I2C Bus
    ------------------------------------------------------- */
-void i2c_stop(void)
+void i2c_fn(_stop)(void)
 {
    i2c_sda_lo();
    long_del();
@@ -175,7 +224,7 @@ void i2c_stop(void)
    schreibt einen Wert auf dem I2C Bus OHNE ein Ack-
    nowledge einzulesen
   ------------------------------------------------------- */
-void i2c_write_nack(uint8_t data)
+void i2c_fn(_write_nack)(uint8_t data)
 {
 
   for(I2C_CX= 0; I2C_CX < 8; I2C_CX++)
@@ -208,11 +257,11 @@ void i2c_write_nack(uint8_t data)
                > 0 wenn Slave ein Acknowledge gegeben hat
                == 0 wenn kein Acknowledge vom Slave
    ------------------------------------------------------- */
-uint8_t i2c_write(uint8_t data)
+uint8_t i2c_fn(_write)(uint8_t data)
 {
 //   uint8_t ack;
 
-   i2c_write_nack(data);
+   i2c_fn(_write_nack)(data);
 
   //  9. Taktimpuls (Ack)
 
@@ -242,13 +291,13 @@ uint8_t i2c_write(uint8_t data)
                > 0 wenn Slave ein Acknowledge gegeben hat
                == 0 wenn kein Acknowledge vom Slave
    ------------------------------------------------------- */
-uint8_t i2c_write16(uint16_t data)
+uint8_t i2c_fn(_write16)(uint16_t data)
 {
 //  uint8_t ack;
 
-  ACK= i2c_write(data >> 8);
+  ACK= i2c_fn(_write)(data >> 8);
   if (!(ACK)) return 0;
-  ACK= i2c_write(data & 0xff);
+  ACK= i2c_fn(_write)(data & 0xff);
 
   return ACK;
 }
@@ -266,18 +315,18 @@ uint8_t i2c_write16(uint16_t data)
    Rueckgabe:
                gelesenes Byte
    ------------------------------------------------------- */
-uint8_t i2c_read(uint8_t ack)
+uint8_t i2c_fn(_read)(uint8_t ack)
 {
   uint8_t data= 0x00;
 
   for(I2C_CX= 0; I2C_CX < 8; I2C_CX++)
   {
     i2c_scl_lo();
-    short_del();
-    i2c_scl_hi();
+    i2c_sda_hi();
+    long_del();
 
+    i2c_scl_hi();
     short_del();
-    i2c_sda_hi();
     wait_del();
 
     if(i2c_is_sda()) data|= (0x80 >> I2C_CX);
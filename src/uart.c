@@ -2,7 +2,11 @@
                          uart.h
 
      Softwaremodul einer Bitbanging erzeugten seriellen
-     Schnittstelle
+     Schnittstelle, wahlweise blockierend oder im
+     Timerinterrupt mit Sende- / Empfangspuffer
+     (uart_irq in uart.h). Blockierend wird der Bit-
+     takt aus einer Warteschleife oder einem Timer
+     abgeleitet (uart_timer in uart.h)
 
      Compiler  : SDCC 4.0.3
      MCU       : PFS154 / PFS173
@@ -16,6 +20,79 @@
 
 #include "uart.h"
 
+/* ---------------------------------------------------------------------------
+     Timer fuer den Bittakt
+
+       uart_irq 2          : Timer2 mit 3 * uart_baud (Interrupt)
+       uart_irq 16         : Timer16 mit 3 * uart_baud (Interrupt)
+       uart_irq 0 und
+       uart_timer 2 bzw. 3 : Timer2 bzw. Timer3 mit uart_baud, die Interrupt-
+                             anforderung wird abgefragt, der Timer loest
+                             keinen Interrupt aus
+   --------------------------------------------------------------------------- */
+
+#if (uart_irq != 0)
+  #define uart_tick       ((F_CPU + (3 * uart_baud / 2)) / (3 * uart_baud))   // Systemtakte je Interrupt
+#else
+  #define uart_tick       ((F_CPU + (uart_baud / 2)) / uart_baud)             // Systemtakte je Bit
+#endif
+
+#if (uart_irq == 2) || ((uart_irq == 0) && (uart_timer == 2))
+
+  #define uart_tmc        TM2C
+  #define uart_tmct       TM2CT
+  #define uart_tms        TM2S
+  #define uart_tmb        TM2B
+  #define uart_tmmode     (TM2C_CLK_SYSCLK | TM2C_MODE_PERIOD)
+  #define uart_tmirq      INTRQ_TM2
+  #define uart_tmint      INTEN_TM2
+
+#elif ((uart_irq == 0) && (uart_timer == 3))
+
+  #define uart_tmc        TM3C
+  #define uart_tmct       TM3CT
+  #define uart_tms        TM3S
+  #define uart_tmb        TM3B
+  #define uart_tmmode     (TM3C_CLK_SYSCLK | TM3C_MODE_PERIOD)
+  #define uart_tmirq      INTRQ_TM3
+  #define uart_tmint      INTEN_TM3
+
+#elif (uart_irq == 16)
+
+  // Timer16: Interrupt beim Setzen von Bit 15, im Interrupt wird der Zaehler
+  // um uart_tick zurueckgestellt. Korrigiert werden die Takte zwischen ldt16
+  // und stt16 (nur Zahlen, der Wert wird auch im Assembler verwendet)
+  #define uart_t16step    (F_CPU / 3 / uart_baud - 5)
+
+#elif (uart_irq != 0) || (uart_timer != 0)
+  #error "uart_irq: 0, 2 oder 16, uart_timer: 0, 2 oder 3"
+#endif
+
+#if defined(uart_tmc)
+
+  // 8-Bit Timer im Periodenbetrieb mit Systemtakt: Vorteiler so waehlen, dass
+  // der Vergleichswert in 8 Bit passt (Bits des Vorteilers in TM3S wie TM2S)
+  #if (uart_tick <= 256)
+    #define uart_tmpre    1
+    #define uart_tmscale  TM2S_PRESCALE_NONE
+  #elif (uart_tick <= 1024)
+    #define uart_tmpre    4
+    #define uart_tmscale  TM2S_PRESCALE_DIV4
+  #elif (uart_tick <= 4096)
+    #define uart_tmpre    16
+    #define uart_tmscale  TM2S_PRESCALE_DIV16
+  #elif (uart_tick <= 16384)
+    #define uart_tmpre    64
+    #define uart_tmscale  TM2S_PRESCALE_DIV64
+  #else
+    #error "uart_baud ist fuer F_CPU zu klein"
+  #endif
+  #define uart_tmbound    (((uart_tick + (uart_tmpre / 2)) / uart_tmpre) - 1)
+
+#endif
+
+#if (uart_irq == 0) && (uart_timer == 0)
+
 /* --------------------------------------------------
                        uart_delay
       Warteschleife zum Einstellen der Baudraten
@@ -65,20 +142,88 @@ void uart_putchar(uint8_t ch)
   uart_delay(uart_delfak);
 }
 
-#if (uart_puts_enable == 1)
-  /* --------------------------------------------------
-                      uart_puts
-        String ueber serielle Schnittstelle senden
-     -------------------------------------------------- */
-  void uart_puts(char *p)
+/* --------------------------------------------------
+                    uart_getchar
+      Zeichen von serieller Schnittstelle lesen
+   -------------------------------------------------- */
+char uart_getchar(void)
+{
+  char ch= 0;
+  uint8_t mask= 1;
+
+  while (is_uartrx());                  // auf Startbit warten
+  uart_delay(uart_delfak+(uart_delfak/2));
+  for (char i= 0; i< 8; i++)
   {
-    do
-    {
-      uart_putchar( *p );
-    } while( *p++);
+    if (is_uartrx()) ch |= mask; else ch &= ~(mask);
+    uart_delay(uart_delfak);
+    mask <<= 1;
   }
+  return ch;
+}
+
 #endif
 
+#if (uart_irq == 0) && (uart_timer != 0)
+
+/* ---------------------------------------------------------------------------
+                    blockierend, Bittakt aus Timer2 / Timer3
+
+     Der Timer laeuft frei im Periodenbetrieb mit der Bitdauer, jede Bit-
+     grenze ist das Setzen der Interruptanforderung des Timers. Die Baudrate
+     haengt damit nicht vom erzeugten Code ab, ein Interrupt waehrend eines
+     Zeichens verschiebt nur die eine Bitflanke (solange er kuerzer als eine
+     Bitdauer ist).
+   --------------------------------------------------------------------------- */
+
+// wartet auf das Ende der laufenden Bitdauer
+#define uart_bitwait()  { while (!(INTRQ & uart_tmirq)); INTRQ &= ~uart_tmirq; }
+
+/* --------------------------------------------------
+                   uart_init
+    serielle Schnittstelle initialisieren.
+
+    In uart.h sind folgende Wertezuweisungen zu
+    taetigen fuer:
+
+    uart_txbit, uart_rxbit  : Anschluesse der UART
+    uart_timer              : 2 oder 3
+    uart_baud               : Baudrate
+
+    Protokoll:  8N1
+   -------------------------------------------------- */
+void uart_init(void)
+{
+  uarttx_init();
+  uartrx_init();
+
+  uart_tmct= 0;
+  uart_tmb= uart_tmbound;
+  uart_tms= (uint8_t)uart_tmscale;
+  uart_tmc= (uint8_t)uart_tmmode;
+  INTEN &= ~uart_tmint;           // kein Interrupt, nur die Anforderung wird abgefragt
+}
+
+/* --------------------------------------------------
+                     uart_putchar
+    Zeichen ueber die serielle Schnittstelle senden
+   -------------------------------------------------- */
+void uart_putchar(uint8_t ch)
+{
+  uart_tmct= 0;                   // Bittakt mit dem Startbit beginnen
+  INTRQ &= ~uart_tmirq;
+  uarttx_clr();                   // Startbit
+  for (char i= 0; i< 8; i++)
+  {
+    uart_bitwait();
+    if (ch & 0x01) uarttx_set(); else uarttx_clr();
+    ch >>= 1;
+  }
+  uart_bitwait();
+  uarttx_set();                   // Stopbit
+  uart_bitwait();
+}
+
 /* --------------------------------------------------
                     uart_getchar
       Zeichen von serieller Schnittstelle lesen
@@ -89,12 +234,220 @@ char uart_getchar(void)
   uint8_t mask= 1;
 
   while (is_uartrx());                  // auf Startbit warten
-  uart_delay(uart_delfak+(uart_delfak/2));
+  uart_tmct= uart_tmbound / 2;          // erste Periode endet in der Mitte des Startbits
+  INTRQ &= ~uart_tmirq;
+  uart_bitwait();
   for (char i= 0; i< 8; i++)
   {
+    uart_bitwait();                     // Mitte des Datenbits
     if (is_uartrx()) ch |= mask; else ch &= ~(mask);
-    uart_delay(uart_delfak);
     mask <<= 1;
   }
   return ch;
 }
+
+#endif
+
+#if (uart_irq != 0)
+
+/* ---------------------------------------------------------------------------
+                         Interruptbetrieb (uart_irq 2 / 16)
+
+     Der Timerinterrupt laeuft mit der dreifachen Baudrate. Gesendet wird
+     bei jedem dritten Interrupt ein Bit, beim Empfang wird die Leitung bei
+     jedem Interrupt auf ein Startbit geprueft, die Datenbits und das Stopbit
+     werden anschliessend in der Bitmitte (4 bzw. je 3 Interrupts spaeter)
+     gelesen.
+   --------------------------------------------------------------------------- */
+
+static volatile uint8_t txbuf[uart_txbufsize];
+static volatile uint8_t rxbuf[uart_rxbufsize];
+static volatile uint8_t txhead, txtail;        // Schreib- / Leseindex
+static volatile uint8_t rxhead, rxtail;
+
+static volatile uint8_t txcnt;                 // Bits des laufenden Zeichens (uart_flush)
+static uint8_t txdata, txphase;                // nur im Interrupt verwendet
+static uint8_t rxdata, rxcnt, rxphase;
+
+/* --------------------------------------------------
+                       uart_init
+
+    Anschluesse und Timer initialisieren, Interrupts
+    werden zugelassen
+
+    Protokoll:  8N1
+   -------------------------------------------------- */
+void uart_init(void)
+{
+  uarttx_init();
+  uartrx_init();
+
+  txhead= 0; txtail= 0; txcnt= 0; txphase= 0;
+  rxhead= 0; rxtail= 0; rxcnt= 0;
+
+  #if (uart_irq == 2)
+    uart_tmct= 0;
+    uart_tmb= uart_tmbound;
+    uart_tms= (uint8_t)uart_tmscale;
+    uart_tmc= (uint8_t)uart_tmmode;
+    INTEN |= uart_tmint;          // Timerinterrupt zulassen
+  #else
+    // Systemtakt, kein Teiler, Interrupt bei Bit 15
+    T16M = (uint8_t)(T16M_CLK_SYSCLK | T16M_CLK_DIV1 | T16M_INTSRC_15BIT);
+    INTEN |= INTEN_T16;           // Timerinterrupt zulassen
+  #endif
+  __engint();                     // grundsaetzlich Interrupt zulassen
+}
+
+/* --------------------------------------------------
+                       uart_isr
+
+    Bittakt der seriellen Schnittstelle, muss vom
+    Interrupthandler bei jedem Interrupt des Timers
+    aufgerufen werden (Interruptanforderung quittiert
+    der Handler)
+   -------------------------------------------------- */
+void uart_isr(void)
+{
+  uint8_t n;
+
+  #if (uart_irq == 16)
+    // Zaehler um eine Periode zurueckstellen, die seit dem Interrupt ver-
+    // strichenen Takte bleiben erhalten (keine Drift durch die Latenz)
+    __asm
+      ldt16 __t16c
+      mov   a, #(uart_t16step & 0xff)
+      sub   __t16c+0, a
+      mov   a, #(uart_t16step >> 8)
+      subc  __t16c+1, a
+      stt16 __t16c
+    __endasm;
+  #endif
+
+  // ---------------- Senden, ein Bit je 3 Interrupts ----------------
+  if (txphase)
+  {
+    txphase--;
+  }
+  else
+  {
+    txphase= 2;
+    if (txcnt > 1)                              // Datenbits
+    {
+      if (txdata & 0x01) uarttx_set(); else uarttx_clr();
+      txdata >>= 1;
+      txcnt--;
+    }
+    else if (txcnt)                             // Stopbit
+    {
+      uarttx_set();
+      txcnt= 0;
+    }
+    else if (txhead != txtail)                  // naechstes Zeichen, Startbit
+    {
+      txdata= txbuf[txtail];
+      txtail= (txtail + 1) & (uart_txbufsize - 1);
+      uarttx_clr();
+      txcnt= 9;
+    }
+    else
+    {
+      txphase= 0;                               // nichts zu senden
+    }
+  }
+
+  // ---------------- Empfangen ----------------
+  if (rxcnt)
+  {
+    if (!(--rxphase))
+    {
+      rxphase= 3;
+      if (--rxcnt)                              // Datenbits, LSB zuerst
+      {
+        rxdata >>= 1;
+        if (is_uartrx()) rxdata |= 0x80;
+      }
+      else                                      // Stopbit
+      {
+        n= (rxhead + 1) & (uart_rxbufsize - 1);
+        if ((is_uartrx()) && (n != rxtail))     // kein Rahmenfehler, Puffer nicht voll
+        {
+          rxbuf[rxhead]= rxdata;
+          rxhead= n;
+        }
+      }
+    }
+  }
+  else if (!(is_uartrx()))                      // Startbit
+  {
+    rxcnt= 9;
+    rxphase= 4;                                 // Mitte des ersten Datenbits
+  }
+}
+
+/* --------------------------------------------------
+                     uart_putchar
+    Zeichen in den Sendepuffer schreiben, gewartet
+    wird nur bei vollem Puffer
+   -------------------------------------------------- */
+void uart_putchar(char ch)
+{
+  uint8_t n;
+
+  n= (txhead + 1) & (uart_txbufsize - 1);
+  while (n == txtail);
+  txbuf[txhead]= ch;
+  txhead= n;
+}
+
+/* --------------------------------------------------
+                      uart_flush
+    wartet, bis der Sendepuffer leer und das letzte
+    Zeichen vollstaendig gesendet ist (die Leitung
+    liegt dann auf Ruhepegel)
+   -------------------------------------------------- */
+void uart_flush(void)
+{
+  while ((txhead != txtail) || (txcnt));
+}
+
+/* --------------------------------------------------
+                    uart_available
+      Anzahl der empfangenen, noch nicht gelesenen
+      Zeichen
+   -------------------------------------------------- */
+uint8_t uart_available(void)
+{
+  return (rxhead - rxtail) & (uart_rxbufsize - 1);
+}
+
+/* --------------------------------------------------
+                    uart_getchar
+      Zeichen aus dem Empfangspuffer lesen, ist der
+      Puffer leer, wird auf ein Zeichen gewartet
+   -------------------------------------------------- */
+char uart_getchar(void)
+{
+  char ch;
+
+  while (rxhead == rxtail);
+  ch= rxbuf[rxtail];
+  rxtail= (rxtail + 1) & (uart_rxbufsize - 1);
+  return ch;
+}
+
+#endif
+
+#if (uart_puts_enable == 1)
+  /* --------------------------------------------------
+                      uart_puts
+        String ueber serielle Schnittstelle senden
+     -------------------------------------------------- */
+  void uart_puts(char *p)
+  {
+    do
+    {
+      uart_putchar( *p );
+    } while( *p++);
+  }
+#endif
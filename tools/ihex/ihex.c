@@ -0,0 +1,232 @@
+/* ------------------------------------------------------------
+                              ihex.c
+
+      Einlesen von Intel-Hex Dateien fuer die Hostprogramme,
+      siehe ihex.h
+
+      Aufbau eines Datensatzes:
+
+        :LLAAAATTDD...DDCC
+
+        LL   : Anzahl Datenbytes
+        AAAA : Adresse (Bytes)
+        TT   : Typ, 00 = Daten, 01 = Dateiende,
+               02 = erweiterte Segmentadresse,
+               04 = erweiterte lineare Adresse,
+               03 / 05 = Startadresse (ignoriert)
+        CC   : Pruefsumme, Summe aller Bytes von LL
+               bis CC ist 0 (modulo 256)
+
+      Compiler: GCC
+
+      R. Seelig
+   ------------------------------------------------------------ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ihex.h"
+
+/* --------------------------------------------------
+     Dekodiertabelle: Wert der Hexziffer mit ge-
+     setztem Bit 4, 0 = ungueltiges Zeichen
+   -------------------------------------------------- */
+static const uint8_t hextab[256] =
+{
+  ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+  ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+  ['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d, ['E'] = 0x1e, ['F'] = 0x1f,
+  ['a'] = 0x1a, ['b'] = 0x1b, ['c'] = 0x1c, ['d'] = 0x1d, ['e'] = 0x1e, ['f'] = 0x1f
+};
+
+/* --------------------------------------------------
+                        hexbyte
+
+     dekodiert 2 Hexziffern ab p
+
+     Rueckgabe:
+        Bytewert, -1 bei ungueltigem Zeichen
+   -------------------------------------------------- */
+static inline int hexbyte(const uint8_t *p)
+{
+  uint8_t h, l;
+
+  h= hextab[p[0]];
+  l= hextab[p[1]];
+  if (!(h & l & 0x10)) return -1;
+  return ((h & 0x0f) << 4) | (l & 0x0f);
+}
+
+/* --------------------------------------------------
+                       ihex_parse
+
+     wertet den Dateiinhalt buf[0..len-1] aus
+   -------------------------------------------------- */
+static int ihex_parse(const uint8_t *buf, size_t len, ihex_image *img)
+{
+  const uint8_t *p, *end;
+  uint32_t line, base, adr, bytelen, typ, i;
+  int      b;
+  uint8_t  sum;
+
+  p= buf;
+  end= buf + len;
+  line= 1;
+  base= 0;
+
+  while (p < end)
+  {
+    if (*p != ':')
+    {
+      if (*p == '\n') line++;
+      p++;                                       // Zeilenende, Leerzeichen
+      continue;
+    }
+
+    img->errline= line;
+    if ((end - p) < 11) return ihex_syntax;
+    b= hexbyte(p+1);
+    if (b < 0) return ihex_syntax;
+    bytelen= b;
+    if ((end - p) < (11 + (bytelen*2))) return ihex_syntax;
+
+    // Pruefsumme ueber den gesamten Datensatz, dabei alle Ziffern pruefen
+    sum= 0;
+    for (i= 0; i < (bytelen + 5); i++)
+    {
+      b= hexbyte(p + 1 + (i*2));
+      if (b < 0) return ihex_syntax;
+      sum += b;
+    }
+    if (sum) return ihex_checksum;
+
+    adr= (hexbyte(p+3) << 8) | hexbyte(p+5);
+    typ= hexbyte(p+7);
+    p += 9;
+    img->records++;
+
+    switch (typ)
+    {
+      case 0x00 :                                // Datenbytes
+      {
+        adr += base;
+        for (i= 0; i < bytelen; i++, adr++, p += 2)
+        {
+          b= hexbyte(p);
+          if ((adr >> 1) < img->wordcnt)
+          {
+            if (adr & 1)
+              img->words[adr >> 1]= (img->words[adr >> 1] & 0x00ff) | (b << 8);
+            else
+              img->words[adr >> 1]= (img->words[adr >> 1] & 0xff00) | b;
+            if ((adr + 1) > img->maxadr) img->maxadr= adr + 1;
+            img->databytes++;
+          }
+          else
+          {
+            if ((adr + 1) > img->outadr) img->outadr= adr + 1;
+          }
+        }
+        break;
+      }
+      case 0x01 :                                // Dateiende
+      {
+        img->errline= 0;
+        return ihex_ok;
+      }
+      case 0x02 :                                // erweiterte Segmentadresse
+      {
+        if (bytelen != 2) return ihex_syntax;
+        base= ((hexbyte(p) << 8) | hexbyte(p+2)) << 4;
+        p += 4;
+        break;
+      }
+      case 0x04 :                                // erweiterte lineare Adresse
+      {
+        if (bytelen != 2) return ihex_syntax;
+        base= ((hexbyte(p) << 8) | hexbyte(p+2)) << 16;
+        p += 4;
+        break;
+      }
+      default :                                  // Startadressen
+      {
+        p += bytelen*2;
+        break;
+      }
+    }
+    p += 2;                                      // Pruefsumme
+  }
+
+  img->errline= 0;
+  return ihex_ok;
+}
+
+/* --------------------------------------------------
+                        ihex_load
+
+     liest die Hexdatei fname in das vom Aufrufer
+     in img->words / img->wordcnt bereitgestellte
+     Word-Abbild. Das Abbild wird zuvor geloescht
+     (0xffff), Daten ausserhalb des Abbilds werden
+     nur in img->outadr vermerkt.
+
+     Rueckgabe:
+        ihex_ok, ihex_nofile, ihex_syntax oder
+        ihex_checksum (Zeile in img->errline)
+   -------------------------------------------------- */
+int ihex_load(const char *fname, ihex_image *img)
+{
+  struct stat st;
+  uint8_t *buf;
+  int     fd, err;
+
+  memset(img->words, 0xff, img->wordcnt * sizeof(uint16_t));
+  img->maxadr= 0;
+  img->outadr= 0;
+  img->databytes= 0;
+  img->records= 0;
+  img->errline= 0;
+
+  fd= open(fname, O_RDONLY);
+  if (fd < 0) return ihex_nofile;
+  if (fstat(fd, &st) < 0)
+  {
+    close(fd);
+    return ihex_nofile;
+  }
+  if (!st.st_size)                               // leere Datei, mmap nicht moeglich
+  {
+    close(fd);
+    return ihex_ok;
+  }
+
+  buf= mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (buf == MAP_FAILED) return ihex_nofile;
+
+  err= ihex_parse(buf, st.st_size, img);
+  munmap(buf, st.st_size);
+  return err;
+}
+
+/* --------------------------------------------------
+                       ihex_errstr
+
+     Klartext zu einem Rueckgabewert von ihex_load
+   -------------------------------------------------- */
+const char *ihex_errstr(int err)
+{
+  switch (err)
+  {
+    case ihex_ok       : return "ok";
+    case ihex_nofile   : return "no such file";
+    case ihex_syntax   : return "error in hexfile";
+    case ihex_checksum : return "checksum error in hexfile";
+    default            : return "unknown error";
+  }
+}
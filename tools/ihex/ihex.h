@@ -0,0 +1,49 @@
+/* ------------------------------------------------------
+                         ihex.h
+
+     Header fuer das gemeinsame Einlesen von Intel-Hex
+     Dateien der Hostprogramme (pfsreadhex, pfsflash)
+
+     Die Datei wird in den Speicher eingeblendet (mmap)
+     und in einem einzigen Durchgang ohne Zwischen-
+     kopien ausgewertet. Hexziffern werden ueber eine
+     Tabelle dekodiert, die Pruefsumme jedes Daten-
+     satzes wird geprueft.
+
+     Ergebnis ist ein Word-Abbild wie im Controller:
+     Word n besteht aus den Bytes 2n (Lo) und 2n+1 (Hi)
+     der Hexdatei, unbeschriebene Words sind 0xffff.
+
+     Compiler  : GCC
+
+     R. Seelig
+
+  ------------------------------------------------------- */
+
+#ifndef in_ihex
+  #define in_ihex
+
+  #include <stdint.h>
+
+  // Rueckgabewerte von ihex_load
+  #define ihex_ok          0
+  #define ihex_nofile      1             // Datei nicht vorhanden / nicht lesbar
+  #define ihex_syntax      2             // fehlerhafter Datensatz
+  #define ihex_checksum    3             // Pruefsumme eines Datensatzes falsch
+
+  typedef struct
+  {
+    uint16_t *words;                     // Word-Abbild, vom Aufrufer bereitgestellt
+    uint32_t wordcnt;                    // Groesse des Abbilds in Words
+
+    uint32_t maxadr;                     // hoechste belegte Byteadresse + 1 im Abbild
+    uint32_t outadr;                     // dto. ausserhalb des Abbilds (0 = keine)
+    uint32_t databytes;                  // Anzahl Datenbytes im Abbild
+    uint32_t records;                    // Anzahl Datensaetze
+    uint32_t errline;                    // Zeile des ersten Fehlers
+  } ihex_image;
+
+  int ihex_load(const char *fname, ihex_image *img);
+  const char *ihex_errstr(int err);
+
+#endif
@@ -0,0 +1,381 @@
+/* ------------------------------------------------------------
+                           pfsbench.c
+
+      Laufzeitmessungen (Benchmarks) eines Projekts im
+      Simulator spdk (ucsim fuer Padauk, tools/bin/spdk)
+      und Vergleich mit einer eingecheckten Referenz.
+
+      Das Projekt bettet die zu messenden Aufrufe mit dem
+      Makro BENCH (bench.h) zwischen bench_start und
+      bench_stop ein. pfsbench
+
+        - ermittelt die Adressen beider Funktionen aus der
+          .map Datei des Projekts
+        - entnimmt die Namen der Messungen dem Quelltext
+        - laesst das Programm in spdk mit Haltepunkten auf
+          beiden Funktionen laufen und liest nach jedem
+          Halt den Zyklenzaehler des Simulators
+        - vergleicht die Zyklen je Messung mit der Referenz
+          (projekt.bench) oder schreibt diese neu (update)
+
+      Eine Messung ohne Eintrag in der Referenz gilt wie
+      eine Verschlechterung als Fehler, eine fehlende
+      Referenz wuerde sonst jede Regression verdecken.
+
+      Die Zyklen sind die des Simulators einschliesslich
+      des konstanten Aufwands fuer das Verlassen von
+      bench_start und den Aufruf von bench_stop. Sie sind
+      reproduzierbar und damit fuer den Vergleich mit der
+      Referenz geeignet, aber keine Zeitangabe: ucsim
+      zaehlt jeden Befehl der Padauk-Kerne als einen Takt,
+      auch Spruenge (Takte lt. Datenblatt: pfscycles).
+
+      Compiler: GCC
+
+      R. Seelig
+   ------------------------------------------------------------ */
+
+#define _GNU_SOURCE                    // mkstemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#define max_bench    128
+#define sim_timeout  60                // Sekunden, falls das Programm haengt
+
+struct benchcase
+{
+  char     name[64];
+  long     cycles;                     // gemessen, -1 = nicht erreicht
+  long     base;                       // Referenz, -1 = keine
+};
+
+struct benchcase bench[max_bench];
+int   benchanz = 0;
+
+/* --------------------------------------------------
+                        usage
+   -------------------------------------------------- */
+void usage(void)
+{
+  printf("\n Syntax: pfsbench projectfile [options]");
+  printf("\n\n Note: enter name of projectfile WITHOUT any extensions, needs");
+  printf("\n       projectfile.c, .map and .ihx");
+  printf("\n\n Options:");
+  printf("\n     cpu=pdk14       : core of the simulator (pdk13, pdk14, pdk15)");
+  printf("\n     fcpu=n          : system clock in Hz");
+  printf("\n     spdk=path       : simulator (default ../tools/bin/spdk)");
+  printf("\n     baseline=file   : reference (default projectfile.bench)");
+  printf("\n     tol=n           : allowed increase in percent (default 0)");
+  printf("\n     update          : write measured values as new reference");
+  printf("\n\n     Example: pfsbench bench_core cpu=pdk14 fcpu=8000000\n\n");
+}
+
+/* --------------------------------------------------
+                     mapfile_symbol
+
+     sucht die Adresse eines globalen Symbols in der
+     Map des Linkers (Bytes), Rueckgabe Wordadresse
+     oder -1
+   -------------------------------------------------- */
+long mapfile_symbol(char *dname, char *symbol)
+{
+  FILE *tdat;
+  char tx[512], name[128];
+  long adr;
+
+  tdat= fopen(dname, "r");
+  if (!tdat) return -1;
+  while (fgets(tx, sizeof(tx), tdat))
+  {
+    if ((sscanf(tx, " %lx %127s", &adr, name) == 2) && (!strcmp(name, symbol)))
+    {
+      fclose(tdat);
+      return adr / 2;
+    }
+  }
+  fclose(tdat);
+  return -1;
+}
+
+/* --------------------------------------------------
+                      source_names
+
+     liest die Namen der Messungen BENCH(name, ...)
+     in der Reihenfolge des Quelltextes
+   -------------------------------------------------- */
+int source_names(char *dname)
+{
+  FILE *tdat;
+  char tx[512], *p, *c;
+  int  incomment, i;
+
+  tdat= fopen(dname, "r");
+  if (!tdat) return -1;
+  incomment= 0;
+  while (fgets(tx, sizeof(tx), tdat))
+  {
+    // Kommentare ausblenden
+    if (incomment)
+    {
+      c= strstr(tx, "*/");
+      if (!c) continue;
+      memmove(tx, c + 2, strlen(c + 2) + 1);
+      incomment= 0;
+    }
+    c= strstr(tx, "/*");
+    if (c)
+    {
+      if (!strstr(c, "*/")) incomment= 1;
+      *c= 0;
+    }
+    c= strstr(tx, "//");
+    if (c) *c= 0;
+
+    p= strstr(tx, "BENCH(");
+    if ((!p) || (strstr(tx, "#define")) || (benchanz >= max_bench)) continue;
+    p += 6;
+    while (isspace((unsigned char)*p)) p++;
+    for (i= 0; (i < 63) && (isalnum((unsigned char)p[i]) || (p[i] == '_')); i++)
+      bench[benchanz].name[i]= p[i];
+    bench[benchanz].name[i]= 0;
+    bench[benchanz].cycles= -1;
+    bench[benchanz].base= -1;
+    benchanz++;
+  }
+  fclose(tdat);
+  return benchanz;
+}
+
+/* --------------------------------------------------
+                      baseline_read
+   -------------------------------------------------- */
+void baseline_read(char *dname)
+{
+  FILE *tdat;
+  char tx[256], name[64];
+  long cyc;
+  int  i;
+
+  tdat= fopen(dname, "r");
+  if (!tdat) return;
+  while (fgets(tx, sizeof(tx), tdat))
+  {
+    if ((tx[0] == '#') || (sscanf(tx, "%63s %ld", name, &cyc) != 2)) continue;
+    for (i= 0; i < benchanz; i++)
+      if (!strcmp(bench[i].name, name)) bench[i].base= cyc;
+  }
+  fclose(tdat);
+}
+
+/* --------------------------------------------------
+                      baseline_write
+   -------------------------------------------------- */
+int baseline_write(char *dname, char *project, char *cpu, long fcpu)
+{
+  FILE *tdat;
+  int  i;
+
+  tdat= fopen(dname, "w");
+  if (!tdat) return 1;
+  fprintf(tdat, "# pfsbench reference for %s (spdk -t %s, F_CPU %ld)\n", project, cpu, fcpu);
+  fprintf(tdat, "# name  cycles between bench_start and bench_stop\n");
+  for (i= 0; i < benchanz; i++)
+    if (bench[i].cycles >= 0) fprintf(tdat, "%s %ld\n", bench[i].name, bench[i].cycles);
+  fclose(tdat);
+  return 0;
+}
+
+/* --------------------------------------------------
+                        sim_run
+
+     laesst das Programm im Simulator laufen. Fuer
+     jede Messung wird zweimal angehalten (bench_start,
+     bench_stop), nach jedem Halt liefert "state" den
+     Stand des Zyklenzaehlers:
+
+       "Stop at 0x00002a: (104) Breakpoint"
+       "Total time since last reset= 4.75e-06 sec (38 clks)"
+
+     Rueckgabe:
+        Anzahl vollstaendiger Messungen, -1 = Simulator
+        nicht startbar
+   -------------------------------------------------- */
+int sim_run(char *spdk, char *cpu, long fcpu, char *ihx, long adrstart, long adrstop)
+{
+  FILE *tdat, *sim;
+  char cmdname[] = "/tmp/pfsbenchXXXXXX";
+  char cmd[1024], tx[512], *p;
+  int  fd, i, anz;
+  long stopadr, clks, startclks;
+  char atstart;
+
+  fd= mkstemp(cmdname);
+  if (fd < 0) return -1;
+  tdat= fdopen(fd, "w");
+  fprintf(tdat, "break 0x%lx\nbreak 0x%lx\n", adrstart, adrstop);
+  for (i= 0; i < benchanz * 2; i++) fprintf(tdat, "run\nstate\n");
+  fprintf(tdat, "quit\n");
+  fclose(tdat);
+
+  snprintf(cmd, sizeof(cmd), "timeout %d %s -t %s -X %ld -b %s < %s 2>&1",
+           sim_timeout, spdk, cpu, fcpu, ihx, cmdname);
+  sim= popen(cmd, "r");
+  if (!sim)
+  {
+    unlink(cmdname);
+    return -1;
+  }
+
+  anz= 0;
+  stopadr= -1;
+  atstart= 0;
+  startclks= 0;
+  while (fgets(tx, sizeof(tx), sim))
+  {
+    if (sscanf(tx, "Stop at 0x%lx", &stopadr) == 1) continue;
+    if ((!strncmp(tx, "Total time", 10)) && (p= strchr(tx, '(')) && (sscanf(p, "(%ld clks)", &clks) == 1))
+    {
+      if (stopadr == adrstart)
+      {
+        startclks= clks;
+        atstart= 1;
+      }
+      else if ((stopadr == adrstop) && (atstart) && (anz < benchanz))
+      {
+        bench[anz++].cycles= clks - startclks;
+        atstart= 0;
+      }
+      stopadr= -1;
+    }
+  }
+  pclose(sim);
+  unlink(cmdname);
+  return anz;
+}
+
+/* ---------------------------------------------------------------------------
+                                    M A I N
+   --------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+  char  project[256], fname[300], baseline[300], ihx[300];
+  char  *cpu, *spdk, *p;
+  long  fcpu, adrstart, adrstop, diff;
+  int   i, update, tol, anz, result, nobase;
+
+  if (argc < 2)
+  {
+    usage();
+    return 1;
+  }
+
+  snprintf(project, sizeof(project), "%s", argv[1]);
+  snprintf(baseline, sizeof(baseline), "%s.bench", project);
+  cpu= "pdk14";
+  spdk= "../tools/bin/spdk";
+  fcpu= 8000000;
+  update= 0;
+  tol= 0;
+  for (i= 2; i < argc; i++)
+  {
+    p= argv[i];
+    if (!strncmp(p, "cpu=", 4)) cpu= p + 4;
+    else if (!strncmp(p, "fcpu=", 5)) fcpu= atol(p + 5);
+    else if (!strncmp(p, "spdk=", 5)) spdk= p + 5;
+    else if (!strncmp(p, "baseline=", 9)) snprintf(baseline, sizeof(baseline), "%s", p + 9);
+    else if (!strncmp(p, "tol=", 4)) tol= atoi(p + 4);
+    else if (!strcmp(p, "update")) update= 1;
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  snprintf(fname, sizeof(fname), "%s.c", project);
+  if (source_names(fname) <= 0)
+  {
+    printf("\n   No BENCH() in %s\n\n", fname);
+    return 2;
+  }
+
+  snprintf(fname, sizeof(fname), "%s.map", project);
+  adrstart= mapfile_symbol(fname, "_bench_start");
+  adrstop= mapfile_symbol(fname, "_bench_stop");
+  if ((adrstart < 0) || (adrstop < 0))
+  {
+    printf("\n   No _bench_start / _bench_stop in %s (link ../src/bench.rel)\n\n", fname);
+    return 2;
+  }
+
+  snprintf(ihx, sizeof(ihx), "%s.ihx", project);
+  if (access(ihx, R_OK))
+  {
+    printf("\n   No such file: %s\n\n", ihx);
+    return 2;
+  }
+
+  anz= sim_run(spdk, cpu, fcpu, ihx, adrstart, adrstop);
+  if (anz < 0)
+  {
+    printf("\n   Cannot start simulator %s\n\n", spdk);
+    return 2;
+  }
+
+  if (!update) baseline_read(baseline);
+
+  printf("\nBenchmark                   cycles   baseline      diff\n");
+  printf("--------------------------  --------  --------  --------\n");
+  result= 0;
+  nobase= 0;
+  for (i= 0; i < benchanz; i++)
+  {
+    printf("%-26s", bench[i].name);
+    if (bench[i].cycles < 0)
+    {
+      printf("  %8s  (not reached)\n", "-");
+      result= 3;
+      continue;
+    }
+    printf("  %8ld", bench[i].cycles);
+    if (update) { printf("\n"); continue; }
+    if (bench[i].base < 0)
+    {
+      printf("  %8s  NO REFERENCE\n", "-");
+      nobase++;
+      result= 3;
+      continue;
+    }
+    diff= bench[i].cycles - bench[i].base;
+    printf("  %8ld  %+8ld", bench[i].base, diff);
+    if ((diff > 0) && ((diff * 100) > (bench[i].base * tol)))
+    {
+      printf("  REGRESSION (%+.1f%%)", (double)diff * 100.0 / (bench[i].base ? bench[i].base : 1));
+      result= 3;
+    }
+    printf("\n");
+  }
+
+  if (anz < benchanz)
+    printf("\nSimulation ended after %d of %d benchmarks\n", anz, benchanz);
+
+  if (nobase)
+    printf("\n%d benchmark(s) without reference in %s, check the values and\n"
+           "record them with 'make bench-update'\n", nobase, baseline);
+
+  if (update)
+  {
+    if (baseline_write(baseline, project, cpu, fcpu))
+    {
+      printf("\n   Cannot write %s\n\n", baseline);
+      return 2;
+    }
+    printf("\nReference written to %s\n", baseline);
+  }
+  printf("\n");
+  return result;
+}
@@ -0,0 +1,984 @@
+/* ------------------------------------------------------------
+                           pfscycles.c
+
+      Statische Laufzeitanalyse (Taktzyklen) der von SDCC
+      erzeugten Assemblerdateien (.asm) eines Projekts fuer
+      Padauk PFS154 / PFS173 (pdk14 / pdk15).
+
+      Fuer jede Funktion wird aus dem Kontrollfluss die
+      kuerzeste und die laengste schleifenfreie Laufzeit
+      ermittelt, zusaetzlich die Dauer eines Durchlaufs
+      aller enthaltenen Schleifen. Aufrufe (call, goto
+      auf eine andere Funktion) werden mit der Laufzeit
+      der aufgerufenen Funktion eingerechnet.
+
+      Funktionen, die mit reti enden, sind Interrupthandler.
+      Fuer sie wird der ungunstigste Pfad gegen ein Budget
+      (budget=n) geprueft, ein Interrupt mit einer Schleife
+      ohne angegebene Durchlaufzahl (loops=n) ist nicht
+      begrenzt und wird ebenfalls gemeldet. Ruft ein
+      Interrupthandler unbekannte Funktionen auf (ext-call)
+      oder ist ein .rept / .if nicht auswertbar (inexact),
+      ist die Laufzeit nur eine untere Grenze, die Pruefung
+      schlaegt dann ebenfalls fehl.
+
+      Inline-Assembler (bspw. _delay_cycles aus delay.h):
+      .rept n .. .endm wird n mal gezaehlt, von .if / .else
+      / .endif nur der zutreffende Zweig, goto .-n / .+n
+      springt innerhalb der Funktion. Die Zaehlschleife
+      mov a,#k / dzsn a / goto .-1 zaehlt 3 * k Zyklen.
+
+      Zyklen lt. Datenblatt PFS154:
+
+        goto, call, ret, reti, pcadd, idxm,
+        ldtabl, ldtabh, ldsptl, ldspth      : 2 Zyklen
+        ceqsn, cneqsn, t0sn, t1sn, izsn,
+        dzsn (auch .io)                     : 1 Zyklus,
+                                              2 beim Ueberspringen
+        alle anderen                        : 1 Zyklus
+
+      Compiler: GCC
+
+      R. Seelig
+   ------------------------------------------------------------ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define max_instr    16384               // Instruktionen aller Module
+#define max_func     512
+#define max_label    8192
+#define max_mod      64
+#define max_succ     34                  // Nachfolger einer Instruktion (pcadd-Tabellen)
+
+#define novalue      -1L                 // Pfad ohne Ausgang (nur Schleife)
+
+// Instruktionstypen
+#define it_normal    0
+#define it_goto      1
+#define it_call      2
+#define it_ret       3                   // ret, reti
+#define it_skip      4                   // bedingtes Ueberspringen
+#define it_pcadd     5                   // berechneter Sprung
+
+struct instr
+{
+  int      func;                         // Index der Funktion
+  int      line;                         // Zeile in der .asm Datei
+  char     typ;
+  long     cost;                         // Zyklen ohne Sprung / Ueberspringen
+  char     target[64];                   // Sprung- / Aufrufziel
+  int      rel;                          // Ziel von goto .+n / .-n, -1 = keines
+  char     hasimm;                       // mov a,#k mit bekanntem k
+  long     imm;
+};
+
+struct function
+{
+  char     name[64];
+  int      module;
+  int      first, last;                  // Instruktionen first .. last-1
+  char     isr;                          // enthaelt reti
+  char     state;                        // 0 : offen, 1 : in Arbeit, 2 : fertig
+  char     recursive;
+  char     external;                     // ruft unbekannte Funktionen auf
+  char     inexact;                      // .rept / .if nicht auswertbar
+  long     min, max;                     // schleifenfreie Laufzeit
+  long     loop;                         // Zyklen je Durchlauf aller Schleifen
+};
+
+struct label
+{
+  char     name[64];
+  int      func;                         // lokale Label (nnnnn$) gelten je Funktion
+  int      instr;
+};
+
+struct instr    code[max_instr];
+struct function funcs[max_func];
+struct label    labels[max_label];
+char            modules[max_mod][64];
+
+int  codeanz = 0;
+int  funcanz = 0;
+int  labelanz = 0;
+int  modanz = 0;
+
+long loopbound = -1;                     // angenommene Schleifendurchlaeufe, -1 = unbekannt
+
+/* --------------------------------------------------
+                        usage
+   -------------------------------------------------- */
+void usage(void)
+{
+  printf("\n Syntax: pfscycles projectfile|file.asm [file.asm ...] [options]");
+  printf("\n\n Note: enter name of projectfile WITHOUT any extensions, the");
+  printf("\n       modules are taken from projectfile.lk (.rel -> .asm)");
+  printf("\n\n Options:");
+  printf("\n     fcpu=n      : system clock in Hz, times in us are added");
+  printf("\n     budget=n    : max. cycles of an interrupt handler");
+  printf("\n     budget=nus  : dto. in us (needs fcpu)");
+  printf("\n     loops=n     : assume n passes of every loop");
+  printf("\n     all         : list all functions (default: with calls / loops)");
+  printf("\n\n     Example: pfscycles blink fcpu=8000000 budget=20us\n\n");
+}
+
+/* --------------------------------------------------
+                      instr_class
+
+     ordnet einer Mnemonic Typ und Zyklen zu
+   -------------------------------------------------- */
+void instr_class(char *mnem, struct instr *in)
+{
+  static const char *skips[]  = { "ceqsn", "cneqsn", "t0sn", "t1sn", "izsn", "dzsn", 0 };
+  static const char *twocyc[] = { "idxm", "ldtabl", "ldtabh", "ldsptl", "ldspth", 0 };
+  char   base[16];
+  int    i;
+
+  // Erweiterungen wie t0sn.io abschneiden
+  snprintf(base, sizeof(base), "%s", mnem);
+  if (strchr(base, '.')) *strchr(base, '.')= 0;
+
+  in->typ= it_normal;
+  in->cost= 1;
+  if (!strcmp(base, "goto"))  { in->typ= it_goto;  in->cost= 2; return; }
+  if (!strcmp(base, "call"))  { in->typ= it_call;  in->cost= 2; return; }
+  if (!strcmp(base, "pcadd")) { in->typ= it_pcadd; in->cost= 2; return; }
+  if ((!strcmp(base, "ret")) || (!strcmp(base, "reti"))) { in->typ= it_ret; in->cost= 2; return; }
+  for (i= 0; skips[i]; i++)
+    if (!strcmp(base, skips[i])) { in->typ= it_skip; return; }
+  for (i= 0; twocyc[i]; i++)
+    if (!strcmp(base, twocyc[i])) { in->cost= 2; return; }
+}
+
+/* --------------------------------------------------
+                        codearea
+
+     Instruktionen werden nur in Code-Areas gezaehlt
+   -------------------------------------------------- */
+int codearea(char *name)
+{
+  static const char *areas[] = { "CODE", "HOME", "GSINIT", "GSFINAL", "HEADER", "CABS", 0 };
+  int i;
+
+  if (*name == '_') name++;
+  for (i= 0; areas[i]; i++) if (!strcmp(name, areas[i])) return 1;
+  return 0;
+}
+
+/* --------------------------------------------------
+                        func_new
+   -------------------------------------------------- */
+int func_new(char *name, int module)
+{
+  struct function *f;
+
+  if (funcanz >= max_func) return -1;
+  if (funcanz) funcs[funcanz-1].last= codeanz;
+  f= &funcs[funcanz];
+  memset(f, 0, sizeof(struct function));
+  snprintf(f->name, sizeof(f->name), "%s", name);
+  f->module= module;
+  f->first= codeanz;
+  f->last= codeanz;
+  return funcanz++;
+}
+
+/* --------------------------------------------------
+                       label_find
+
+     sucht ein Label, lokale Label (mit '$') nur in
+     der Funktion func
+
+     Rueckgabe:
+        Index der Instruktion, -1 = nicht gefunden
+   -------------------------------------------------- */
+int label_find(char *name, int func)
+{
+  int i, local;
+
+  local= (strchr(name, '$') != 0);
+  for (i= 0; i < labelanz; i++)
+  {
+    if (strcmp(labels[i].name, name)) continue;
+    if ((local) && (labels[i].func != func)) continue;
+    return labels[i].instr;
+  }
+  return -1;
+}
+
+/* --------------------------------------------------
+                       func_find
+   -------------------------------------------------- */
+int func_find(char *name)
+{
+  int i;
+
+  for (i= 0; i < funcanz; i++)
+    if (!strcmp(funcs[i].name, name)) return i;
+  return -1;
+}
+
+/* --------------------------------------------------
+                       expr_eval
+
+     wertet einen konstanten Ausdruck des Assemblers
+     aus (Zahlen dezimal / 0x.., ( ), unaer - ~, * / %,
+     + -, << >>, &, ^, |), wie er in .rept, .if und
+     mov a,#k aus delay.h steht
+
+     Rueckgabe:
+        0 bei Erfolg, *v erhaelt den Wert
+   -------------------------------------------------- */
+int expr_level(char **p, int level, long *v);
+
+int expr_unary(char **p, long *v)
+{
+  char *q;
+
+  while (isspace((unsigned char)**p)) (*p)++;
+  if (**p == '(')
+  {
+    (*p)++;
+    if (expr_level(p, 0, v)) return 1;
+    while (isspace((unsigned char)**p)) (*p)++;
+    if (**p != ')') return 1;
+    (*p)++;
+    return 0;
+  }
+  if (**p == '-') { (*p)++; if (expr_unary(p, v)) return 1; *v= -*v; return 0; }
+  if (**p == '~') { (*p)++; if (expr_unary(p, v)) return 1; *v= ~*v; return 0; }
+  if (**p == '+') { (*p)++; return expr_unary(p, v); }
+  if (!isdigit((unsigned char)**p)) return 1;
+  *v= strtol(*p, &q, 0);
+  *p= q;
+  return 0;
+}
+
+int expr_level(char **p, int level, long *v)
+{
+  static const char *ops[5][3] = { { "|", 0, 0 }, { "^", 0, 0 }, { "&", 0, 0 },
+                                   { "<<", ">>", 0 }, { "+", "-", 0 } };
+  long  r;
+  int   i, len;
+  char  op;
+
+  if (level == 6) return expr_unary(p, v);
+  if (level == 5)
+  {
+    // * / %
+    if (expr_unary(p, v)) return 1;
+    while (1)
+    {
+      while (isspace((unsigned char)**p)) (*p)++;
+      op= **p;
+      if ((op != '*') && (op != '/') && (op != '%')) return 0;
+      (*p)++;
+      if (expr_unary(p, &r)) return 1;
+      if ((op != '*') && (!r)) return 1;
+      if (op == '*') *v *= r; else if (op == '/') *v /= r; else *v %= r;
+    }
+  }
+  if (expr_level(p, level + 1, v)) return 1;
+  while (1)
+  {
+    while (isspace((unsigned char)**p)) (*p)++;
+    for (i= 0; ops[level][i]; i++)
+    {
+      len= strlen(ops[level][i]);
+      if (strncmp(*p, ops[level][i], len)) continue;
+      // & nicht mit &&, | nicht mit ||, << nicht mit < verwechseln
+      if ((len == 1) && ((*p)[1] == **p)) continue;
+      break;
+    }
+    if (!ops[level][i]) return 0;
+    op= ops[level][i][0];
+    *p += len;
+    if (expr_level(p, level + 1, &r)) return 1;
+    switch (op)
+    {
+      case '|' : *v |= r; break;
+      case '^' : *v ^= r; break;
+      case '&' : *v &= r; break;
+      case '<' : *v <<= r; break;
+      case '>' : *v >>= r; break;
+      case '+' : *v += r; break;
+      case '-' : *v -= r; break;
+    }
+  }
+}
+
+int expr_eval(char *p, long *v)
+{
+  if (expr_level(&p, 0, v)) return 1;
+  while (isspace((unsigned char)*p)) p++;
+  return (*p) ? 1 : 0;
+}
+
+/* --------------------------------------------------
+                       asm_lines
+
+     verarbeitet die Zeilen first .. last-1 einer
+     .asm Datei. Ein Block .rept n .. .endm wird n mal
+     verarbeitet, bei .if / .else / .endif nur der
+     zutreffende Teil. Ist der Ausdruck nicht aus-
+     wertbar, wird der Block einmal gezaehlt und die
+     Funktion als ungenau markiert.
+
+     Die Zaehlschleife mov a,#k / dzsn a / goto .-1
+     (delay.h) wird zu einer Instruktion mit 3 * k
+     Zyklen (k= 0: 768) zusammengefasst.
+
+     Rueckgabe:
+        0 : fehlerfrei, 2 : zu viele Instruktionen /
+        Label
+   -------------------------------------------------- */
+char **asmtx;                            // Zeilen der Datei
+int  incode;                             // in einer Code-Area
+int  curfunc;                            // aktuelle Funktion, -1 = keine
+
+int asm_lines(int first, int last, int module)
+{
+  char tx[512], tok[64], arg[64], *p, *q;
+  int  line, i, depth, skip, n, done[32], cond[32], iflevel;
+  long v;
+  struct instr *in;
+
+  iflevel= 0;                            // Verschachtelung .if
+  skip= 0;                               // > 0 : Zeilen bis zum passenden .else / .endif
+  for (line= first; line < last; line++)
+  {
+    snprintf(tx, sizeof(tx), "%s", asmtx[line]);
+    // Kommentare entfernen (';', bei Inline-Assembler auch '//')
+    p= strchr(tx, ';');
+    if (p) *p= 0;
+    p= strstr(tx, "//");
+    if (p) *p= 0;
+
+    p= tx;
+    while (1)
+    {
+      while (isspace((unsigned char)*p)) p++;
+      if (!*p) break;
+
+      // Token lesen
+      q= tok;
+      while ((*p) && (!isspace((unsigned char)*p)) && (*p != ':') && ((q - tok) < 63)) *q++= *p++;
+      *q= 0;
+
+      // bedingte Bloecke
+      if (!strncmp(tok, ".if", 3))
+      {
+        if (iflevel < 32)
+        {
+          cond[iflevel]= 1;
+          if (skip) cond[iflevel]= 0;
+          else if (!strcmp(tok, ".if"))
+          {
+            if (expr_eval(p, &v))
+            {
+              if ((incode) && (curfunc >= 0)) funcs[curfunc].inexact= 1;
+            }
+            else cond[iflevel]= (v != 0);
+          }
+          else if ((incode) && (curfunc >= 0)) funcs[curfunc].inexact= 1;
+          done[iflevel]= cond[iflevel];
+          if ((!skip) && (!cond[iflevel])) skip= iflevel + 1;
+        }
+        iflevel++;
+        break;
+      }
+      if ((!strcmp(tok, ".else")) || (!strcmp(tok, ".endif")))
+      {
+        if (!iflevel) break;
+        if (!strcmp(tok, ".endif"))
+        {
+          iflevel--;
+          if (skip == iflevel + 1) skip= 0;
+          break;
+        }
+        if (iflevel > 32) break;
+        if ((!skip) || (skip == iflevel))
+        {
+          // .else gilt, wenn noch kein Zweig zutraf
+          if (done[iflevel - 1]) skip= iflevel;
+          else { skip= 0; done[iflevel - 1]= 1; }
+        }
+        break;
+      }
+      if (skip) break;
+
+      if (*p == ':')                     // Label, "name:" oder "name::"
+      {
+        while (*p == ':') p++;
+        if (!incode) continue;
+        if (!strchr(tok, '$'))
+        {
+          curfunc= func_new(tok, module);
+          if (curfunc < 0) return 2;
+        }
+        if ((labelanz >= max_label) || (curfunc < 0)) return 2;
+        snprintf(labels[labelanz].name, 64, "%s", tok);
+        labels[labelanz].func= curfunc;
+        labels[labelanz].instr= codeanz;
+        labelanz++;
+        continue;                        // nach dem Label kann eine Instruktion folgen
+      }
+
+      if (!strcmp(tok, ".rept"))
+      {
+        // passendes .endm suchen
+        depth= 1;
+        for (i= line + 1; i < last; i++)
+        {
+          if (sscanf(asmtx[i], " %63s", arg) != 1) continue;
+          if ((!strcmp(arg, ".rept")) || (!strcmp(arg, ".irp")) ||
+              (!strcmp(arg, ".irpc")) || (!strcmp(arg, ".macro"))) depth++;
+          if ((!strcmp(arg, ".endm")) && (!--depth)) break;
+        }
+        if (expr_eval(p, &v))
+        {
+          v= 1;
+          if ((incode) && (curfunc >= 0)) funcs[curfunc].inexact= 1;
+        }
+        for (n= 0; n < v; n++)
+          if (asm_lines(line + 1, i, module)) return 2;
+        line= i;
+        break;
+      }
+
+      if (tok[0] == '.')                 // Direktive
+      {
+        if (!strcmp(tok, ".area"))
+        {
+          if (sscanf(p, " %63[^ \t(\r\n]", arg) == 1) incode= codearea(arg);
+          if (!incode) curfunc= -1;
+        }
+        break;
+      }
+
+      if ((!incode) || (curfunc < 0) || (strchr(tok, '='))) break;
+      if (codeanz >= max_instr) return 2;
+
+      // Instruktion, erstes Argument ist bei goto / call das Ziel
+      in= &code[codeanz];
+      memset(in, 0, sizeof(struct instr));
+      in->func= curfunc;
+      in->line= line + 1;
+      in->rel= -1;
+      instr_class(tok, in);
+      if (sscanf(p, " %63[^ \t,\r\n]", arg) == 1) snprintf(in->target, 64, "%s", arg);
+
+      // goto .-n / .+n: relativ zur Instruktion (1 Word je Instruktion)
+      if ((in->typ == it_goto) && (in->target[0] == '.') &&
+          ((in->target[1] == '-') || (in->target[1] == '+')) && (!expr_eval(in->target + 1, &v)))
+        in->rel= codeanz + v;
+
+      if (!strcmp(tok, "mov"))
+      {
+        q= strchr(p, '#');
+        if ((q) && (sscanf(p, " %63[^ \t,]", arg) == 1) && (!strcmp(arg, "a")) &&
+            (!expr_eval(q + 1, &in->imm)))
+          in->hasimm= 1;
+      }
+
+      // Zaehlschleife mov a,#k / dzsn a / goto .-1 zusammenfassen, ein
+      // Label darf nur vor dem mov stehen
+      if ((in->rel == codeanz - 1) && (codeanz - 2 >= funcs[curfunc].first) &&
+          (code[codeanz-2].hasimm) && (!strcmp(code[codeanz-1].target, "a")) &&
+          (code[codeanz-1].typ == it_skip) && (labelanz) &&
+          (labels[labelanz-1].instr < codeanz - 1))
+      {
+        v= code[codeanz-2].imm & 0xff;
+        code[codeanz-2].cost= 3 * (v ? v : 256);
+        code[codeanz-2].hasimm= 0;
+        codeanz--;
+        funcs[curfunc].last= codeanz;
+        break;
+      }
+
+      codeanz++;
+      funcs[curfunc].last= codeanz;
+      if (in->typ == it_ret)
+      {
+        if (!strcmp(tok, "reti")) funcs[curfunc].isr= 1;
+      }
+      break;
+    }
+  }
+  return 0;
+}
+
+/* --------------------------------------------------
+                       asmfile_read
+
+     liest eine .asm Datei von SDCC (oder eine Datei
+     im gleichen Format) ein
+
+     Rueckgabe:
+        0 : fehlerfrei, 1 : Datei nicht vorhanden,
+        2 : zu viele Instruktionen / Label
+   -------------------------------------------------- */
+int asmfile_read(char *dname)
+{
+  FILE *tdat;
+  char tx[512], *p, *base;
+  int  module, anz, max, i, err;
+
+  tdat= fopen(dname, "r");
+  if (!tdat) return 1;
+
+  if (modanz >= max_mod) { fclose(tdat); return 2; }
+  base= strrchr(dname, '/');
+  base= base ? base + 1 : dname;
+  snprintf(modules[modanz], 64, "%s", base);
+  p= strstr(modules[modanz], ".asm");
+  if (p) *p= 0;
+  module= modanz++;
+
+  // Datei einlesen, .rept Bloecke werden mehrfach verarbeitet
+  anz= 0;
+  max= 0;
+  asmtx= 0;
+  while (fgets(tx, sizeof(tx), tdat))
+  {
+    if (anz >= max)
+    {
+      max= max ? max * 2 : 1024;
+      asmtx= realloc(asmtx, max * sizeof(char *));
+      if (!asmtx) { fclose(tdat); return 2; }
+    }
+    asmtx[anz]= strdup(tx);
+    if (!asmtx[anz]) { fclose(tdat); return 2; }
+    anz++;
+  }
+  fclose(tdat);
+
+  incode= 0;
+  curfunc= -1;                           // noch keine Funktion
+  err= asm_lines(0, anz, module);
+
+  for (i= 0; i < anz; i++) free(asmtx[i]);
+  free(asmtx);
+  if (funcanz) funcs[funcanz-1].last= codeanz;
+  return err;
+}
+
+/* --------------------------------------------------
+                       lkfile_read
+
+     liest die Module aus dem Linkerskript (.lk) und
+     deren .asm Dateien
+
+     Rueckgabe:
+        Anzahl gelesener Module
+   -------------------------------------------------- */
+int lkfile_read(char *dname)
+{
+  FILE *tdat;
+  char tx[512], asmname[520], *p;
+  int  anz;
+
+  tdat= fopen(dname, "r");
+  if (!tdat) return 0;
+
+  anz= 0;
+  while (fgets(tx, sizeof(tx), tdat))
+  {
+    tx[strcspn(tx, "\r\n")]= 0;
+    p= strstr(tx, ".rel");
+    if ((tx[0] == '-') || (!p) || (p[4])) continue;
+    *p= 0;
+    snprintf(asmname, sizeof(asmname), "%s.asm", tx);
+    if (!asmfile_read(asmname)) anz++;
+    else fprintf(stderr, "Note   : no %s found\n", asmname);
+  }
+  fclose(tdat);
+  return anz;
+}
+
+/* ---------------------------------------------------------------------------
+                            Kontrollflussanalyse
+   --------------------------------------------------------------------------- */
+
+struct succ
+{
+  int   instr;                           // Index, -1 = Funktion verlassen
+  int   extra;                           // zusaetzliche Zyklen dieser Kante
+};
+
+void func_analyse(int fn);
+
+/* --------------------------------------------------
+                       succ_get
+
+     ermittelt die Nachfolger der Instruktion i.
+     *callmin / *callmax / *callloop erhalten die
+     Laufzeit einer aufgerufenen Funktion
+
+     Rueckgabe:
+        Anzahl Nachfolger
+   -------------------------------------------------- */
+int succ_get(int i, struct succ *s, long *callmin, long *callmax, long *callloop)
+{
+  struct instr    *in = &code[i];
+  struct function *f  = &funcs[in->func];
+  int   n, t, fn;
+
+  *callmin= 0; *callmax= 0; *callloop= 0;
+  n= 0;
+
+  switch (in->typ)
+  {
+    case it_normal :
+    {
+      s[n].instr= (i+1 < f->last) ? i+1 : -1; s[n++].extra= 0;
+      break;
+    }
+    case it_skip :
+    {
+      s[n].instr= (i+1 < f->last) ? i+1 : -1; s[n++].extra= 0;
+      s[n].instr= (i+2 < f->last) ? i+2 : -1; s[n++].extra= 1;
+      break;
+    }
+    case it_ret :
+    {
+      s[n].instr= -1; s[n++].extra= 0;
+      break;
+    }
+    case it_pcadd :
+    {
+      // Sprungtabelle: nachfolgende goto / ret
+      for (t= i+1; (t < f->last) && (n < max_succ); t++)
+      {
+        if ((code[t].typ != it_goto) && (code[t].typ != it_ret)) break;
+        s[n].instr= t; s[n++].extra= 0;
+      }
+      if (!n) { s[n].instr= -1; s[n++].extra= 0; }
+      break;
+    }
+    case it_goto :
+    case it_call :
+    {
+      if (in->rel >= 0)                  // goto .-n / .+n
+      {
+        s[n].instr= ((in->rel >= f->first) && (in->rel < f->last)) ? in->rel : -1;
+        if (s[n].instr < 0) f->external= 1;
+        s[n++].extra= 0;
+        break;
+      }
+      t= label_find(in->target, in->func);
+      if ((t >= 0) && (t < codeanz) && (code[t].func == in->func) && (in->typ == it_goto))
+      {
+        s[n].instr= t; s[n++].extra= 0;  // Sprung innerhalb der Funktion
+        break;
+      }
+      fn= func_find(in->target);
+      if (fn >= 0)
+      {
+        func_analyse(fn);
+        if (funcs[fn].state != 2) f->recursive= 1;
+        if (funcs[fn].recursive) f->recursive= 1;
+        if (funcs[fn].external) f->external= 1;
+        *callmin= (funcs[fn].min != novalue) ? funcs[fn].min : 0;
+        *callmax= (funcs[fn].max != novalue) ? funcs[fn].max : 0;
+        *callloop= funcs[fn].loop;
+      }
+      else f->external= 1;               // Bibliothek o.ae.
+
+      // call kehrt zurueck, goto auf eine andere Funktion nicht
+      if (in->typ == it_call) s[n].instr= (i+1 < f->last) ? i+1 : -1;
+      else s[n].instr= -1;
+      s[n++].extra= 0;
+      break;
+    }
+  }
+  return n;
+}
+
+/* --------------------------------------------------
+                       func_analyse
+
+     ermittelt min / max / loop einer Funktion:
+
+       - Tiefensuche ab dem Einsprung markiert
+         Rueckwaertskanten (Schleifen)
+       - laengster / kuerzester Pfad ohne Rueck-
+         waertskanten bis zum Verlassen der Funktion
+       - je Rueckwaertskante u -> h: laengster Pfad
+         h .. u = Zyklen eines Schleifendurchlaufs
+
+     Verschachtelte Schleifen werden nicht multi-
+     pliziert, das Ergebnis ist eine Abschaetzung.
+   -------------------------------------------------- */
+void func_analyse(int fn)
+{
+  struct function *f = &funcs[fn];
+  int    n, i, j, k, t, cnt, sp;
+  int    *order, *stack, *pos, *mark;
+  char   *back;
+  long   *cmin, *cmax, *cloop, *lmax, *lmin, *lto, v, vmin;
+  struct succ (*succs)[max_succ];
+  int    *nsucc;
+
+  if (f->state) return;                  // fertig oder Rekursion
+  f->state= 1;
+  n= f->last - f->first;
+  f->min= 0; f->max= 0; f->loop= 0;
+  if (n <= 0) { f->state= 2; return; }
+
+  succs= calloc(n, sizeof(*succs));
+  nsucc= calloc(n, sizeof(int));
+  back = calloc(n * max_succ, 1);
+  cmin = calloc(n, sizeof(long));
+  cmax = calloc(n, sizeof(long));
+  cloop= calloc(n, sizeof(long));
+  lmax = calloc(n, sizeof(long));
+  lmin = calloc(n, sizeof(long));
+  lto  = calloc(n, sizeof(long));
+  order= calloc(n, sizeof(int));
+  stack= calloc(n, sizeof(int));
+  pos  = calloc(n, sizeof(int));
+  mark = calloc(n, sizeof(int));
+
+  // Nachfolger, Indizes relativ zur Funktion
+  for (i= 0; i < n; i++)
+  {
+    nsucc[i]= succ_get(f->first + i, succs[i], &cmin[i], &cmax[i], &cloop[i]);
+    for (j= 0; j < nsucc[i]; j++)
+      if (succs[i][j].instr >= 0) succs[i][j].instr -= f->first;
+  }
+
+  // Tiefensuche: mark 0 = unbesucht, 1 = auf dem Stack, 2 = fertig
+  cnt= 0; sp= 0;
+  stack[sp++]= 0; mark[0]= 1; pos[0]= 0;
+  while (sp)
+  {
+    i= stack[sp-1];
+    if (pos[i] < nsucc[i])
+    {
+      j= pos[i]++;
+      k= succs[i][j].instr;
+      if (k < 0) continue;
+      if (mark[k] == 1) back[i*max_succ + j]= 1;
+      else if (!mark[k]) { mark[k]= 1; pos[k]= 0; stack[sp++]= k; }
+    }
+    else
+    {
+      mark[i]= 2;
+      order[cnt++]= i;                   // Postorder: Nachfolger zuerst
+      sp--;
+    }
+  }
+
+  // laengster / kuerzester Pfad bis zum Verlassen
+  for (k= 0; k < cnt; k++)
+  {
+    i= order[k];
+    lmax[i]= novalue; lmin[i]= novalue;
+    for (j= 0; j < nsucc[i]; j++)
+    {
+      if (back[i*max_succ + j]) continue;
+      t= succs[i][j].instr;
+      if (t < 0) { v= 0; vmin= 0; }          // Funktion wird verlassen
+      else
+      {
+        if (lmax[t] == novalue) continue;    // kein Ausgang ohne Schleife
+        v= lmax[t] + succs[i][j].extra;
+        vmin= lmin[t] + succs[i][j].extra;
+      }
+      if (v > lmax[i]) lmax[i]= v;
+      if ((lmin[i] == novalue) || (vmin < lmin[i])) lmin[i]= vmin;
+    }
+    if (lmax[i] != novalue)
+    {
+      lmax[i] += code[f->first + i].cost + cmax[i];
+      lmin[i] += code[f->first + i].cost + cmin[i];
+    }
+    f->loop += cloop[i];
+  }
+  f->max= lmax[0];
+  f->min= lmin[0];
+
+  // Schleifen: je Rueckwaertskante i -> h laengster Pfad h .. i
+  for (i= 0; i < n; i++)
+  {
+    for (j= 0; j < nsucc[i]; j++)
+    {
+      int h;
+
+      if (!back[i*max_succ + j]) continue;
+      h= succs[i][j].instr;
+      for (k= 0; k < cnt; k++)
+      {
+        int m = order[k], s;
+
+        lto[m]= novalue;
+        if (m == i) { lto[m]= code[f->first + m].cost + cmax[m] + succs[i][j].extra; continue; }
+        for (s= 0; s < nsucc[m]; s++)
+        {
+          int t = succs[m][s].instr;
+          if ((t < 0) || (back[m*max_succ + s]) || (lto[t] == novalue)) continue;
+          if (lto[t] + succs[m][s].extra > lto[m]) lto[m]= lto[t] + succs[m][s].extra;
+        }
+        if (lto[m] != novalue) lto[m] += code[f->first + m].cost + cmax[m];
+      }
+      if (lto[h] != novalue) f->loop += lto[h];
+    }
+  }
+
+  free(succs); free(nsucc); free(back); free(cmin); free(cmax); free(cloop);
+  free(lmax); free(lmin); free(lto); free(order); free(stack); free(pos); free(mark);
+  f->state= 2;
+}
+
+/* --------------------------------------------------
+                        cyc_print
+
+     gibt Zyklen (und us bei bekanntem Takt) aus
+   -------------------------------------------------- */
+void cyc_print(char *label, long cyc, long fcpu)
+{
+  if (cyc == novalue) { printf(" %8s", "-"); if (fcpu) printf(" %10s", ""); return; }
+  printf(" %8ld", cyc);
+  if (fcpu) printf(" %8.2fus", (double)cyc * 1000000.0 / fcpu);
+  (void)label;
+}
+
+/* ---------------------------------------------------------------------------
+                                    M A I N
+   --------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+  char   fname[512], *p;
+  long   fcpu, budget, total;
+  int    i, err, anz, showall, result;
+  struct function *f;
+
+  if (argc < 2)
+  {
+    usage();
+    return 1;
+  }
+
+  fcpu= 0; budget= 0; showall= 0; anz= 0;
+  for (i= 1; i < argc; i++)
+  {
+    p= argv[i];
+    if (!strncmp(p, "fcpu=", 5)) fcpu= atol(p + 5);
+    else if (!strncmp(p, "loops=", 6)) loopbound= atol(p + 6);
+    else if (!strcmp(p, "all")) showall= 1;
+    else if (!strncmp(p, "budget=", 7))
+    {
+      budget= strtol(p + 7, &p, 10);
+      if (!strcmp(p, "us"))
+      {
+        if (!fcpu)
+        {
+          printf("\n   budget in us needs fcpu= before budget=\n\n");
+          return 1;
+        }
+        budget= budget * (fcpu / 1000) / 1000;
+      }
+    }
+    else if (strchr(p, '='))
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  // Dateien: file.asm direkt, sonst Projekt ueber .lk
+  for (i= 1; i < argc; i++)
+  {
+    p= argv[i];
+    err= 0;
+    if ((strchr(p, '=')) || (!strcmp(p, "all"))) continue;
+    if ((strlen(p) > 4) && (!strcmp(p + strlen(p) - 4, ".asm")))
+    {
+      err= asmfile_read(p);
+      if (!err) anz++;
+    }
+    else
+    {
+      snprintf(fname, sizeof(fname), "%s.lk", p);
+      anz += lkfile_read(fname);
+      if (!anz)
+      {
+        snprintf(fname, sizeof(fname), "%s.asm", p);
+        err= asmfile_read(fname);
+        if (!err) anz++;
+      }
+    }
+    if (err == 2)
+    {
+      printf("\n   Too many instructions / labels in %s\n\n", p);
+      return 2;
+    }
+  }
+  if (!anz)
+  {
+    printf("\n   No .asm files found (build with the intermediate files kept)\n\n");
+    return 2;
+  }
+
+  for (i= 0; i < funcanz; i++) func_analyse(i);
+
+  printf("\nFunction                   Module          min");
+  if (fcpu) printf("           ");
+  printf("      max");
+  if (fcpu) printf("           ");
+  printf("  loop/pass  Flags\n");
+  printf("-------------------------  ------------  --------------------------------------------------\n");
+  for (i= 0; i < funcanz; i++)
+  {
+    f= &funcs[i];
+    if (f->first == f->last) continue;   // Daten (Tabellen) in der Code-Area
+    if ((!showall) && (!f->isr) && (!f->loop) && (f->max == f->min)) continue;
+    printf("%-25s  %-12s", f->name[0] == '_' ? f->name + 1 : f->name, modules[f->module]);
+    cyc_print("min", f->min, fcpu);
+    cyc_print("max", f->max, fcpu);
+    if (f->loop) printf(" %10ld", f->loop); else printf(" %10s", "");
+    printf("  %s%s%s%s%s\n", f->isr ? "ISR " : "", f->loop ? "loop " : "",
+           f->recursive ? "recursive " : "", f->external ? "ext-call " : "",
+           f->inexact ? "inexact" : "");
+  }
+
+  // Interrupthandler gegen das Budget pruefen
+  result= 0;
+  for (i= 0; i < funcanz; i++)
+  {
+    f= &funcs[i];
+    if (!f->isr) continue;
+    printf("\nISR %s: worst case", f->name[0] == '_' ? f->name + 1 : f->name);
+    if ((f->loop) && (loopbound < 0))
+    {
+      printf(" %ld + n * %ld cycles (loop, no bound) ", f->max, f->loop);
+      if (budget) { printf("=> UNBOUNDED"); result= 3; }
+      printf("\n");
+      continue;
+    }
+    total= f->max + ((loopbound > 0) ? loopbound * f->loop : 0);
+    // unbekannte Aufrufe / Wiederholungen: nur eine untere Grenze
+    printf(" %s%ld cycles", ((f->external) || (f->inexact)) ? "at least " : "", total);
+    if (fcpu) printf(" (%.2f us)", (double)total * 1000000.0 / fcpu);
+    if (f->recursive) printf(", recursive");
+    if (f->external) printf(", calls unknown functions (not counted)");
+    if (f->inexact) printf(", .rept / .if not evaluated");
+    if (budget)
+    {
+      if (total > budget) { printf(" => EXCEEDS budget of %ld cycles", budget); result= 3; }
+      else if ((f->external) || (f->inexact) || (f->recursive))
+      {
+        printf(" => NOT CHECKED, lower bound only (budget %ld cycles)", budget);
+        result= 3;
+      }
+      else printf(" => ok (budget %ld cycles)", budget);
+    }
+    printf("\n");
+  }
+  printf("\n");
+  return result;
+}
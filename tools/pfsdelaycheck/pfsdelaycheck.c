@@ -0,0 +1,1028 @@
+/* ------------------------------------------------------------
+                         pfsdelaycheck.c
+
+      Prueft die taktgenauen Verzoegerungen aus delay.h
+      (_delay_cycles, _delay_us_exact, _delay_ns_exact)
+      gegen die Taktzyklen lt. Datenblatt.
+
+      Die Aufrufe werden mit dem Praeprozessor von SDCC
+      (sdcpp) aus dem unveraenderten delay.h expandiert,
+      die erzeugten Befehlsfolgen mit sdaspdk14 assem-
+      bliert und mit sdldpdk gelinkt. Damit rechnet der
+      Assembler die Schleifenzaehler (.rept / .if, 24 Bit
+      vorzeichenbehaftet) genau wie beim Uebersetzen
+      eines Projekts aus.
+
+      Anschliessend wird das gelinkte Abbild (.ihx) ab
+      jeder Befehlsfolge bis zu deren abschliessendem ret
+      ausgefuehrt und die Takte gezaehlt:
+
+        goto                            : 2 Zyklen
+        dzsn a                          : 1 Zyklus,
+                                          2 beim Ueberspringen
+        mov a,#k / nop                  : 1 Zyklus
+
+      spdk (ucsim) ist hierfuer nicht geeignet, er zaehlt
+      jeden Befehl der Padauk-Kerne als einen Takt.
+
+      Geprueft werden:
+
+        - _delay_cycles(n) fuer n= 0..max (Default 2400,
+          damit mehrere 765er Bloecke mit allen Resten)
+          und einige Stichproben bis 65000
+        - _delay_us_exact(us) fuer us= 0..500, erwartet
+          wird genau ceil(F_CPU * us / 1e6)
+        - _delay_ns_exact(ns) fuer ns= 0..20000, erwartet
+          wird ceil(F_CPU * ns / 1e9) bis 1 Takt mehr
+
+      beide Wrapper fuer jedes angegebene F_CPU (Default
+      8 und 16 MHz, bei 16 MHz ist F_CPU fuer die 24 Bit
+      des Assemblers zu gross).
+
+      Zusaetzlich werden fuer dieselben F_CPU die Low-
+      und High-Phasen von SCL des Software-I2C im Fast-
+      Mode (src/i2c.c mit dem i2c.h aus bench_i2cfast)
+      aus den Verzoegerungen zwischen den Flanken gegen
+      tLOW >= 1300 ns und tHIGH >= 600 ns geprueft
+      (siehe i2c_expand).
+
+      Compiler: GCC
+
+      R. Seelig
+   ------------------------------------------------------------ */
+
+#define _GNU_SOURCE                    // mkdtemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <limits.h>
+#include <ctype.h>
+
+#include "ihex.h"
+
+#define max_fcpu     8
+#define max_words    1536              // Words je Durchgang (goto: 11 Bit)
+#define max_cycles   10000000L         // Abbruch, falls die Folge nicht endet
+
+// Opcodes pdk14
+#define op_nop       0x0000
+#define op_ret       0x007a
+#define op_dzsna     0x0063
+#define op_movak     0x2f00            // mov a,#k  : 0x2f00 | k
+#define op_goto      0x3000            // goto k    : 0x3000 | k (11 Bit)
+
+struct delaycase
+{
+  char     call[64];                   // Aufruf im Quelltext, bspw. _delay_ns_exact(600)
+  long     fcpu;
+  long     min;                        // erwartete Takte
+  long     max;
+  char     *code;                      // expandierte Befehlsfolge
+  long     cycles;                     // gemessen, -1 = nicht ermittelt
+};
+
+struct delaycase *cases = 0;
+int   caseanz = 0;
+int   casemax = 0;
+
+char  tooldir[PATH_MAX];
+char  tmpdir[]     = "/tmp/pfsdelaycheckXXXXXX";
+
+/* --------------------------------------------------
+                        usage
+   -------------------------------------------------- */
+void usage(void)
+{
+  printf("\n Syntax: pfsdelaycheck [options]");
+  printf("\n\n Options:");
+  printf("\n     max=n           : check _delay_cycles(0..n) (default 2400)");
+  printf("\n     fcpu=n          : F_CPU for the us / ns wrappers, may be repeated");
+  printf("\n                       (default 8000000 and 16000000)");
+  printf("\n     tools=path      : directory with bin/ and include/ of the toolchain,");
+  printf("\n                       delay.h is taken from path/../include (default ..)");
+  printf("\n     i2c=path        : directory with the fast mode i2c.h for the SCL");
+  printf("\n                       check of src/i2c.c (default ../bench_i2cfast),");
+  printf("\n                       i2c= without path skips the check");
+  printf("\n     verbose         : list every case");
+  printf("\n\n     Example: pfsdelaycheck max=800 fcpu=9600000\n\n");
+}
+
+/* --------------------------------------------------
+                       case_add
+
+     haengt einen Testfall an, min / max sind die
+     erwarteten Takte
+   -------------------------------------------------- */
+void case_add(char *call, long fcpu, long min, long max)
+{
+  if (caseanz >= casemax)
+  {
+    casemax= casemax ? casemax * 2 : 1024;
+    cases= realloc(cases, casemax * sizeof(struct delaycase));
+    if (!cases)
+    {
+      printf("\n   Out of memory\n\n");
+      exit(2);
+    }
+  }
+  snprintf(cases[caseanz].call, sizeof(cases[caseanz].call), "%s", call);
+  cases[caseanz].fcpu= fcpu;
+  cases[caseanz].min= min;
+  cases[caseanz].max= max;
+  cases[caseanz].code= 0;
+  cases[caseanz].cycles= -1;
+  caseanz++;
+}
+
+/* --------------------------------------------------
+                     asm_expand
+
+     liest die Zeichenkette eines __asm__( "..." "..." )
+     ab p aus der Ausgabe des Praeprozessors, fuegt die
+     Stringliterale zusammen und loest \n, \t, \" und \\
+     auf.
+
+     Rueckgabe:
+        Zeiger hinter die schliessende Klammer, 0 bei
+        einem Fehler, *code zeigt auf den Text
+   -------------------------------------------------- */
+char *asm_expand(char *p, char **code)
+{
+  size_t len, size;
+  char   *s;
+
+  size= 256;
+  len= 0;
+  s= malloc(size);
+  if (!s) return 0;
+
+  while ((*p) && (*p != ')'))
+  {
+    if (*p != '"') { p++; continue; }
+    p++;
+    while ((*p) && (*p != '"'))
+    {
+      if (len + 2 >= size)
+      {
+        size *= 2;
+        s= realloc(s, size);
+        if (!s) return 0;
+      }
+      if (*p == '\\')
+      {
+        p++;
+        switch (*p)
+        {
+          case 'n' : s[len++]= '\n'; break;
+          case 't' : s[len++]= '\t'; break;
+          default  : s[len++]= *p; break;
+        }
+        if (*p) p++;
+        continue;
+      }
+      s[len++]= *p++;
+    }
+    if (*p) p++;
+  }
+  if (*p != ')')
+  {
+    free(s);
+    return 0;
+  }
+  s[len]= 0;
+  *code= s;
+  return p + 1;
+}
+
+/* --------------------------------------------------
+                      cases_expand
+
+     expandiert alle Testfaelle eines F_CPU mit sdcpp
+     aus delay.h (ein Aufruf je Zeile, Reihenfolge wie
+     in cases)
+
+     Rueckgabe:
+        0 bei Erfolg
+   -------------------------------------------------- */
+int cases_expand(long fcpu)
+{
+  FILE   *tdat;
+  char   cname[300], oname[300], cmd[3 * PATH_MAX + 1024];
+  char   *buf, *p;
+  long   size;
+  int    i;
+
+  snprintf(cname, sizeof(cname), "%s/expand.c", tmpdir);
+  snprintf(oname, sizeof(oname), "%s/expand.i", tmpdir);
+
+  tdat= fopen(cname, "w");
+  if (!tdat) return 1;
+  fprintf(tdat, "#define F_CPU %ld\n#include \"delay.h\"\n", fcpu);
+  for (i= 0; i < caseanz; i++)
+    if (cases[i].fcpu == fcpu) fprintf(tdat, "%s;\n", cases[i].call);
+  fclose(tdat);
+
+  snprintf(cmd, sizeof(cmd), "%s/bin/sdcpp -nostdinc -P -I%s/../include -I%s/include %s -o %s",
+           tooldir, tooldir, tooldir, cname, oname);
+  if (system(cmd)) return 1;
+
+  tdat= fopen(oname, "r");
+  if (!tdat) return 1;
+  fseek(tdat, 0, SEEK_END);
+  size= ftell(tdat);
+  fseek(tdat, 0, SEEK_SET);
+  buf= malloc(size + 1);
+  if ((!buf) || (fread(buf, 1, size, tdat) != (size_t)size))
+  {
+    fclose(tdat);
+    free(buf);
+    return 1;
+  }
+  buf[size]= 0;
+  fclose(tdat);
+
+  p= buf;
+  for (i= 0; i < caseanz; i++)
+  {
+    if (cases[i].fcpu != fcpu) continue;
+    p= strstr(p, "__asm__");
+    if (!p) break;
+    p= asm_expand(p + 7, &cases[i].code);
+    if (!p) break;
+  }
+  free(buf);
+  return (i < caseanz) ? 1 : 0;
+}
+
+/* --------------------------------------------------
+                        walk
+
+     fuehrt das Abbild ab Word pc bis zum ersten ret
+     aus und zaehlt die Takte lt. Datenblatt
+
+     Rueckgabe:
+        Takte, -1 bei unbekanntem Befehl bzw. ohne
+        Ende, *next: Word hinter dem ret
+   -------------------------------------------------- */
+long walk(uint16_t *mem, uint32_t wordcnt, uint32_t pc, uint32_t *next)
+{
+  long     cyc;
+  uint16_t op;
+  uint8_t  a;
+
+  cyc= 0;
+  a= 0;
+  while ((pc < wordcnt) && (cyc < max_cycles))
+  {
+    op= mem[pc];
+    if (op == op_ret)
+    {
+      *next= pc + 1;
+      return cyc;
+    }
+    if (op == op_nop)
+    {
+      cyc++; pc++;
+    }
+    else if ((op & 0xff00) == op_movak)
+    {
+      a= op & 0xff;
+      cyc++; pc++;
+    }
+    else if (op == op_dzsna)
+    {
+      a--;
+      if (a) { cyc++; pc++; }
+        else { cyc += 2; pc += 2; }
+    }
+    else if ((op & 0x3800) == op_goto)
+    {
+      cyc += 2;
+      pc= op & 0x07ff;
+    }
+    else
+    {
+      printf("\n   Unexpected opcode 0x%04x at 0x%03x\n", op, pc);
+      return -1;
+    }
+  }
+  return -1;
+}
+
+/* --------------------------------------------------
+                     batch_run
+
+     assembliert und linkt die Testfaelle first ..
+     last-1 (je Fall die Befehlsfolge und ein ret)
+     und ermittelt deren Takte
+
+     Rueckgabe:
+        0 bei Erfolg
+   -------------------------------------------------- */
+int batch_run(int first, int last)
+{
+  static uint16_t words[0x800];
+  FILE        *tdat;
+  char        aname[300], cmd[3 * PATH_MAX + 1024];
+  ihex_image  img;
+  uint32_t    pc;
+  int         i;
+
+  snprintf(aname, sizeof(aname), "%s/batch.asm", tmpdir);
+  tdat= fopen(aname, "w");
+  if (!tdat) return 1;
+  fprintf(tdat, "\t.module batch\n\t.area CODE\n");
+  for (i= first; i < last; i++)
+    fprintf(tdat, "; %s, F_CPU %ld\n%sret\n", cases[i].call, cases[i].fcpu, cases[i].code);
+  fclose(tdat);
+
+  snprintf(cmd, sizeof(cmd), "cd %s && %s/bin/sdaspdk14 -o batch.asm >batch.log 2>&1 && "
+                             "%s/bin/sdldpdk -i batch.ihx batch.rel >>batch.log 2>&1",
+           tmpdir, tooldir, tooldir);
+  if (system(cmd))
+  {
+    printf("\n   Assembling / linking failed, see %s/batch.log\n", tmpdir);
+    return 1;
+  }
+
+  img.words= words;
+  img.wordcnt= sizeof(words) / 2;
+  snprintf(aname, sizeof(aname), "%s/batch.ihx", tmpdir);
+  if (ihex_load(aname, &img)) return 1;
+
+  pc= 0;
+  for (i= first; i < last; i++)
+  {
+    cases[i].cycles= walk(words, img.wordcnt, pc, &pc);
+    if (cases[i].cycles < 0) return 1;
+  }
+  return 0;
+}
+
+/* --------------------------------------------------
+                        words_est
+
+     geschaetzte Groesse der Befehlsfolge in Words
+     (incl. ret)
+   -------------------------------------------------- */
+int words_est(long cyc)
+{
+  return (cyc / 765) * 3 + 6;
+}
+
+/* ---------------------------------------------------------------------------
+     Flankenfolgen des Software-I2C im Fast-Mode (src/i2c.c)
+
+     src/i2c.c wird mit dem i2c.h eines Projekts (i2c_fastmode 1) durch
+     sdcpp expandiert. Die Anschluesse sind dabei durch Marken ersetzt:
+     SCL low (i2c_scl_lo) und SCL freigeben (i2c_scl_hi) werden zu
+     __scl_lo / __scl_hi, SDA und das Einlesen entfallen. Aus dem Rumpf
+     jeder Funktion werden die Marken, die Befehlsfolgen (__asm__) und die
+     Kontrollstrukturen (if / else, for, while, Aufrufe von Funktionen
+     aus i2c.c) entnommen und die Takte der Verzoegerungen zwischen je
+     zwei SCL-Flanken summiert.
+
+     Die vom Compiler erzeugten Befehle zwischen den Flanken verlaengern
+     die Phasen nur, die Summe der Verzoegerungen ist damit eine untere
+     Grenze fuer tLOW und tHIGH. Bei if / else zaehlt der kuerzere Zweig,
+     eine Schleife mit Flanken laeuft mindestens zweimal (die Flanke vom
+     Ende zum Anfang des Rumpfes wird mitgeprueft). Die Anstiegszeit von
+     SCL (Pullup, Buskapazitaet) ist nicht enthalten.
+   --------------------------------------------------------------------------- */
+
+#define i2c_tlowmin  1300              // Mindestzeiten Fast-Mode in ns
+#define i2c_thighmin 600
+#define i2c_maxcyc   20000             // Groesse einer Befehlsfolge fuer words_est
+#define max_edges    64                // SCL-Flanken eines Abschnitts
+#define max_i2cfunc  32
+
+// Token der Funktionsruempfe
+#define tk_lo        0                 // SCL low
+#define tk_hi        1                 // SCL freigegeben
+#define tk_asm       2                 // Befehlsfolge, val: Index in cases
+#define tk_call      3                 // Aufruf, val: Index in i2cfuncs
+#define tk_if        4
+#define tk_else      5
+#define tk_loop      6                 // for, while
+#define tk_lbrace    7
+#define tk_rbrace    8
+#define tk_lparen    9
+#define tk_rparen    10
+#define tk_semi      11
+
+struct token
+{
+  char     typ;
+  int      val;
+};
+
+// Takte vor, zwischen und nach den Flanken eines Abschnitts
+struct seg
+{
+  int      anz;                        // Anzahl Flanken
+  char     edge[max_edges];            // tk_lo / tk_hi
+  long     gap[max_edges + 1];
+};
+
+struct i2cfunc
+{
+  char     name[64];
+  long     fcpu;
+  int      first, last;                // Token first .. last-1
+  struct seg seg;
+};
+
+struct token   *toks = 0;
+int   tokanz = 0;
+int   tokmax = 0;
+
+struct i2cfunc i2cfuncs[max_i2cfunc];
+int   i2cfuncanz = 0;
+
+char  i2cdir[PATH_MAX];
+char  *i2cerr = 0;                     // Fehler beim Auswerten der Token
+
+/* --------------------------------------------------
+                       tok_add
+   -------------------------------------------------- */
+void tok_add(char typ, int val)
+{
+  if (tokanz >= tokmax)
+  {
+    tokmax= tokmax ? tokmax * 2 : 1024;
+    toks= realloc(toks, tokmax * sizeof(struct token));
+    if (!toks)
+    {
+      printf("\n   Out of memory\n\n");
+      exit(2);
+    }
+  }
+  toks[tokanz].typ= typ;
+  toks[tokanz].val= val;
+  tokanz++;
+}
+
+/* --------------------------------------------------
+                     i2cfunc_find
+   -------------------------------------------------- */
+int i2cfunc_find(char *name, long fcpu)
+{
+  int i;
+
+  for (i= 0; i < i2cfuncanz; i++)
+    if ((i2cfuncs[i].fcpu == fcpu) && (!strcmp(i2cfuncs[i].name, name))) return i;
+  return -1;
+}
+
+/* --------------------------------------------------
+                      i2c_tokens
+
+     zerlegt die Funktionen i2c_... aus der Ausgabe
+     des Praeprozessors in Token, die Befehlsfolgen
+     werden als Testfaelle angehaengt
+
+     Rueckgabe:
+        0 bei Erfolg
+   -------------------------------------------------- */
+int i2c_tokens(char *p, long fcpu)
+{
+  char   name[64], last[64], call[64], *q, *code;
+  int    depth, pdepth, len, fn, cf;
+
+  last[0]= 0;
+  depth= 0;
+  pdepth= 0;                           // Klammern ausserhalb der Funktionen
+  fn= -1;
+  while (*p)
+  {
+    if ((*p == '"') || (*p == '\''))
+    {
+      q= p++;
+      while ((*p) && (*p != *q))
+      {
+        if ((*p == '\\') && (p[1])) p++;
+        p++;
+      }
+      if (*p) p++;
+      continue;
+    }
+    if ((isalpha((unsigned char)*p)) || (*p == '_'))
+    {
+      len= 0;
+      while ((isalnum((unsigned char)*p)) || (*p == '_'))
+      {
+        if (len < (int)sizeof(name) - 1) name[len++]= *p;
+        p++;
+      }
+      name[len]= 0;
+      if (!depth)
+      {
+        if (!pdepth) strcpy(last, name);
+        continue;
+      }
+      if (fn < 0) continue;
+      if (!strcmp(name, "__asm__"))
+      {
+        p= asm_expand(p, &code);
+        if (!p) return 1;
+        snprintf(call, sizeof(call), "i2c.c %s", i2cfuncs[fn].name);
+        case_add(call, fcpu, 0, i2c_maxcyc);
+        cases[caseanz - 1].code= code;
+        tok_add(tk_asm, caseanz - 1);
+      }
+      else if (!strcmp(name, "__scl_lo")) tok_add(tk_lo, 0);
+      else if (!strcmp(name, "__scl_hi")) tok_add(tk_hi, 0);
+      else if (!strcmp(name, "if")) tok_add(tk_if, 0);
+      else if (!strcmp(name, "else")) tok_add(tk_else, 0);
+      else if ((!strcmp(name, "for")) || (!strcmp(name, "while"))) tok_add(tk_loop, 0);
+      else if ((cf= i2cfunc_find(name, fcpu)) >= 0) tok_add(tk_call, cf);
+      continue;
+    }
+    switch (*p)
+    {
+      case '{' :
+        if ((!depth) && (!strncmp(last, "i2c", 3)) && (i2cfuncanz < max_i2cfunc))
+        {
+          fn= i2cfuncanz++;
+          snprintf(i2cfuncs[fn].name, sizeof(i2cfuncs[fn].name), "%s", last);
+          i2cfuncs[fn].fcpu= fcpu;
+          i2cfuncs[fn].first= tokanz;
+        }
+        else if (depth) tok_add(tk_lbrace, 0);
+        depth++;
+        break;
+      case '}' :
+        if (depth) depth--;
+        if ((!depth) && (fn >= 0))
+        {
+          i2cfuncs[fn].last= tokanz;
+          fn= -1;
+        }
+        else if (depth) tok_add(tk_rbrace, 0);
+        break;
+      case '(' : if (depth) tok_add(tk_lparen, 0); else pdepth++; break;
+      case ')' : if (depth) tok_add(tk_rparen, 0); else if (pdepth) pdepth--; break;
+      case ';' : if (depth) tok_add(tk_semi, 0); else last[0]= 0; break;
+    }
+    p++;
+  }
+  return 0;
+}
+
+/* --------------------------------------------------
+                      i2c_expand
+
+     expandiert src/i2c.c mit dem i2c.h aus i2cdir fuer
+     ein F_CPU und zerlegt die Funktionen in Token
+
+     Rueckgabe:
+        0 bei Erfolg
+   -------------------------------------------------- */
+int i2c_expand(long fcpu)
+{
+  FILE   *tdat;
+  char   cname[300], oname[300], cmd[6 * PATH_MAX + 1024];
+  char   *buf;
+  long   size;
+  int    err;
+
+  snprintf(cname, sizeof(cname), "%s/i2cedges.c", tmpdir);
+  snprintf(oname, sizeof(oname), "%s/i2cedges.i", tmpdir);
+
+  tdat= fopen(cname, "w");
+  if (!tdat) return 1;
+  fprintf(tdat, "#define F_CPU %ld\n", fcpu);
+  fprintf(tdat, "#define i2c_bus               i2c\n"
+                "#define i2c_bus_sda           CHKSDA\n"
+                "#define i2c_bus_scl           CHKSCL\n"
+                "#define CHKSDA_input_init()   (0)\n"
+                "#define CHKSDA_output_init()  (0)\n"
+                "#define CHKSDA_clr()          (0)\n"
+                "#define is_CHKSDA()           (0)\n"
+                "#define CHKSCL_input_init()   __scl_hi\n"
+                "#define CHKSCL_output_init()  (0)\n"
+                "#define CHKSCL_clr()          __scl_lo\n"
+                "#define is_CHKSCL()           (1)\n"
+                "#include \"i2c.h\"\n"
+                "#if (i2c_fastmode != 1)\n"
+                "  #error \"i2c_fastmode 1 expected\"\n"
+                "#endif\n"
+                "#include \"i2c.c\"\n");
+  fclose(tdat);
+
+  snprintf(cmd, sizeof(cmd), "%s/bin/sdcpp -nostdinc -P -DPFS154 -D__SDCC_pdk14 -I%s "
+                             "-I%s/../include -I%s/include -I%s/../src %s -o %s",
+           tooldir, i2cdir, tooldir, tooldir, tooldir, cname, oname);
+  if (system(cmd)) return 1;
+
+  tdat= fopen(oname, "r");
+  if (!tdat) return 1;
+  fseek(tdat, 0, SEEK_END);
+  size= ftell(tdat);
+  fseek(tdat, 0, SEEK_SET);
+  buf= malloc(size + 1);
+  if ((!buf) || (fread(buf, 1, size, tdat) != (size_t)size))
+  {
+    fclose(tdat);
+    free(buf);
+    return 1;
+  }
+  buf[size]= 0;
+  fclose(tdat);
+
+  err= i2c_tokens(buf, fcpu);
+  free(buf);
+  return err;
+}
+
+/* --------------------------------------------------
+                        seg_seq
+
+     haengt Abschnitt b an a an. Beginnt b mit dem
+     Pegel, mit dem a endet, ist dies keine Flanke
+   -------------------------------------------------- */
+void seg_seq(struct seg *a, struct seg *b)
+{
+  int i;
+
+  a->gap[a->anz] += b->gap[0];
+  i= 0;
+  if ((a->anz) && (b->anz) && (a->edge[a->anz - 1] == b->edge[0]))
+  {
+    a->gap[a->anz] += b->gap[1];
+    i= 1;
+  }
+  for (; i < b->anz; i++)
+  {
+    if (a->anz >= max_edges)
+    {
+      i2cerr= "too many SCL edges";
+      return;
+    }
+    a->edge[a->anz]= b->edge[i];
+    a->anz++;
+    a->gap[a->anz]= b->gap[i + 1];
+  }
+}
+
+/* --------------------------------------------------
+                      parens_skip
+
+     ueberspringt eine geklammerte Bedingung
+   -------------------------------------------------- */
+int parens_skip(int pos, int end)
+{
+  int depth;
+
+  if ((pos >= end) || (toks[pos].typ != tk_lparen))
+  {
+    i2cerr= "'(' expected";
+    return end;
+  }
+  depth= 0;
+  do
+  {
+    if (toks[pos].typ == tk_lparen) depth++;
+    if (toks[pos].typ == tk_rparen) depth--;
+    pos++;
+  } while ((depth) && (pos < end));
+  return pos;
+}
+
+/* --------------------------------------------------
+                       stmt_eval
+
+     wertet eine Anweisung ab Token pos aus, s ist
+     der Abschnitt der Anweisung
+
+     Rueckgabe:
+        Token hinter der Anweisung
+   -------------------------------------------------- */
+int stmt_eval(int pos, int end, struct seg *s)
+{
+  struct seg t, e;
+  int        i, depth;
+
+  s->anz= 0;
+  s->gap[0]= 0;
+  if ((pos >= end) || (i2cerr)) return end;
+
+  switch (toks[pos].typ)
+  {
+    case tk_lbrace :
+      pos++;
+      while ((pos < end) && (toks[pos].typ != tk_rbrace) && (!i2cerr))
+      {
+        pos= stmt_eval(pos, end, &t);
+        seg_seq(s, &t);
+      }
+      return pos + 1;
+
+    case tk_if :
+      pos= parens_skip(pos + 1, end);
+      pos= stmt_eval(pos, end, s);
+      e.anz= 0;
+      e.gap[0]= 0;
+      if ((pos < end) && (toks[pos].typ == tk_else)) pos= stmt_eval(pos + 1, end, &e);
+      if ((s->anz) || (e.anz))
+      {
+        // nur Zweige mit gleicher Flankenfolge, es zaehlt der kuerzere
+        if (s->anz != e.anz) { i2cerr= "SCL edge in one branch of if only"; return end; }
+        for (i= 0; i < s->anz; i++)
+          if (s->edge[i] != e.edge[i]) { i2cerr= "different SCL edges in if / else"; return end; }
+      }
+      for (i= 0; i <= s->anz; i++)
+        if (e.gap[i] < s->gap[i]) s->gap[i]= e.gap[i];
+      return pos;
+
+    case tk_loop :
+      pos= parens_skip(pos + 1, end);
+      pos= stmt_eval(pos, end, &t);
+      if (t.anz)
+      {
+        // mindestens zwei Durchlaeufe
+        seg_seq(s, &t);
+        seg_seq(s, &t);
+      }
+      return pos;
+
+    case tk_semi :
+      return pos + 1;
+  }
+
+  // einfache Anweisung bis zum Semikolon
+  depth= 0;
+  while ((pos < end) && ((depth) || (toks[pos].typ != tk_semi)))
+  {
+    t.anz= 0;
+    t.gap[0]= 0;
+    switch (toks[pos].typ)
+    {
+      case tk_lo     :
+      case tk_hi     : t.anz= 1; t.edge[0]= toks[pos].typ; t.gap[1]= 0; seg_seq(s, &t); break;
+      case tk_asm    : s->gap[s->anz] += cases[toks[pos].val].cycles; break;
+      case tk_call   : seg_seq(s, &i2cfuncs[toks[pos].val].seg); break;
+      case tk_lparen : depth++; break;
+      case tk_rparen : depth--; break;
+      case tk_if     :
+      case tk_else   :
+      case tk_loop   :
+      case tk_lbrace :
+      case tk_rbrace : i2cerr= "unexpected statement"; return end;
+    }
+    pos++;
+  }
+  return pos + 1;
+}
+
+/* --------------------------------------------------
+                      i2c_check
+
+     wertet die Funktionen aus und gibt die kuerzeste
+     Low- und High-Phase von SCL je Funktion aus
+
+     Rueckgabe:
+        Anzahl der Fehler
+   -------------------------------------------------- */
+int i2c_check(long fcpu, int verbose)
+{
+  struct seg t;
+  long   cyc[2], need[2];
+  int    i, j, pos, errs, nack, rd;
+  static const char *phase[2] = { "tLOW", "tHIGH" };
+
+  need[0]= (i2c_tlowmin * fcpu + 999999999) / 1000000000;
+  need[1]= (i2c_thighmin * fcpu + 999999999) / 1000000000;
+
+  errs= 0;
+  nack= 0;
+  rd= 0;
+  for (i= 0; i < i2cfuncanz; i++)
+  {
+    if (i2cfuncs[i].fcpu != fcpu) continue;
+    i2cerr= 0;
+    pos= i2cfuncs[i].first;
+    i2cfuncs[i].seg.anz= 0;
+    i2cfuncs[i].seg.gap[0]= 0;
+    while ((pos < i2cfuncs[i].last) && (!i2cerr))
+    {
+      pos= stmt_eval(pos, i2cfuncs[i].last, &t);
+      seg_seq(&i2cfuncs[i].seg, &t);
+    }
+    if (i2cerr)
+    {
+      printf("FAIL  %-26s F_CPU %8ld : %s\n", i2cfuncs[i].name, fcpu, i2cerr);
+      errs++;
+      continue;
+    }
+
+    // Phasen zwischen zwei Flanken, davor und danach bestimmt der Aufrufer
+    cyc[0]= -1;
+    cyc[1]= -1;
+    for (j= 1; j < i2cfuncs[i].seg.anz; j++)
+    {
+      pos= (i2cfuncs[i].seg.edge[j - 1] == tk_lo) ? 0 : 1;
+      if ((cyc[pos] < 0) || (i2cfuncs[i].seg.gap[j] < cyc[pos])) cyc[pos]= i2cfuncs[i].seg.gap[j];
+    }
+    if ((cyc[0] < 0) && (cyc[1] < 0)) continue;
+    if (!strcmp(i2cfuncs[i].name, "i2c_write_nack")) nack= 1;
+    if (!strcmp(i2cfuncs[i].name, "i2c_read")) rd= 1;
+
+    for (pos= 0; pos < 2; pos++)
+    {
+      if (cyc[pos] < 0) continue;
+      if (cyc[pos] < need[pos])
+      {
+        printf("FAIL  %-26s F_CPU %8ld : %-5s %ld cycles (%ld ns), expected %ld (%d ns)\n",
+               i2cfuncs[i].name, fcpu, phase[pos], cyc[pos], cyc[pos] * 1000000000 / fcpu,
+               need[pos], pos ? i2c_thighmin : i2c_tlowmin);
+        errs++;
+      }
+      else if (verbose)
+        printf("ok    %-26s F_CPU %8ld : %-5s %ld cycles (%ld ns)\n",
+               i2cfuncs[i].name, fcpu, phase[pos], cyc[pos], cyc[pos] * 1000000000 / fcpu);
+    }
+  }
+  if ((!nack) || (!rd))
+  {
+    printf("FAIL  i2c_write_nack / i2c_read F_CPU %8ld : no SCL clock found\n", fcpu);
+    errs++;
+  }
+  return errs;
+}
+
+/* ---------------------------------------------------------------------------
+                                    M A I N
+   --------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+  long  fcpu[max_fcpu], f, n, maxcyc, lo, hi;
+  int   fanz, i, first, words, verbose, errs, err, i2cfirst;
+  char  call[64], cmd[400], *p, *tools, *i2c;
+  char  dname[PATH_MAX + 32];
+
+  static const long samples[] = { 3059, 4999, 9999, 32767, 65000 };
+
+  tools= "..";
+  i2c= 0;
+  maxcyc= 2400;
+  fanz= 0;
+  verbose= 0;
+  for (i= 1; i < argc; i++)
+  {
+    p= argv[i];
+    if (!strncmp(p, "max=", 4)) maxcyc= atol(p + 4);
+    else if ((!strncmp(p, "fcpu=", 5)) && (fanz < max_fcpu)) fcpu[fanz++]= atol(p + 5);
+    else if (!strncmp(p, "tools=", 6)) tools= p + 6;
+    else if (!strncmp(p, "i2c=", 4)) i2c= p + 4;
+    else if (!strcmp(p, "verbose")) verbose= 1;
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+  // absolut, die Toolchain wird im temporaeren Verzeichnis aufgerufen
+  if (!realpath(tools, tooldir))
+  {
+    printf("\n   No such directory: %s\n\n", tools);
+    return 2;
+  }
+  // i2c.h des Fast-Mode, Default aus bench_i2cfast, "i2c=" ohne Angabe: keine Pruefung
+  if (!i2c)
+  {
+    snprintf(dname, sizeof(dname), "%s/../bench_i2cfast", tooldir);
+    i2c= dname;
+  }
+  if ((*i2c) && (!realpath(i2c, i2cdir)))
+  {
+    printf("\n   No such directory: %s\n\n", i2c);
+    return 2;
+  }
+  if (!fanz)
+  {
+    fcpu[fanz++]= 8000000;
+    fcpu[fanz++]= 16000000;
+  }
+
+  // _delay_cycles ist unabhaengig von F_CPU, expandiert mit dem ersten
+  for (n= 0; n <= maxcyc; n++)
+  {
+    snprintf(call, sizeof(call), "_delay_cycles(%ld)", n);
+    case_add(call, fcpu[0], n, n);
+  }
+  for (i= 0; i < (int)(sizeof(samples) / sizeof(samples[0])); i++)
+  {
+    if (samples[i] <= maxcyc) continue;
+    snprintf(call, sizeof(call), "_delay_cycles(%ld)", samples[i]);
+    case_add(call, fcpu[0], samples[i], samples[i]);
+  }
+  for (i= 0; i < fanz; i++)
+  {
+    f= fcpu[i];
+    for (n= 0; n <= 500; n++)
+    {
+      lo= (f * n + 999999) / 1000000;
+      snprintf(call, sizeof(call), "_delay_us_exact(%ld)", n);
+      case_add(call, f, lo, lo);
+    }
+    for (n= 0; n <= 20000; n += (n < 2000) ? 1 : 7)
+    {
+      lo= (f * n + 999999999) / 1000000000;
+      hi= lo + 1;
+      snprintf(call, sizeof(call), "_delay_ns_exact(%ld)", n);
+      case_add(call, f, lo, hi);
+    }
+  }
+
+  if (!mkdtemp(tmpdir))
+  {
+    printf("\n   Cannot create %s\n\n", tmpdir);
+    return 2;
+  }
+
+  err= 0;
+  for (i= 0; (i < fanz) && (!err); i++)
+  {
+    if (cases_expand(fcpu[i]))
+    {
+      printf("\n   Cannot expand delay.h for F_CPU %ld (%s/bin/sdcpp)\n", fcpu[i], tooldir);
+      err= 1;
+    }
+  }
+
+  // Befehlsfolgen zwischen den SCL-Flanken von i2c.c, als weitere Testfaelle
+  i2cfirst= caseanz;
+  for (i= 0; (i < fanz) && (!err) && (i2cdir[0]); i++)
+  {
+    if (i2c_expand(fcpu[i]))
+    {
+      printf("\n   Cannot expand src/i2c.c with %s/i2c.h for F_CPU %ld (needs i2c_fastmode 1)\n",
+             i2cdir, fcpu[i]);
+      err= 1;
+    }
+  }
+
+  // in Durchgaengen assemblieren, die in den Adressraum von goto passen
+  first= 0;
+  words= 0;
+  for (i= 0; (i <= caseanz) && (!err); i++)
+  {
+    if ((i == caseanz) || ((words) && (words + words_est(cases[i].max) > max_words)))
+    {
+      err= batch_run(first, i);
+      first= i;
+      words= 0;
+    }
+    if (i < caseanz) words += words_est(cases[i].max);
+  }
+
+  if (!err)
+  {
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", tmpdir);
+    if (system(cmd)) printf("\n   Cannot remove %s\n", tmpdir);
+  }
+  else
+  {
+    printf("\n   Check aborted, files kept in %s\n\n", tmpdir);
+    return 2;
+  }
+
+  errs= 0;
+  for (i= 0; i < i2cfirst; i++)
+  {
+    if ((cases[i].cycles < cases[i].min) || (cases[i].cycles > cases[i].max))
+    {
+      if (errs < 20)
+      {
+        printf("FAIL  %-26s F_CPU %8ld : %ld cycles, expected %ld",
+               cases[i].call, cases[i].fcpu, cases[i].cycles, cases[i].min);
+        if (cases[i].max > cases[i].min) printf("..%ld", cases[i].max);
+        printf("\n");
+      }
+      errs++;
+    }
+    else if (verbose)
+      printf("ok    %-26s F_CPU %8ld : %ld cycles\n", cases[i].call, cases[i].fcpu, cases[i].cycles);
+  }
+
+  printf("\n%d cases (_delay_cycles 0..%ld and samples, _delay_us_exact, _delay_ns_exact at",
+         i2cfirst, maxcyc);
+  for (i= 0; i < fanz; i++) printf(" %ld", fcpu[i]);
+  printf(" Hz): %d failed\n", errs);
+
+  if (i2cdir[0])
+  {
+    n= 0;
+    for (i= 0; i < fanz; i++) n += i2c_check(fcpu[i], verbose);
+    printf("\nSCL low / high phases of src/i2c.c (%s/i2c.h), delays only, fast mode\n"
+           "minimum tLOW %d ns, tHIGH %d ns: %ld failed\n", i2cdir, i2c_tlowmin, i2c_thighmin, n);
+    errs += n;
+  }
+  printf("\n");
+
+  return errs ? 3 : 0;
+}
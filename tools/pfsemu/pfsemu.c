@@ -0,0 +1,1017 @@
+/* ------------------------------------------------------------
+                            pfsemu.c
+
+      Simulation des arduinobasierenden PFS Programmers
+      (Firmware pfs154_prog2_1.c) mit angeschlossenem
+      PFS154 auf dem Host.
+
+      Die Simulation stellt ein Pseudo-Terminal (pty) zur
+      Verfuegung, an dem pfsprog / pfsflash wie an einem
+      echten Programmer betrieben werden koennen. Sie
+      versteht den gleichen Befehlssatz wie die Firmware
+      (P, F, V, D, R, r, i, b, g, t, s, c), meldet sich
+      nach dem Start mit der Bereitmeldung und haelt
+      nach jedem Kommando die gleichen Pausen ein.
+
+      Nachgebildet werden:
+
+        - der Flashspeicher je Target mit dem Verhalten
+          von pfs_writewords (Bits koennen nur von 1 nach
+          0 geschrieben werden, unbeschrieben = 0x3fff)
+        - das Loeschen des Targets
+        - die Device-ID (auch fehlende Targets)
+        - Gang-Programmierung mit bis zu 7 Targets
+        - optional: Zeitbedarf von Uebertragung, Loeschen
+          und Schreiben, fehlerhafte Rahmen, defekte
+          Flashzellen, maximaler ICSP-Takt
+
+      Damit lassen sich Hostprogramme, Protokollaender-
+      ungen und die Fehlerbehandlung ohne Hardware testen.
+
+      Compiler: GCC
+
+      R. Seelig
+   ------------------------------------------------------------ */
+
+#define _GNU_SOURCE                    // posix_openpt, cfmakeraw
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+
+#define baudrate        115200         // Standardbaudrate der Firmware
+
+#define device_id       0xaa1
+#define device_memend   0x7ff          // letzte Word-Adresse PFS154
+#define device_words    (device_memend + 1)
+#define blksize         500            // Blockgroesse Kommando 'P'
+
+// Rahmenprotokoll, wie in der Firmware
+#define frame_soh       0x01
+#define frame_ack       0x06
+#define frame_nak       0x15
+#define frame_can       0x18
+#define frame_verr      0x19
+#define frame_maxpairs  64
+#define frame_tout      50             // Timeout zwischen 2 Zeichen eines Rahmens in ms
+#define frame_idletout  3000           // Timeout auf den Beginn eines Rahmens in ms
+#define frame_maxretry  10
+
+#define gang_max        7
+#define tck_default     16             // halber SCK-Takt (Durchlaeufe _delay_loop_1)
+#define wrpulse_default 22             // Programmierimpuls in us
+#define tck_testlen     64
+
+#define baud_testlen    32
+#define baud_tout       300
+#define baud_idletout   2000
+
+#define ready_banner    "PFSPROG READY"
+
+const uint32_t baudrates[4] = { baudrate, 250000, 500000, 1000000 };
+const uint8_t  tck_steps[]  = { 16, 12, 9, 7, 5, 4, 3, 2, 1, 0 };
+
+int      pty_fd = -1;
+
+// Targets
+uint16_t flash[gang_max][device_words];  // Flashspeicher je Target (14 Bit)
+uint8_t  present = 0x01;                // angeschlossene Targets (Bit n = Target n)
+uint16_t id_present = device_id;        // Device-ID eines angeschlossenen Targets
+int      defect_adr = -1;               // defekte Flashzelle (Bit 0 bleibt 0)
+uint8_t  defect_target = 0;
+
+// Zustand der Firmware
+uint8_t  gang_cfg = 0x01;
+uint8_t  gang_act = 0x01;
+uint16_t gang_erradr[gang_max];
+uint16_t gang_errword[gang_max];
+uint8_t  tck_half = tck_default;
+uint8_t  wr_pulse = wrpulse_default;
+uint8_t  stat_on = 0;
+uint32_t curbaud = baudrate;
+
+// Simulationsoptionen
+char     realtime = 1;                  // Zeitbedarf von Hardware und Leitung nachbilden
+char     verbose = 0;
+int      errframe = 0;                  // jeden n-ten Rahmen als fehlerhaft empfangen
+int      framecnt = 0;
+uint8_t  mintck = 2;                    // kleinster fehlerfreier ICSP-Takt fuer 'c'
+
+// Zeitmessung fuer 's'
+long     stat_tstart, stat_tid, stat_tlen, stat_terase, stat_txfer;
+double   stat_wrsum;                    // ms
+
+/* --------------------------------------------------
+                        now_ms
+   -------------------------------------------------- */
+long now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * 1000L) + (ts.tv_nsec / 1000000L);
+}
+
+/* --------------------------------------------------
+                        sim_delay
+
+     Wartezeit in ms. Pausen der Hardware (Span-
+     nungen, Loeschen, Schreiben) werden nur im
+     Echtzeitbetrieb eingehalten, Pausen des Proto-
+     kolls (hw = 0) immer
+   -------------------------------------------------- */
+void sim_delay(double ms, char hw)
+{
+  struct timespec ts;
+
+  if (hw && !realtime) return;
+  if (ms <= 0) return;
+  ts.tv_sec= (long)ms / 1000;
+  ts.tv_nsec= (long)((ms - (ts.tv_sec * 1000.0)) * 1000000.0);
+  nanosleep(&ts, 0);
+}
+
+/* --------------------------------------------------
+                        wire_delay
+
+     Zeit fuer die Uebertragung von n Zeichen mit
+     der aktuellen Baudrate (10 Bit je Zeichen)
+   -------------------------------------------------- */
+void wire_delay(int n)
+{
+  sim_delay((n * 10000.0) / curbaud, 1);
+}
+
+/* --------------------------------------------------
+                 UART ueber das Pseudo-Terminal
+   -------------------------------------------------- */
+int uart_ischar(void)
+{
+  struct pollfd pfd;
+
+  pfd.fd= pty_fd;
+  pfd.events= POLLIN;
+  return (poll(&pfd, 1, 0) > 0);
+}
+
+int uart_getchar_tout(int tout)
+{
+  struct pollfd pfd;
+  uint8_t ch;
+
+  pfd.fd= pty_fd;
+  pfd.events= POLLIN;
+  if (poll(&pfd, 1, tout) <= 0) return -1;
+  if (read(pty_fd, &ch, 1) != 1)
+  {
+    sim_delay(tout, 0);                  // kein Client verbunden
+    return -1;
+  }
+  return ch;
+}
+
+uint8_t uart_getchar(void)
+{
+  int ch;
+
+  while ((ch= uart_getchar_tout(1000)) < 0);
+  return ch;
+}
+
+void uart_write(const void *buf, int n)
+{
+  const uint8_t *p = buf;
+  int r;
+
+  wire_delay(n);
+  while (n > 0)
+  {
+    r= write(pty_fd, p, n);
+    if (r <= 0) return;
+    p += r;
+    n -= r;
+  }
+}
+
+void uart_putchar(uint8_t ch)
+{
+  uart_write(&ch, 1);
+}
+
+void uart_printf(const char *fmt, ...)
+{
+  char    s[128];
+  va_list ap;
+
+  va_start(ap, fmt);
+  vsnprintf(s, sizeof(s), fmt, ap);
+  va_end(ap);
+  uart_write(s, strlen(s));
+}
+
+/* --------------------------------------------------
+                          hx
+
+     Hexdarstellung wie %x von my_printf: Werte
+     > 0xff 4-stellig, sonst 2-stellig, Gross-
+     buchstaben. Verwendet reihum 4 Puffer, damit
+     mehrere Werte in einem Aufruf moeglich sind
+   -------------------------------------------------- */
+const char *hx(uint16_t h)
+{
+  static char buf[4][8];
+  static uint8_t idx = 0;
+
+  idx= (idx + 1) & 3;
+  sprintf(buf[idx], (h > 0xff) ? "%04X" : "%02X", h);
+  return buf[idx];
+}
+
+int hexval(uint8_t ch)
+{
+  if (ch > 'F') return (ch - 'a') + 10;
+  if (ch > '9') return (ch - 'A') + 10;
+  return ch - '0';
+}
+
+uint8_t uart_gethex(void)
+{
+  uint8_t h;
+
+  h= hexval(uart_getchar()) << 4;
+  return h | hexval(uart_getchar());
+}
+
+uint16_t uart_gethexword(void)
+{
+  uint16_t w;
+
+  w= uart_gethex() << 8;
+  return w | uart_gethex();
+}
+
+uint16_t crc16_update(uint16_t crc, uint8_t data)
+{
+  uint8_t i;
+
+  crc ^= ((uint16_t)data << 8);
+  for (i= 0; i < 8; i++)
+  {
+    if (crc & 0x8000) crc= (crc << 1) ^ 0x1021; else crc <<= 1;
+  }
+  return crc;
+}
+
+void logmsg(const char *fmt, ...)
+{
+  va_list ap;
+
+  if (!verbose) return;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+}
+
+/* --------------------------------------------------
+                     Target-Modell
+   -------------------------------------------------- */
+
+/* --------------------------------------------------
+                     target_id
+
+     Device-ID, die Target t beim Lesen liefert,
+     ein fehlendes Target liefert 0
+   -------------------------------------------------- */
+uint16_t target_id(uint8_t t)
+{
+  return (present & (1 << t)) ? id_present : 0;
+}
+
+/* --------------------------------------------------
+                    target_erase
+
+     loescht alle aktiven Targets (Zeitbedarf wie
+     pfs_init, delay und pfs_erasedevice in pgm_start)
+   -------------------------------------------------- */
+void target_erase(void)
+{
+  uint8_t t;
+  int     i;
+
+  sim_delay(135, 1);
+  for (t= 0; t < gang_max; t++)
+  {
+    if (!(gang_act & present & (1 << t))) continue;
+    for (i= 0; i < device_words; i++) flash[t][i]= 0x3fff;
+  }
+}
+
+/* --------------------------------------------------
+                   target_writewords
+
+     wie pfs_writewords: schreibt 2 Words ab der
+     (geraden) Word-Adresse adr in alle aktiven
+     Targets. Flashzellen koennen nur von 1 nach 0
+     programmiert werden.
+
+     Zeitbedarf: 70 Bits mit je 2 halben SCK-Takten
+     (tck_half * 3 Takte bei 16 MHz) und 8 Program-
+     mierimpulse mit Pause (je 2 * wr_pulse)
+   -------------------------------------------------- */
+void target_writewords(uint16_t w1, uint16_t w2, uint16_t adr)
+{
+  uint8_t t;
+  double  ms;
+
+  ms= ((70 * 2 * (tck_half + 1) * 3.0 / 16.0) + (16.0 * wr_pulse)) / 1000.0;
+  sim_delay(ms, 1);
+  stat_wrsum += ms;
+
+  adr &= 0xfffe;
+  if (adr > device_memend) return;
+  for (t= 0; t < gang_max; t++)
+  {
+    if (!(gang_act & present & (1 << t))) continue;
+    flash[t][adr] &= w1 & 0x3fff;
+    flash[t][adr+1] &= w2 & 0x3fff;
+    if ((t == defect_target) && ((defect_adr & 0xfffe) == adr))
+      flash[t][defect_adr] &= 0x3ffe;
+  }
+}
+
+/* --------------------------------------------------
+                     gang_idcheck
+
+     wie in der Firmware: Targets mit falscher ID
+     werden deaktiviert
+
+     Rueckgabe:
+        ID des ersten aktiven bzw. konfigurierten
+        Targets
+   -------------------------------------------------- */
+uint16_t gang_idcheck(void)
+{
+  uint8_t t, act, first;
+
+  act= 0;
+  for (t= 0; t < gang_max; t++)
+  {
+    gang_erradr[t]= 0xffff;
+    gang_errword[t]= 0;
+    if ((gang_cfg & (1 << t)) && (target_id(t) == device_id)) act |= (1 << t);
+  }
+  gang_act= act ? act : gang_cfg;
+
+  for (first= 0; first < gang_max; first++)
+    if (gang_act & (1 << first)) break;
+  return target_id(first);
+}
+
+void gang_report(void)
+{
+  uint8_t t;
+
+  for (t= 0; t < gang_max; t++)
+  {
+    if (gang_cfg & (1 << t))
+      uart_printf("%s %s %s\r\n", hx(target_id(t)), hx(gang_erradr[t]), hx(gang_errword[t]));
+  }
+}
+
+/* --------------------------------------------------
+                     verifywords
+
+     wie pfs_verifywords: vergleicht cnt Wordpaare
+     aus buf mit allen aktiven Targets, abweichende
+     Targets werden deaktiviert
+
+     Rueckgabe:
+        0xffff wenn noch ein Target aktiv ist, sonst
+        die Adresse der letzten Abweichung, der
+        gelesene Wert steht in *vfy_word
+   -------------------------------------------------- */
+uint16_t verifywords(uint8_t *buf, uint16_t adr, uint8_t cnt, uint16_t *vfy_word)
+{
+  uint8_t  i, t;
+  uint16_t w, soll;
+
+  sim_delay(10 + (cnt * 2 * 0.05), 1);         // Umschalten Read-Mode, Lesen
+  for (i= 0; i < (cnt*2); i++)
+  {
+    soll= ((buf[0] << 8) | buf[1]) & 0x3fff;
+    for (t= 0; t < gang_max; t++)
+    {
+      if (!(gang_act & (1 << t))) continue;
+      w= flash[t][adr & device_memend];
+      if (w != soll)
+      {
+        gang_erradr[t]= adr;
+        gang_errword[t]= w;
+        gang_act &= ~(1 << t);
+        *vfy_word= w;
+      }
+    }
+    if (!gang_act) return adr;
+    buf += 2;
+    adr++;
+  }
+  return 0xffff;
+}
+
+/* --------------------------------------------------
+                   Kommandos der Firmware
+   -------------------------------------------------- */
+
+/* --------------------------------------------------
+                      pgm_start
+
+     wie in der Firmware: Device-ID senden, Pro-
+     grammlaenge empfangen, Targets loeschen
+
+     Rueckgabe:
+        Programmlaenge
+   -------------------------------------------------- */
+uint16_t pgm_start(void)
+{
+  uint16_t id, proglen;
+
+  stat_tstart= now_ms();
+  stat_wrsum= 0;
+  sim_delay(40, 1);
+
+  gang_act= gang_cfg;
+  id= gang_idcheck();
+  uart_printf("0x%s\r\n", hx(id));
+  if (gang_cfg != 0x01) gang_report();
+  stat_tid= now_ms();
+  proglen= uart_gethexword();
+  stat_tlen= now_ms();
+
+  target_erase();
+  stat_terase= now_ms();
+  uart_printf("%s\r", hx(proglen));
+  logmsg(" ID 0x%x, program length %d bytes\n", id, proglen);
+  return proglen;
+}
+
+void stat_report(void)
+{
+  long t;
+
+  t= now_ms();
+  uart_printf("S %ld %ld %ld %d %ld\r\n", stat_tid - stat_tstart, stat_terase - stat_tlen,
+              stat_txfer - stat_terase, (int)stat_wrsum, t - stat_txfer);
+}
+
+/* --------------------------------------------------
+                      frame_recv
+
+     empfaengt einen Rahmen nach hdr / buf
+
+     Rueckgabe:
+        0 : fehlerfrei, 1 : fehlerhaft (nach Ruhe auf
+        der Leitung), 2 : Abbruch (CAN), 3 : kein
+        Rahmen innerhalb frame_idletout
+   -------------------------------------------------- */
+int frame_recv(uint8_t *hdr, uint8_t *buf)
+{
+  int      ch, i, n;
+  uint16_t crc;
+
+  do
+  {
+    ch= uart_getchar_tout(frame_idletout);
+    if (ch < 0) return 3;
+    if (ch == frame_can) return 2;
+  } while (ch != frame_soh);
+
+  crc= 0xffff;
+  for (i= 0; i < 4; i++)
+  {
+    if ((ch= uart_getchar_tout(frame_tout)) < 0) goto flush;
+    hdr[i]= ch;
+    crc= crc16_update(crc, ch);
+  }
+  if (hdr[3] > frame_maxpairs) goto flush;
+  n= (hdr[3] * 4) + 2;
+  for (i= 0; i < n; i++)
+  {
+    if ((ch= uart_getchar_tout(frame_tout)) < 0) goto flush;
+    if (i < (n-2)) buf[i]= ch;
+    crc= crc16_update(crc, ch);
+  }
+  wire_delay(n + 5);
+
+  framecnt++;
+  if ((errframe) && (!(framecnt % errframe)))
+  {
+    logmsg(" frame %d: simulated transmission error\n", hdr[0]);
+    crc= 1;
+  }
+  if (!crc) return 0;
+
+flush:
+  // Zeichen verwerfen bis frame_tout ms Ruhe
+  while (uart_getchar_tout(frame_tout) >= 0);
+  return 1;
+}
+
+/* --------------------------------------------------
+                    frameprogram
+
+     wie pfs_frameprogram: Rahmen empfangen, quit-
+     tieren, flashen und optional (verify) beim
+     Empfang des naechsten Rahmens pruefen
+   -------------------------------------------------- */
+void frameprogram(uint8_t verify)
+{
+  uint8_t  hdr[4];
+  uint8_t  buf[2][frame_maxpairs*4];
+  uint8_t  seq, expseq, cnt, errcnt, b;
+  uint16_t adr, vfyadr, vfy_word, i;
+  uint8_t  vfycnt, vfybuf;
+  int      r;
+
+  expseq= 0;
+  errcnt= 0;
+  vfycnt= 0;
+  vfybuf= 0;
+  vfyadr= 0;
+  b= 0;
+
+  while (errcnt < frame_maxretry)
+  {
+    r= frame_recv(hdr, buf[b]);
+    if (r == 2) { logmsg(" upload cancelled\n"); return; }
+    if (r)
+    {
+      uart_putchar(frame_nak);
+      uart_putchar(expseq);
+      errcnt++;
+      continue;
+    }
+
+    // vorherigen Rahmen pruefen, sobald der naechste da ist
+    if (vfycnt)
+    {
+      adr= verifywords(buf[vfybuf], vfyadr, vfycnt, &vfy_word);
+      if (adr != 0xffff)
+      {
+        logmsg(" verify error at 0x%04x\n", adr);
+        uart_putchar(frame_verr);
+        uart_putchar(adr >> 8);
+        uart_putchar(adr & 0xff);
+        uart_putchar(vfy_word >> 8);
+        uart_putchar(vfy_word & 0xff);
+        return;
+      }
+      vfycnt= 0;
+    }
+
+    seq= hdr[0];
+    adr= (hdr[1] << 8) | hdr[2];
+    cnt= hdr[3];
+
+    if (seq == (uint8_t)(expseq-1))
+    {
+      uart_putchar(frame_ack);
+      uart_putchar(seq);
+      continue;
+    }
+    if ((seq != expseq) || (adr & 0x0001) || ((adr + (cnt*2)) > device_words))
+    {
+      uart_putchar(frame_nak);
+      uart_putchar(expseq);
+      errcnt++;
+      continue;
+    }
+    errcnt= 0;
+
+    uart_putchar(frame_ack);
+    uart_putchar(seq);
+    if (!cnt) return;
+    expseq++;
+
+    // flashen, waehrenddessen sendet der Host bereits den naechsten Rahmen
+    for (i= 0; i < cnt; i++)
+    {
+      uint8_t *p = &buf[b][i*4];
+      uint16_t w1 = (p[0] << 8) | p[1];
+      uint16_t w2 = (p[2] << 8) | p[3];
+
+      if ((w1 != 0xffff) || (w2 != 0xffff)) target_writewords(w1, w2, adr + (i*2));
+    }
+    if (verify)
+    {
+      vfybuf= b;
+      vfyadr= adr;
+      vfycnt= cnt;
+    }
+    b ^= 1;
+  }
+}
+
+/* --------------------------------------------------
+                     blockprogram
+
+     Kommando 'P': Bloecke a 500 Bytes ohne Pruef-
+     summe, jeder Block wird mit 'x' bestaetigt
+   -------------------------------------------------- */
+void blockprogram(uint16_t proglen)
+{
+  uint8_t  blk[blksize];
+  uint16_t pc, mcx, blkanz, i;
+
+  blkanz= proglen / blksize;
+  if (proglen % blksize) blkanz++;
+
+  pc= 0;
+  for (i= 0; i < blkanz; i++)
+  {
+    for (mcx= 0; mcx < blksize; mcx++) blk[mcx]= uart_getchar();
+    wire_delay(blksize);
+    for (mcx= 0; mcx < blksize; mcx += 4)
+    {
+      if (pc < proglen)
+        target_writewords((blk[mcx] << 8) | blk[mcx+1], (blk[mcx+2] << 8) | blk[mcx+3], pc);
+      pc += 2;
+    }
+    uart_putchar('x');
+  }
+}
+
+/* --------------------------------------------------
+                      readframes
+
+     Kommando 'D': count Words ab adr des ersten
+     aktiven Targets in Rahmen senden
+   -------------------------------------------------- */
+void readframes(uint16_t adr, uint16_t count)
+{
+  uint8_t  frame[(frame_maxpairs*4) + 7];
+  uint8_t  seq, cnt, t;
+  uint16_t crc, w;
+  int      i, n;
+
+  for (t= 0; t < (gang_max-1); t++)
+    if (gang_cfg & (1 << t)) break;
+
+  adr &= 0xfffe;
+  count= (count + 1) / 2;
+  seq= 0;
+  do
+  {
+    cnt= frame_maxpairs;
+    if (count < cnt) cnt= count;
+    if (adr > device_memend) cnt= 0;
+    else if ((adr + (cnt*2)) > device_words) cnt= (device_words - adr) / 2;
+
+    frame[0]= frame_soh;
+    frame[1]= seq;
+    frame[2]= adr >> 8;
+    frame[3]= adr & 0xff;
+    frame[4]= cnt;
+    n= 5;
+    for (i= 0; i < (cnt*2); i++)
+    {
+      w= (present & (1 << t)) ? flash[t][adr++] : 0;
+      frame[n++]= w >> 8;
+      frame[n++]= w & 0xff;
+    }
+    crc= 0xffff;
+    for (i= 1; i < n; i++) crc= crc16_update(crc, frame[i]);
+    frame[n++]= crc >> 8;
+    frame[n++]= crc & 0xff;
+    uart_write(frame, n);
+
+    count -= cnt;
+    seq++;
+  } while (cnt);
+}
+
+/* --------------------------------------------------
+                     characterize
+
+     Kommando 'c': Testmuster mit absteigendem ICSP-
+     Takt, Takte unterhalb mintck liefern Fehler
+   -------------------------------------------------- */
+void characterize(void)
+{
+  uint8_t i, best;
+  uint16_t errs;
+
+  sim_delay(40, 1);
+  uart_printf("0x%s\r\n", hx(target_id(0)));
+
+  best= 0xff;
+  for (i= 0; i < sizeof(tck_steps); i++)
+  {
+    sim_delay(135 + (tck_testlen * 0.4), 1);
+    errs= (target_id(0) != device_id) ? tck_testlen : ((tck_steps[i] < mintck) ? 5 : 0);
+    uart_printf("%s %s\r\n", hx(tck_steps[i]), hx(errs));
+    if (errs) break;
+    best= i;
+  }
+
+  if (best != 0xff)
+  {
+    if (best) best--;
+    best= tck_steps[best];
+    tck_half= best;
+  }
+  else
+  {
+    tck_half= tck_default;
+  }
+  gang_act= gang_cfg;
+  target_erase();
+  uart_printf("=%s\r\n", hx(best));
+}
+
+/* --------------------------------------------------
+                     baud_change
+
+     Kommando 'b': auf dem pty aendert sich nur die
+     simulierte Uebertragungszeit, das Testmuster
+     wird wie in der Firmware geprueft
+   -------------------------------------------------- */
+uint8_t baud_change(int code)
+{
+  int      ch;
+  uint8_t  i;
+  uint16_t crc;
+
+  if ((code < '0') || (code > '3')) return 0;
+
+  uart_putchar('b');
+  uart_putchar(code);
+  curbaud= baudrates[code - '0'];
+
+  do
+  {
+    ch= uart_getchar_tout(baud_tout);
+  } while ((ch >= 0) && (ch != 'U'));
+
+  if (ch >= 0)
+  {
+    crc= 0xffff;
+    for (i= 0; i < baud_testlen + 2; i++)
+    {
+      ch= uart_getchar_tout(frame_tout);
+      if (ch < 0) break;
+      crc= crc16_update(crc, ch);
+    }
+    if ((ch >= 0) && (!crc))
+    {
+      uart_putchar('K');
+      logmsg(" baudrate %u\n", curbaud);
+      return 1;
+    }
+  }
+  curbaud= baudrate;
+  return 0;
+}
+
+/* --------------------------------------------------
+                        pty_open
+
+     oeffnet ein Pseudo-Terminal im Raw-Modus und
+     legt optional einen symbolischen Link darauf an
+
+     Rueckgabe:
+        Name des Slave-Terminals, 0 bei Fehler
+   -------------------------------------------------- */
+char *pty_open(char *link)
+{
+  struct termios tio;
+  char   *name;
+  int    sfd;
+
+  pty_fd= posix_openpt(O_RDWR | O_NOCTTY);
+  if ((pty_fd < 0) || grantpt(pty_fd) || unlockpt(pty_fd)) return 0;
+  name= ptsname(pty_fd);
+  if (!name) return 0;
+
+  // Slave offen halten: nach dem Schliessen durch den Client liefert
+  // der Master sonst nur noch Fehler
+  sfd= open(name, O_RDWR | O_NOCTTY);
+  if (sfd < 0) return 0;
+  tcgetattr(sfd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(sfd, TCSANOW, &tio);
+
+  if (link)
+  {
+    unlink(link);
+    if (symlink(name, link)) return 0;
+  }
+  return name;
+}
+
+/* --------------------------------------------------
+                          usage
+   -------------------------------------------------- */
+void usage(void)
+{
+  printf("\nSyntax:\n");
+  printf("pfsemu [link=path] [gang=mask] [id=hex] [errframe=n] [defect=adr[:t]]\n");
+  printf("       [mintck=n] [fast] [verbose]\n\n");
+  printf("  link=path : create a symbolic link to the pty, e.g. /tmp/ttyPFS\n");
+  printf("  gang=mask : targets connected (hex, bit n = target n), default 01\n");
+  printf("  id=hex    : device ID of the connected targets, default aa1\n");
+  printf("  errframe=n: every n-th frame is received with a CRC error\n");
+  printf("  defect=adr: flash word adr (hex) of target t has bit 0 stuck at 0\n");
+  printf("  mintck=n  : fastest reliable ICSP clock for action char, default 2\n");
+  printf("  fast      : do not simulate wire, erase and write times\n");
+  printf("  verbose   : log commands to stderr\n\n");
+  printf("  Example   : pfsemu link=/tmp/ttyPFS &\n");
+  printf("              pfsflash txwr /tmp/ttyPFS helloworld.ihx\n\n");
+}
+
+/* ---------------------------------------------------------------------------
+                                    M A I N
+   --------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+  char     *link, *name, *p;
+  int      i, rx;
+  uint8_t  ch, setupcmd, highbaud, b;
+  uint16_t proglen, pc;
+
+  link= 0;
+  for (i= 1; i < argc; i++)
+  {
+    p= argv[i];
+    if (!strncmp(p, "link=", 5)) link= p + 5;
+    else if (!strncmp(p, "gang=", 5)) present= strtol(p + 5, 0, 16) & ((1 << gang_max)-1);
+    else if (!strncmp(p, "id=", 3)) id_present= strtol(p + 3, 0, 16);
+    else if (!strncmp(p, "errframe=", 9)) errframe= atoi(p + 9);
+    else if (!strncmp(p, "defect=", 7))
+    {
+      defect_adr= strtol(p + 7, &p, 16) & device_memend;
+      if (*p == ':') defect_target= atoi(p + 1) % gang_max;
+    }
+    else if (!strncmp(p, "mintck=", 7)) mintck= atoi(p + 7);
+    else if (!strcmp(p, "fast")) realtime= 0;
+    else if (!strcmp(p, "verbose")) verbose= 1;
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  name= pty_open(link);
+  if (!name)
+  {
+    printf("\n   Cannot create pty\n\n");
+    return 1;
+  }
+  printf("%s\n", link ? link : name);
+  fflush(stdout);
+
+  memset(flash, 0xff, sizeof(flash));           // Targets nicht geloescht
+
+  // Start der Firmware, danach Bereitmeldung
+  sim_delay(450, 0);
+  while (uart_ischar()) uart_getchar();
+  uart_printf("\r\n%s\r\n", ready_banner);
+  setupcmd= 1;
+  highbaud= 0;
+
+  while (1)
+  {
+    // Zeichen verwerfen bis 10 ms Ruhe, ausser nach Einstellkommandos
+    if (!setupcmd)
+    {
+      do
+      {
+        while (uart_ischar()) uart_getchar();
+        sim_delay(10, 0);
+      } while (uart_ischar());
+    }
+    setupcmd= 0;
+
+    do
+    {
+      rx= uart_getchar_tout(baud_idletout);
+      if (rx < 0)
+      {
+        if (highbaud) { curbaud= baudrate; highbaud= 0; }
+        ch= 0;
+      }
+      else
+      {
+        ch= rx;
+      }
+    } while (!strchr("PFRribDVgtcs", ch) || !ch);
+
+    logmsg("cmd '%c'\n", ch);
+    switch (ch)
+    {
+      case 'b' :
+      {
+        rx= uart_getchar_tout(frame_tout);
+        highbaud= baud_change(rx);
+        setupcmd= 1;
+        continue;
+      }
+      case 'g' :
+      {
+        gang_cfg= uart_gethex() & ((1 << gang_max)-1);
+        if (!gang_cfg) gang_cfg= 0x01;
+        gang_act= gang_cfg;
+        uart_printf("%s\r", hx(gang_cfg));
+        setupcmd= 1;
+        continue;
+      }
+      case 't' :
+      {
+        b= uart_gethex();
+        wr_pulse= uart_gethex();
+        tck_half= (b == 0xff) ? tck_default : b;
+        if (!wr_pulse) wr_pulse= wrpulse_default;
+        uart_printf("%s %s\r", hx(tck_half), hx(wr_pulse));
+        setupcmd= 1;
+        continue;
+      }
+      case 's' :
+      {
+        stat_on= uart_gethex();
+        uart_printf("%s\r", hx(stat_on));
+        setupcmd= 1;
+        continue;
+      }
+      case 'c' :
+      {
+        characterize();
+        break;
+      }
+      case 'i' :
+      {
+        // Kalibrierung erwartet Eingaben am Terminal, wird nicht nachgebildet
+        uart_printf("\n\n\r Calibrate the PWM to analog output (not simulated)\n\r");
+        break;
+      }
+      case 'P' :
+      {
+        proglen= pgm_start();
+        blockprogram(proglen);
+        stat_txfer= now_ms();
+        sim_delay(10, 1);
+        if (stat_on) stat_report();
+        break;
+      }
+      case 'F' :
+      case 'V' :
+      {
+        pgm_start();
+        frameprogram(ch == 'V');
+        stat_txfer= now_ms();
+        if (gang_cfg != 0x01) gang_report();
+        sim_delay(10, 1);
+        if (stat_on) stat_report();
+        break;
+      }
+      case 'D' :
+      {
+        pc= uart_gethexword();
+        proglen= uart_gethexword();
+        sim_delay(40, 1);
+        for (b= 0; b < (gang_max-1); b++)
+          if (gang_cfg & (1 << b)) break;
+        uart_printf("0x%s\r\n", hx(target_id(b)));
+        readframes(pc, proglen);
+        break;
+      }
+      case 'R' :
+      {
+        sim_delay(100, 1);
+        logmsg(" target running\n");
+        break;
+      }
+      case 'r' :
+      {
+        sim_delay(100, 1);
+        logmsg(" target stopped\n");
+        break;
+      }
+      default : break;
+    }
+    stat_on= 0;
+    sim_delay(500, 0);
+
+    if (highbaud)
+    {
+      curbaud= baudrate;
+      highbaud= 0;
+    }
+  }
+}
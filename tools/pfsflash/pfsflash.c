@@ -0,0 +1,1110 @@
+/* ------------------------------------------------------------
+                            pfsflash.c
+
+      Hostprogramm zum arduinobasierenden PFS Programmer,
+      Ersatz fuer das FreePascal-Programm pfsprog (gleiche
+      Aufrufparameter, gleiches Protokoll).
+
+        - serielle Schnittstelle direkt ueber termios
+        - Hexdatei wird mit dem gemeinsamen Loader (ihex.c)
+          in einem Durchgang eingelesen
+        - statt fester Wartezeiten nach dem Oeffnen der
+          Schnittstelle (Bootloader) wird auf die Bereit-
+          meldung des Programmers gewartet bzw. dieser
+          abgefragt, bis er antwortet
+
+      Mikrocontrollerunterstuetzung fuer:
+
+         - PFS154
+
+      Compiler: GCC
+
+      R. Seelig
+   ------------------------------------------------------------ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "ihex.h"
+
+#define sbaud           B115200
+
+#define mem_size        4096           // Flashspeicher PFS154 in Bytes
+#define blksize         500            // Blockgroesse Kommando 'P'
+
+// Rahmenprotokoll (Kommando 'F')
+#define frame_soh       0x01           // Beginn eines Datenrahmens
+#define frame_ack       0x06           // Rahmen vom Programmer korrekt empfangen
+#define frame_nak       0x15           // Rahmen fehlerhaft, wiederholen
+#define frame_can       0x18           // Uebertragung abbrechen
+#define frame_maxpairs  64             // max. Anzahl Wordpaare pro Rahmen
+#define frame_tout      1000           // Timeout auf Quittung in ms
+#define frame_rxtout    50             // Zeichentimeout im Rahmen (Firmware) in ms
+#define frame_maxretry  10             // max. Wiederholungen eines Rahmens
+
+#define ready_tout      3500           // max. Wartezeit auf den Programmer in ms
+#define ready_poll      50             // Abfrageintervall in ms
+
+#define pbar_len        50             // Laenge Progressbar
+
+#define job_maxargs     16             // Daemon: max. Anzahl Parameter eines Auftrags
+#define job_maxlen      4096           // Daemon: max. Laenge eines Auftrags
+
+int      ser_fd = -1;
+
+uint8_t  flashmem[mem_size];           // Speicherabbild wie im Target geflasht,
+                                       // je Word Hi-Byte, Lo-Byte
+uint8_t  readmem[mem_size];            // aus dem Target gelesenes Abbild (Kommando 'D')
+unsigned maxadr;                       // hoechste belegte Byteadresse + 1
+
+char     legacy = 0;                   // altes Blockprotokoll 'P'
+char     sparse = 1;                   // unbeschriebene Wordpaare nicht senden
+char     withpbar = 0;                 // Progressbar anzeigen
+char     stats = 0;                    // Zeitmessung der Programmierphasen
+int      frameresent;
+
+// Zeitmessung (Option stats): Zeitpunkte in ms (now_ms), Anzahl
+// uebertragener Zeichen und Words
+long     st_open, st_ready, st_cmd, st_id, st_erase, st_xfer, st_end;
+long     ser_txcnt, ser_rxcnt;
+int      st_words;
+
+/* --------------------------------------------------
+                        now_ms
+
+     liefert eine fortlaufende Zeit in Millisekunden
+   -------------------------------------------------- */
+long now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * 1000L) + (ts.tv_nsec / 1000000L);
+}
+
+/* ----------------------------------------------------------
+                           ser_open
+
+     oeffnet die serielle Schnittstelle mit 8N1 im Raw-
+     Modus
+
+     Rueckgabe:
+        0 : fehlerfrei, -1 : Schnittstelle nicht vorhanden
+   ---------------------------------------------------------- */
+int ser_open(char *portname, speed_t baud)
+{
+  struct termios tio;
+
+  ser_fd= open(portname, O_RDWR | O_NOCTTY);
+  if (ser_fd < 0) return -1;
+
+  if (tcgetattr(ser_fd, &tio) < 0) return -1;
+  cfmakeraw(&tio);
+  tio.c_cflag |= (CLOCAL | CREAD);
+  tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+  tio.c_cc[VMIN]= 0;
+  tio.c_cc[VTIME]= 0;
+  cfsetispeed(&tio, baud);
+  cfsetospeed(&tio, baud);
+  if (tcsetattr(ser_fd, TCSANOW, &tio) < 0) return -1;
+
+  return 0;
+}
+
+/* ----------------------------------------------------------
+                            ser_getc
+
+     liest ein Zeichen mit Timeout tout (ms)
+
+     Rueckgabe:
+        gelesenes Zeichen, -1 bei Timeout
+   ---------------------------------------------------------- */
+int ser_getc(int tout)
+{
+  struct pollfd pfd;
+  uint8_t ch;
+
+  pfd.fd= ser_fd;
+  pfd.events= POLLIN;
+  if (poll(&pfd, 1, tout) <= 0) return -1;
+  if (read(ser_fd, &ch, 1) != 1) return -1;
+  ser_rxcnt++;
+  return ch;
+}
+
+/* ----------------------------------------------------------
+                            ser_read
+
+     liest n Zeichen nach buf, tout ist das maximale
+     Zeitintervall zwischen 2 Zeichen
+
+     Rueckgabe:
+        Anzahl gelesener Zeichen
+   ---------------------------------------------------------- */
+int ser_read(uint8_t *buf, int n, int tout)
+{
+  struct pollfd pfd;
+  int cnt, r;
+
+  pfd.fd= ser_fd;
+  pfd.events= POLLIN;
+  cnt= 0;
+  while (cnt < n)
+  {
+    if (poll(&pfd, 1, tout) <= 0) break;
+    r= read(ser_fd, buf + cnt, n - cnt);
+    if (r <= 0) break;
+    cnt += r;
+  }
+  ser_rxcnt += cnt;
+  return cnt;
+}
+
+/* ----------------------------------------------------------
+                           ser_write
+   ---------------------------------------------------------- */
+void ser_write(const void *buf, int n)
+{
+  const uint8_t *p = buf;
+  int r;
+
+  while (n > 0)
+  {
+    r= write(ser_fd, p, n);
+    if (r <= 0) return;
+    ser_txcnt += r;
+    p += r;
+    n -= r;
+  }
+}
+
+void ser_putc(uint8_t ch)
+{
+  ser_write(&ch, 1);
+}
+
+/* ----------------------------------------------------------
+                            ser_gets
+
+     liest eine Zeile bis zum Zeichen term (ohne CR / LF)
+     nach s, tout ist das maximale Zeitintervall zwischen
+     2 Zeichen
+
+     Rueckgabe:
+        Laenge der Zeile, -1 bei Timeout
+   ---------------------------------------------------------- */
+int ser_gets(char *s, int size, char term, int tout)
+{
+  int ch, n;
+
+  n= 0;
+  while (1)
+  {
+    ch= ser_getc(tout);
+    if (ch < 0) { s[n]= 0; return -1; }
+    if (ch == term) break;
+    if ((ch != 0x0d) && (ch != 0x0a) && (ch != 0) && (n < (size-1))) s[n++]= ch;
+  }
+  s[n]= 0;
+  return n;
+}
+
+/* ----------------------------------------------------------
+                            ser_clear
+
+     verwirft alle Zeichen, die innerhalb von tout ms
+     empfangen werden
+   ---------------------------------------------------------- */
+void ser_clear(int tout)
+{
+  while (ser_getc(tout) >= 0);
+  tcflush(ser_fd, TCIFLUSH);
+}
+
+/* ----------------------------------------------------------
+                          crc16_update
+
+     CRC16 mit Polynom 0x1021 (wie _crc_xmodem_update der
+     avr-libc)
+   ---------------------------------------------------------- */
+uint16_t crc16_update(uint16_t crc, uint8_t data)
+{
+  uint8_t i;
+
+  crc ^= ((uint16_t)data << 8);
+  for (i= 0; i < 8; i++)
+  {
+    if (crc & 0x8000) crc= (crc << 1) ^ 0x1021; else crc <<= 1;
+  }
+  return crc;
+}
+
+/* --------------------------------------------------
+                       readhexfile
+
+     liest eine Intel-Hexdatei (gemeinsamer Loader
+     ../ihex) und legt sie in flashmem ab (Hi-Byte vor
+     Lo-Byte), maxadr ist die hoechste belegte Byte-
+     adresse + 1. Daten ausserhalb des Flashspeichers
+     (Configuration Words) werden ignoriert.
+
+     Rueckgabe:
+        0 : fehlerfrei, sonst Fehler von ihex_load
+   -------------------------------------------------- */
+int readhexfile(char *dname)
+{
+  uint16_t   words[mem_size / 2];
+  ihex_image img;
+  int        err, i;
+
+  img.words= words;
+  img.wordcnt= mem_size / 2;
+  err= ihex_load(dname, &img);
+  if (err) return err;
+
+  for (i= 0; i < (mem_size / 2); i++)
+  {
+    flashmem[i*2]= words[i] >> 8;
+    flashmem[(i*2)+1]= words[i] & 0xff;
+  }
+  maxadr= img.maxadr;
+  return 0;
+}
+
+/* --------------------------------------------------
+                          pbar
+
+     Textmode-Progressbar, value = 0 schreibt die
+     Skala
+   -------------------------------------------------- */
+void pbar(long startzeit, int maxwert, int value)
+{
+  int i, n;
+
+  if (!withpbar) return;
+
+  if (!value)
+  {
+    printf(" Writing|");
+    for (i= 0; i <= pbar_len; i++) printf("%c", (i % 10) ? '-' : '|');
+    printf("\n");
+    return;
+  }
+
+  n= (pbar_len * value) / maxwert;
+  printf("\r        ");
+  for (i= 0; i <= n; i++) printf("#");
+  printf("\r\033[%dC %d%% %.2fs  ", pbar_len + 10, (value*100) / maxwert,
+         (float)(now_ms() - startzeit) / 1000);
+  fflush(stdout);
+}
+
+/* --------------------------------------------------
+                       prog_ready
+
+     wartet nach dem Oeffnen der Schnittstelle (Reset
+     des AVR, Bootloader) bis die Firmware Kommandos
+     annimmt. Nach einem Reset meldet sich die Firm-
+     ware mit "PFSPROG READY". Wurde der AVR beim Oeffnen
+     nicht zurueckgesetzt, kommt keine Meldung, des-
+     halb wird zusaetzlich alle ready_poll ms das Ein-
+     stellkommando 't' mit der Voreinstellung des
+     ICSP-Takts gesendet. Die Firmware verwirft vor
+     der Bereitmeldung alle empfangenen Zeichen, die
+     erste Zeile danach (Meldung oder Antwort auf 't')
+     zeigt die Bereitschaft an.
+
+     Eine Firmware ohne 't' und ohne Bereitmeldung
+     antwortet nicht, dann wird nach tout ms ange-
+     nommen, dass sie bereit ist.
+
+     Rueckgabe:
+        0 : Programmer hat geantwortet, -1 : Timeout
+   -------------------------------------------------- */
+int prog_ready(int tout)
+{
+  long t0;
+  char s[32];
+
+  t0= now_ms();
+  while ((now_ms() - t0) < tout)
+  {
+    ser_write("tff00", 5);
+    if (ser_gets(s, sizeof(s), 0x0d, ready_poll) >= 0)
+    {
+      if (!s[0]) ser_gets(s, sizeof(s), 0x0d, ready_poll);   // Leerzeile vor der Meldung
+      ser_clear(20);                           // Antworten auf weitere Abfragen
+      return 0;
+    }
+  }
+  ser_clear(20);
+  return -1;
+}
+
+/* --------------------------------------------------
+                       pgm_start
+
+     beginnt das Programmierkommando cmd ('P' oder
+     'F'): Device-ID pruefen, Programmlaenge senden
+     und die Bestaetigung abwarten (der Programmer
+     loescht dabei das Target)
+
+     Rueckgabe:
+        0 : fehlerfrei, 1 : Kommunikationsfehler,
+        2 : falsche Device-ID
+   -------------------------------------------------- */
+int pgm_start(char cmd)
+{
+  char s[32];
+  unsigned echo;
+
+  ser_putc(0x0a);
+  ser_clear(20);
+  if (stats)
+  {
+    // Zeitmessung fuer dieses Kommando einschalten
+    ser_write("s01", 3);
+    if ((ser_gets(s, sizeof(s), 0x0d, 1000) < 0) || (strcmp(s, "01")))
+    {
+      printf("programmer does not support timing statistics...\n");
+      return 1;
+    }
+  }
+  st_cmd= now_ms();
+  ser_putc(cmd);
+
+  if (ser_gets(s, sizeof(s), 0x0d, 1000) < 0) return 1;
+  st_id= now_ms();
+  if (strcmp(s, "0x0AA1"))
+  {
+    printf("Unknown ID: %s\n", s);
+    return 2;
+  }
+  printf(" ID: 0x0aa1 found, PFS154 present...\n");
+
+  sprintf(s, "%04X", maxadr);
+  ser_write(s, 4);
+  if (ser_gets(s, sizeof(s), 0x0d, 2000) < 0) return 1;
+  st_erase= now_ms();
+  if ((sscanf(s, "%x", &echo) != 1) || (echo != maxadr))
+  {
+    printf("wrong answer from programmer, expected: %u but get: %s\n", maxadr, s);
+    return 1;
+  }
+  return 0;
+}
+
+/* --------------------------------------------------
+                         pairblank
+
+     liefert 1, wenn das Wordpaar p im Speicher-
+     abbild unbeschrieben ist
+   -------------------------------------------------- */
+int pairblank(int p)
+{
+  return ((flashmem[p*4] & flashmem[(p*4)+1] & flashmem[(p*4)+2] & flashmem[(p*4)+3]) == 0xff);
+}
+
+/* --------------------------------------------------
+                         nextframe
+
+     ermittelt ab dem Wordpaar *p den naechsten zu
+     sendenden Rahmen, im sparse-Modus werden unbe-
+     schriebene Wordpaare uebersprungen.
+
+     Rueckgabe:
+        Anzahl Wordpaare, 0 = keine Daten mehr
+   -------------------------------------------------- */
+int nextframe(int pairs, int *p)
+{
+  int cnt;
+
+  if (sparse)
+    while ((*p < pairs) && pairblank(*p)) (*p)++;
+
+  cnt= 0;
+  while (((*p + cnt) < pairs) && (cnt < frame_maxpairs))
+  {
+    if (sparse && pairblank(*p + cnt)) break;
+    cnt++;
+  }
+  return cnt;
+}
+
+/* --------------------------------------------------
+                         sendframe
+
+     sendet cnt Wordpaare ab der Word-Adresse adr
+     als Rahmen mit der Nummer seq
+   -------------------------------------------------- */
+void sendframe(uint8_t seq, int adr, int cnt)
+{
+  uint8_t  frame[(frame_maxpairs*4) + 7];
+  uint16_t crc;
+  int      i, n;
+
+  frame[0]= frame_soh;
+  frame[1]= seq;
+  frame[2]= adr >> 8;
+  frame[3]= adr & 0xff;
+  frame[4]= cnt;
+  memcpy(&frame[5], &flashmem[adr*2], cnt*4);
+  n= 5 + (cnt*4);
+
+  crc= 0xffff;
+  for (i= 1; i < n; i++) crc= crc16_update(crc, frame[i]);
+  frame[n]= crc >> 8;
+  frame[n+1]= crc & 0xff;
+
+  ser_write(frame, n+2);
+}
+
+/* --------------------------------------------------
+                        frameupload
+
+     uebertraegt das Speicherabbild im Rahmen-
+     protokoll, jeder Rahmen wird vom Programmer
+     mit ACK / NAK quittiert
+
+     Rueckgabe:
+        0 : fehlerfrei, 1 : Rahmen nicht quittiert
+   -------------------------------------------------- */
+int frameupload(long startzeit)
+{
+  int      pairs, p, p2, cnt;
+  int      fanz, fnr, retry;
+  int      code, aseq;
+  uint8_t  seq;
+
+  frameresent= 0;
+  st_words= 0;
+  pairs= (maxadr + 3) / 4;
+  if (pairs > (mem_size / 4)) pairs= mem_size / 4;
+
+  // Anzahl Rahmen (inkl. Endrahmen) fuer die Progressbar ermitteln
+  fanz= 1; p2= 0;
+  while ((cnt= nextframe(pairs, &p2))) { p2 += cnt; fanz++; }
+
+  p= 0; seq= 0; fnr= 0;
+  do
+  {
+    cnt= nextframe(pairs, &p);
+    if (!cnt) p= 0;                            // Endrahmen
+
+    for (retry= 0; retry < frame_maxretry; retry++)
+    {
+      sendframe(seq, p*2, cnt);
+      code= ser_getc(frame_tout);
+      aseq= ser_getc(frame_tout);
+      if ((code == frame_ack) && (aseq == seq)) break;
+      frameresent++;
+      ser_clear(20);
+    }
+    if (retry == frame_maxretry)
+    {
+      // CAN wertet der Programmer nur zwischen zwei Rahmen aus, einen
+      // unvollstaendigen Rahmen verwirft er erst nach 2 * frame_rxtout
+      ser_clear(3 * frame_rxtout);
+      ser_putc(frame_can); ser_putc(frame_can); ser_putc(frame_can);
+      return 1;
+    }
+
+    seq++;
+    p += cnt;
+    st_words += cnt*2;
+    fnr++;
+    pbar(startzeit, fanz, fnr);
+  } while (cnt);
+
+  return 0;
+}
+
+/* --------------------------------------------------
+                        blockupload
+
+     uebertraegt das Speicherabbild im alten Block-
+     protokoll (Kommando 'P'), jeder Block wird vom
+     Programmer nach dem Flashen mit 'x' bestaetigt
+
+     Rueckgabe:
+        0 : fehlerfrei, 1 : Kommunikationsfehler
+   -------------------------------------------------- */
+int blockupload(long startzeit)
+{
+  int blkanz, i;
+  uint8_t blk[blksize];
+
+  blkanz= maxadr / blksize;
+  if (maxadr % blksize) blkanz++;
+  st_words= maxadr / 2;
+
+  for (i= 0; i < blkanz; i++)
+  {
+    memset(blk, 0xff, blksize);
+    if (((i+1) * blksize) <= mem_size)
+      memcpy(blk, &flashmem[i*blksize], blksize);
+    else
+      memcpy(blk, &flashmem[i*blksize], mem_size - (i*blksize));
+    ser_write(blk, blksize);
+    if (ser_getc(3000) != 'x') return 1;
+    pbar(startzeit, blkanz, i+1);
+  }
+  return 0;
+}
+
+/* --------------------------------------------------
+                       stat_print
+
+     liest die Zeitmessung des Programmers ("S id
+     erase xfer write fin", ms) und gibt sie zusammen
+     mit den auf dem Host gemessenen Zeiten aus
+   -------------------------------------------------- */
+void stat_print(long txbytes, long rxbytes)
+{
+  char  s[64];
+  int   fid, ferase, fxfer, fwrite, ffin;
+  long  xfer;
+
+  if ((ser_gets(s, sizeof(s), 0x0d, 2000) < 0) ||
+      (sscanf(s, "S %d %d %d %d %d", &fid, &ferase, &fxfer, &fwrite, &ffin) != 5))
+  {
+    printf(" no timing statistics from programmer...\n\n");
+    return;
+  }
+  st_end= now_ms();
+
+  xfer= st_xfer - st_erase;
+  if (xfer < 1) xfer= 1;
+
+  printf(" Timing                     host   programmer\n");
+  printf("   port open / wait   : %6ld ms\n", st_ready - st_open);
+  printf("   device ID          : %6ld ms  %6d ms\n", st_id - st_cmd, fid);
+  printf("   erase              : %6ld ms  %6d ms\n", st_erase - st_id, ferase);
+  printf("   transfer           : %6ld ms  %6d ms\n", xfer, fxfer);
+  printf("     flash write      :            %6d ms\n", fwrite);
+  printf("   finalize           : %6ld ms  %6d ms\n", st_end - st_xfer, ffin);
+  printf("   total              : %6ld ms\n\n", st_end - st_open);
+  printf(" Words: %d, %ld words/s\n", st_words, (st_words * 1000L) / xfer);
+  printf(" Wire : %ld bytes sent, %ld bytes received, %ld bytes/s\n\n",
+         txbytes, rxbytes, ((txbytes + rxbytes) * 1000L) / xfer);
+}
+
+/* --------------------------------------------------
+                        readdevice
+
+     liest words Words ab Word-Adresse 0 aus dem
+     Target nach readmem (Kommando 'D', die Daten
+     kommen in Rahmen wie beim Flashen, ohne Quit-
+     tierung)
+
+     Rueckgabe:
+        0 : fehlerfrei, 1 : Kommunikationsfehler,
+        2 : falsche Device-ID
+   -------------------------------------------------- */
+int readdevice(int words)
+{
+  char     s[32];
+  uint8_t  hdr[4], buf[(frame_maxpairs*4) + 2];
+  uint16_t crc;
+  int      i, n, adr, cnt, ch;
+  uint8_t  expseq;
+
+  memset(readmem, 0xff, sizeof(readmem));
+
+  ser_putc(0x0a);
+  ser_clear(20);
+  sprintf(s, "D%04X%04X", 0, words);
+  ser_write(s, 9);
+
+  if (ser_gets(s, sizeof(s), 0x0d, 1000) < 0) return 1;
+  if (strcmp(s, "0x0AA1"))
+  {
+    printf("Unknown ID: %s\n", s);
+    return 2;
+  }
+
+  expseq= 0;
+  do
+  {
+    do
+    {
+      ch= ser_getc(frame_tout);
+      if (ch < 0) return 1;
+    } while (ch != frame_soh);
+
+    if (ser_read(hdr, 4, frame_tout) != 4) return 1;
+    adr= (hdr[1] << 8) | hdr[2];
+    cnt= hdr[3];
+    if ((hdr[0] != expseq) || (cnt > frame_maxpairs)) return 1;
+    n= (cnt*4) + 2;
+    if (ser_read(buf, n, frame_tout) != n) return 1;
+
+    crc= 0xffff;
+    for (i= 0; i < 4; i++) crc= crc16_update(crc, hdr[i]);
+    for (i= 0; i < n; i++) crc= crc16_update(crc, buf[i]);
+    if (crc) return 1;
+
+    if (((adr*2) + (cnt*4)) <= mem_size) memcpy(&readmem[adr*2], buf, cnt*4);
+    expseq++;
+  } while (cnt);
+
+  return 0;
+}
+
+/* --------------------------------------------------
+                        verifyimage
+
+     vergleicht die ersten words Words von flashmem
+     und readmem (14 Bit, unbeschrieben = 0x3fff)
+     und gibt die ersten 10 Abweichungen aus
+
+     Rueckgabe:
+        Anzahl abweichender Words
+   -------------------------------------------------- */
+int verifyimage(int words)
+{
+  int w, soll, ist, errs;
+
+  errs= 0;
+  for (w= 0; w < words; w++)
+  {
+    soll= ((flashmem[w*2] << 8) | flashmem[(w*2)+1]) & 0x3fff;
+    ist= ((readmem[w*2] << 8) | readmem[(w*2)+1]) & 0x3fff;
+    if (soll != ist)
+    {
+      if (errs < 10)
+        printf(" Verify error at 0x%04X: expected 0x%04X, read 0x%04X\n", w, soll, ist);
+      errs++;
+    }
+  }
+  return errs;
+}
+
+/* --------------------------------------------------
+                          usage
+   -------------------------------------------------- */
+void usage(void)
+{
+  printf("\nSyntax:\n");
+  printf("pfsflash action port filename [nowait] [legacy] [full] [stats]\n");
+  printf("pfsflash daemon port socket\n\n");
+  printf("  action    : wr    = upload (write) file to mcu\n");
+  printf("              txwr  = upload (write) file to mcu (with bargraph)\n");
+  printf("              verify= compare mcu with file\n");
+  printf("              run   = run the microcontroller\n");
+  printf("              stop  = stop a running program\n");
+  printf("              calib = calibrate Vdd / Vpp of the programmer\n");
+  printf("              quit  = terminate a running daemon\n");
+  printf("  port      : port were this adapter is connected to, or the\n");
+  printf("              socket of a running daemon\n");
+  printf("  filename  : file to upload\n");
+  printf("  nowait    : optional parameter: do not wait for the\n");
+  printf("              bootloader of the programmer\n");
+  printf("  legacy    : optional parameter: old block protocol\n");
+  printf("              without checksum\n");
+  printf("  full      : optional parameter: also send blank words\n");
+  printf("  stats     : optional parameter: time spent in each phase\n");
+  printf("              of flashing and effective throughput\n\n");
+  printf("  daemon    : keeps the port open and executes the actions\n");
+  printf("              sent to the socket one after another\n\n");
+  printf("  Example   : pfsflash txwr /dev/ttyUSB0 helloworld.ihx\n");
+  printf("              pfsflash daemon /dev/ttyUSB0 /tmp/pfsflash.sock &\n");
+  printf("              pfsflash txwr /tmp/pfsflash.sock helloworld.ihx\n\n");
+}
+
+/* --------------------------------------------------
+                       needsfile
+
+     liefert 1, wenn die Aktion eine Hexdatei
+     benoetigt
+   -------------------------------------------------- */
+int needsfile(char *action)
+{
+  return (!strcmp(action, "wr") || !strcmp(action, "txwr") || !strcmp(action, "verify"));
+}
+
+/* --------------------------------------------------
+                          do_job
+
+     fuehrt eine Aktion mit dem bereiten Programmer
+     aus, argv[0] ist die Aktion, argv[1] ggf. die
+     Hexdatei, danach folgen die Optionen
+
+     Rueckgabe:
+        0 : fehlerfrei, 1 : Fehler
+   -------------------------------------------------- */
+int do_job(int argc, char **argv)
+{
+  char  *action;
+  int   i, err, words;
+  long  t0, txbytes, rxbytes;
+
+  action= argv[0];
+  legacy= 0;
+  sparse= 1;
+  withpbar= 0;
+  stats= 0;
+  for (i= 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "legacy")) legacy= 1;
+    if (!strcmp(argv[i], "full")) sparse= 0;
+    if (!strcmp(argv[i], "stats") || !strcmp(argv[i], "--stats")) stats= 1;
+  }
+
+  if (needsfile(action))
+  {
+    if (argc < 2)
+    {
+      usage();
+      return 1;
+    }
+    err= readhexfile(argv[1]);
+    if (err)
+    {
+      printf("\n   %s: %s\n\n", ihex_errstr(err), argv[1]);
+      return 1;
+    }
+  }
+
+  err= 0;
+  if (!strcmp(action, "run"))
+  {
+    ser_putc('R');
+    printf("PFS - Controller is running...\n\n");
+  }
+  else if (!strcmp(action, "stop"))
+  {
+    ser_putc('r');
+    printf("PFS - Controller stopped...\n\n");
+  }
+  else if (!strcmp(action, "calib"))
+  {
+    ser_putc('i');
+    printf("Programmer is in calibration mode...\n\n");
+  }
+  else if (!strcmp(action, "verify"))
+  {
+    words= (maxadr + 1) / 2;
+    printf(" Verifying %d words...\n", words);
+    err= readdevice(words);
+    if (err == 1) printf("communication error while reading...\n");
+    if (!err)
+    {
+      i= verifyimage(words);
+      if (i)
+      {
+        printf(" Verify FAILED, %d words differ\n\n", i);
+        err= 1;
+      }
+      else
+      {
+        printf(" Verify OK\n\n");
+      }
+    }
+  }
+  else if (!strcmp(action, "wr") || !strcmp(action, "txwr"))
+  {
+    withpbar= !strcmp(action, "txwr");
+    err= pgm_start(legacy ? 'P' : 'F');
+    if (!err)
+    {
+      printf(" Words to flash: %d\n\n", maxadr / 2);
+      t0= now_ms();
+      pbar(t0, 1, 0);
+      txbytes= ser_txcnt;
+      rxbytes= ser_rxcnt;
+      if (legacy) err= blockupload(t0); else err= frameupload(t0);
+      st_xfer= now_ms();
+      txbytes= ser_txcnt - txbytes;
+      rxbytes= ser_rxcnt - rxbytes;
+      if (withpbar) printf("\n");
+      if (err)
+      {
+        printf("\ncommunication error, frame not acknowledged...\n");
+      }
+      else
+      {
+        printf("\n Flashing done: %.2fs\n", (float)(now_ms() - t0) / 1000);
+        if (frameresent) printf(" Frames resent: %d\n", frameresent);
+        printf("\n");
+        if (stats) stat_print(txbytes, rxbytes);
+      }
+    }
+    else if (err == 1)
+    {
+      printf("communication error...\n");
+    }
+    else
+    {
+      printf("Programm terminated...\n");
+    }
+  }
+  else
+  {
+    usage();
+    err= 1;
+  }
+
+  tcdrain(ser_fd);
+  return (err ? 1 : 0);
+}
+
+/* --------------------------------------------------
+                       daemon_run
+
+     oeffnet den Programmer einmalig und nimmt dann
+     ueber den Unix-Socket sockpath nacheinander
+     Auftraege an, so dass Reset, Bootloader und
+     Verbindungsaufbau nur einmal anfallen.
+
+     Auftrag (Client an Daemon):
+        Aktion, Hexdatei (absoluter Pfad) und
+        Optionen, jeweils mit '\n' abgeschlossen,
+        eine Leerzeile beendet den Auftrag
+
+     Antwort (Daemon an Client):
+        die Ausgaben der Aktion, danach ein 0-Byte
+        und der Exitcode als Byte
+
+     Die Aktion "quit" beendet den Daemon.
+   -------------------------------------------------- */
+int daemon_run(char *port, char *sockpath)
+{
+  struct sockaddr_un sa;
+  char   req[job_maxlen];
+  char   *jargv[job_maxargs];
+  int    lfd, cfd, saved, n, r, jargc, err;
+  char   *p;
+  uint8_t tail[2];
+
+  if (ser_open(port, sbaud) < 0)
+  {
+    printf("\n   Cannot open port: %s\n\n", port);
+    return 1;
+  }
+  printf(" waiting for programmer...\n");
+  prog_ready(ready_tout);
+
+  lfd= socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family= AF_UNIX;
+  strncpy(sa.sun_path, sockpath, sizeof(sa.sun_path) - 1);
+  unlink(sockpath);
+  if ((lfd < 0) || (bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) < 0) || (listen(lfd, 4) < 0))
+  {
+    printf("\n   Cannot create socket: %s\n\n", sockpath);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);                    // Client vorzeitig beendet
+  printf(" pfsflash daemon: %s on %s\n\n", port, sockpath);
+  fflush(stdout);
+
+  while (1)
+  {
+    cfd= accept(lfd, 0, 0);
+    if (cfd < 0) continue;
+
+    // Auftrag bis zur Leerzeile lesen
+    n= 0;
+    while (n < (job_maxlen - 1))
+    {
+      r= read(cfd, req + n, job_maxlen - 1 - n);
+      if (r <= 0) break;
+      n += r;
+      req[n]= 0;
+      if (strstr(req, "\n\n")) break;
+    }
+    req[n]= 0;
+
+    jargc= 0;
+    p= req;
+    while ((*p) && (*p != '\n') && (jargc < job_maxargs))
+    {
+      jargv[jargc++]= p;
+      p= strchr(p, '\n');
+      if (!p) break;
+      *p++= 0;
+    }
+    if (!jargc) { close(cfd); continue; }
+
+    printf(" job: %s %s\n", jargv[0], (jargc > 1) ? jargv[1] : "");
+    fflush(stdout);
+
+    if (!strcmp(jargv[0], "quit"))
+    {
+      tail[0]= 0; tail[1]= 0;
+      write(cfd, tail, 2);
+      close(cfd);
+      break;
+    }
+
+    // Ausgaben der Aktion an den Client
+    saved= dup(1);
+    dup2(cfd, 1);
+    st_open= now_ms();
+    ser_clear(10);
+    prog_ready(ready_tout);                    // Pause des vorherigen Kommandos abwarten
+    st_ready= now_ms();
+    err= do_job(jargc, jargv);
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+
+    tail[0]= 0; tail[1]= err;
+    write(cfd, tail, 2);
+    close(cfd);
+    printf("      %s\n", err ? "failed" : "ok");
+    fflush(stdout);
+  }
+
+  close(lfd);
+  unlink(sockpath);
+  close(ser_fd);
+  return 0;
+}
+
+/* --------------------------------------------------
+                       client_run
+
+     sendet eine Aktion an einen laufenden Daemon
+     und gibt dessen Ausgaben aus
+
+     Rueckgabe:
+        Exitcode der Aktion
+   -------------------------------------------------- */
+int client_run(char *sockpath, int argc, char **argv)
+{
+  struct sockaddr_un sa;
+  char   req[job_maxlen];
+  char   path[PATH_MAX];
+  uint8_t buf[256];
+  int    fd, i, n, r, zero, code;
+
+  fd= socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family= AF_UNIX;
+  strncpy(sa.sun_path, sockpath, sizeof(sa.sun_path) - 1);
+  if ((fd < 0) || (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0))
+  {
+    printf("\n   Cannot connect to daemon: %s\n\n", sockpath);
+    return 1;
+  }
+
+  // Aktion, Hexdatei mit absolutem Pfad (der Daemon hat ein anderes
+  // Arbeitsverzeichnis), Optionen
+  n= 0;
+  for (i= 0; i < argc; i++)
+  {
+    if ((i == 1) && needsfile(argv[0]) && realpath(argv[i], path))
+      n += snprintf(req + n, job_maxlen - n, "%s\n", path);
+    else
+      n += snprintf(req + n, job_maxlen - n, "%s\n", argv[i]);
+    if (n >= (job_maxlen - 2)) return 1;
+  }
+  req[n++]= '\n';
+  write(fd, req, n);
+
+  zero= 0;
+  code= 1;
+  while ((r= read(fd, buf, sizeof(buf))) > 0)
+  {
+    for (i= 0; i < r; i++)
+    {
+      if (zero) { code= buf[i]; zero= 0; continue; }
+      if (!buf[i]) { zero= 1; continue; }
+      putchar(buf[i]);
+    }
+    fflush(stdout);
+  }
+  close(fd);
+  return code;
+}
+
+/* ---------------------------------------------------------------------------
+                                    M A I N
+   --------------------------------------------------------------------------- */
+int main(int argc, char **argv)
+{
+  struct stat st;
+  char   *sockpath;
+  char   nowait;
+  int    i, err;
+
+  if (argc < 3)
+  {
+    usage();
+    return 1;
+  }
+
+  if (!strcmp(argv[1], "daemon"))
+  {
+    if (argc < 4)
+    {
+      usage();
+      return 1;
+    }
+    return daemon_run(argv[2], argv[3]);
+  }
+
+  if ((argc < 4) && needsfile(argv[1]))
+  {
+    usage();
+    return 1;
+  }
+
+  // port ist der Socket eines laufenden Daemons: Aktion dorthin senden,
+  // Aktion und Parameter ohne den Port
+  if ((!stat(argv[2], &st)) && S_ISSOCK(st.st_mode))
+  {
+    sockpath= argv[2];
+    argv[2]= argv[1];
+    return client_run(sockpath, argc - 2, &argv[2]);
+  }
+
+  if (!strcmp(argv[1], "quit"))
+  {
+    usage();
+    return 1;
+  }
+
+  nowait= 0;
+  for (i= 3; i < argc; i++)
+    if (!strcmp(argv[i], "nowait")) nowait= 1;
+
+  // Hexdatei vor dem Oeffnen der Schnittstelle pruefen
+  if (needsfile(argv[1]) && ((err= readhexfile(argv[3]))))
+  {
+    printf("\n   %s: %s\n\n", ihex_errstr(err), argv[3]);
+    return 1;
+  }
+
+  st_open= now_ms();
+  if (ser_open(argv[2], sbaud) < 0)
+  {
+    printf("\n   Cannot open port: %s\n\n", argv[2]);
+    return 1;
+  }
+
+  printf(" waiting for programmer...\n");
+  prog_ready(nowait ? 300 : ready_tout);
+  st_ready= now_ms();
+  printf("\n");
+
+  argv[2]= argv[1];
+  err= do_job(argc - 2, &argv[2]);
+
+  close(ser_fd);
+  return err;
+}
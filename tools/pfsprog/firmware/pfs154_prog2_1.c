@@ -13,6 +13,12 @@
              mit VU = 2 (analogpin0)
            . dto. an PB1 mit VU = 5.7
 
+        - Gang-Programmierung: SCK (PD6) und Vdd / Vpp
+          werden an alle Targets gefuehrt, jedes Target
+          erhaelt eine eigene SDA-Leitung:
+             Target 0..2 : PD2, PD4, PD7
+             Target 3..6 : PC0, PC3, PC4, PC5
+
 
      MCU     : atmegaxx8
      F_CPU   : 16000000
@@ -22,8 +28,11 @@
    ---------------------------------------------------------- */
 
 #include <util/delay.h>
+#include <util/delay_basic.h>
+#include <util/crc16.h>
 #include <avr/io.h>
 #include <avr/eeprom.h>
+#include <avr/interrupt.h>
 #include <math.h>
 
 #include "avr_gpio.h"
@@ -63,12 +72,15 @@ float gain_vpp = gain_vpp_raw;;
 #define calib_init()       PC1_input_init()
 #define is_calib()         (!(is_PC1()))
 
-// I/O Leitungen fuer SDA (PFS-PA6) und SCK (PFS-PA3) des PFS-Targets
-#define sda_out_init()     PD2_output_init()
-//#define sda_in_init()      (DDRD &= ~MASK2)
-#define sda_in_init()      PD2_input_init()
-#define sda_set()          PD2_set()
-#define sda_clr()          PD2_clr()
+// I/O Leitungen fuer SDA (PFS-PA6) und SCK (PFS-PA3) des PFS-Targets.
+// Die SDA-Leitungen aller aktiven Targets (Gang-Programmierung) werden
+// gemeinsam ueber die Masken gang_maskd / gang_maskc angesprochen, ohne
+// Kommando 'g' ist das nur Target 0 an PD2
+#define sda_out_init()     ( DDRD |= gang_maskd, DDRC |= gang_maskc )
+#define sda_in_init()      ( DDRD &= ~gang_maskd, PORTD |= gang_maskd, \
+                             DDRC &= ~gang_maskc, PORTC |= gang_maskc )
+#define sda_set()          ( PORTD |= gang_maskd, PORTC |= gang_maskc )
+#define sda_clr()          ( PORTD &= ~gang_maskd, PORTC &= ~gang_maskc )
 #define is_sda()           is_PD2()
 
 #define sck_out_init()     PD6_output_init()
@@ -96,10 +108,77 @@ const float    device_vpp_erase = 8.2;
 const uint16_t device_memend    = 0x7ff;
 const uint16_t device_id        = 0xaa1;
 
-uint8_t  blockmem[512];
+uint8_t  blockmem[512];                 // Blockpuffer 'P', fuer 'F' 2 Rahmenpuffer a 256 Bytes
 uint16_t blksize = 500;
 uint8_t  blkanz;
 
+// Rahmenprotokoll (Kommando 'F')
+#define frame_soh          0x01         // Beginn eines Datenrahmens
+#define frame_ack          0x06         // Rahmen korrekt empfangen
+#define frame_nak          0x15         // Rahmen fehlerhaft, bitte wiederholen
+#define frame_can          0x18         // Host bricht die Uebertragung ab
+#define frame_verr         0x19         // Verify-Fehler beim Flashen ('V'), Abbruch
+#define frame_maxpairs     64           // max. Anzahl Wordpaare (a 4 Bytes) pro Rahmen
+#define frame_bufsize      256          // Groesse eines Rahmenpuffers in blockmem
+#define frame_tout         50           // Timeout zwischen 2 Zeichen eines Rahmens in ms
+#define frame_idletout     3000         // Timeout auf den Beginn eines Rahmens in ms
+#define frame_maxretry     10           // max. Anzahl aufeinanderfolgender Fehler
+
+// Gang-Programmierung (Kommando 'g'), SDA-Leitungen der Targets 0..6
+#define gang_max           7
+const uint8_t gang_dmask[gang_max] = { MASK2, MASK4, MASK7, 0, 0, 0, 0 };
+const uint8_t gang_cmask[gang_max] = { 0, 0, 0, MASK0, MASK3, MASK4, MASK5 };
+
+uint8_t  gang_cfg = 0x01;               // vom Host konfigurierte Targets (Bit n = Target n)
+uint8_t  gang_act = 0x01;               // davon noch aktive (ID ok, kein Verify-Fehler)
+uint8_t  gang_maskd = MASK2;            // SDA-Pins der aktiven Targets an PORTD
+uint8_t  gang_maskc = 0;                // dto. an PORTC
+uint8_t  gang_first = 0;                // erstes aktives Target
+uint16_t gang_id[gang_max];             // Device-ID je Target
+uint16_t gang_erradr[gang_max];         // erste Verify-Fehleradresse, 0xffff = ok
+uint16_t gang_errword[gang_max];        // dort gelesener Wert
+
+uint8_t  rxs_d[16];                     // Bitscheiben des letzten pfs_receiveword:
+uint8_t  rxs_c[16];                     // PIND / PINC je empfangenem Bit
+uint8_t  rxs_len;
+
+// ICSP-Takt (Kommandos 't' und 'c'): Wartezeit je halbem SCK-Takt in
+// Durchlaeufen von _delay_loop_1 (1 = 3 CPU-Takte, 187,5 ns bei 16 MHz).
+// Die Voreinstellung entspricht den urspruenglichen 3 us
+#define tck_default        ((F_CPU / 1000000) * 3 / 3)
+#define wrpulse_default    22           // Programmierimpuls in us
+#define tck_testlen        64           // Words Testmuster fuer 'c'
+const uint8_t tck_steps[] = { 16, 12, 9, 7, 5, 4, 3, 2, 1, 0 };
+
+uint8_t  tck_half = tck_default;        // halber SCK-Takt beim Senden
+uint8_t  tck_read;                      // nach steigender Flanke bis zum Lesen von SDA
+uint8_t  tck_hold;                      // nach dem Lesen von SDA
+uint8_t  wr_pulse = wrpulse_default;    // Dauer eines Programmierimpulses in us
+uint16_t wr_loops;                      // dto. in Durchlaeufen von _delay_loop_2
+
+#define tck_wait(n)        { if (n) _delay_loop_1(n); }
+
+#define ready_banner       "PFSPROG READY"   // Bereitmeldung nach dem Start
+
+// Baudratenumschaltung (Kommando 'b'), Index = Kennziffer '0'..'3'
+const uint32_t baudrates[4] = { BAUDRATE, 250000, 500000, 1000000 };
+#define baud_testlen       32           // Laenge Testmuster nach dem Umschalten
+#define baud_tout          300          // Timeout auf das Testmuster in ms
+#define baud_idletout      2000         // ohne Kommando danach: zurueck auf Standardbaudrate
+
+// Zeitmessung (Kommando 's'): Zeitpunkte der Phasen eines Programmier-
+// kommandos in ms (tick_get) und die Summe der Programmierimpulse in
+// Schritten von Timer2 (tick_fine)
+#define tick_fineperms     (F_CPU / 64 / 1000)   // Timer2-Schritte je ms
+
+uint8_t  stat_on = 0;                   // Zeitmessung fuer das naechste Kommando
+uint16_t stat_tstart;                   // Kommando empfangen
+uint16_t stat_tid;                      // Device-ID gesendet
+uint16_t stat_tlen;                     // Programmlaenge empfangen
+uint16_t stat_terase;                   // Target geloescht, Schreibmodus aktiv
+uint16_t stat_txfer;                    // letzter Rahmen / Block empfangen und geflasht
+uint32_t stat_wrsum;                    // Summe der Dauer von pfs_writewords
+
 
 /* --------------------------------------------------
                    uart_gethex
@@ -155,6 +234,292 @@ uint16_t uart_gethexword(void)
   return i2;
 }
 
+/* --------------------------------------------------
+                      tick_init
+
+     Timer2 als Millisekunden-Zeitbasis (CTC-Mode,
+     F_CPU / 64 / 250 = 1 kHz).
+
+     Hinweis: pwm_dcdc_init verwendet ebenfalls
+     Timer2 und kann nicht gleichzeitig benutzt
+     werden
+   -------------------------------------------------- */
+volatile uint16_t tick_ms = 0;
+
+ISR (TIMER2_COMPA_vect)
+{
+  tick_ms++;
+}
+
+void tick_init(void)
+{
+  TCCR2A = (1 << WGM21);                 // CTC
+  TCCR2B = (1 << CS22);                  // F_CPU / 64
+  OCR2A  = (F_CPU / 64 / 1000) - 1;
+  TIMSK2 = (1 << OCIE2A);
+  sei();
+}
+
+/* --------------------------------------------------
+                      tick_get
+
+     liefert den aktuellen Stand der Millisekunden-
+     Zeitbasis
+   -------------------------------------------------- */
+uint16_t tick_get(void)
+{
+  uint16_t t;
+
+  cli();
+  t= tick_ms;
+  sei();
+  return t;
+}
+
+/* --------------------------------------------------
+                      tick_fine
+
+     liefert einen fortlaufenden Zeitstempel in
+     Schritten von Timer2 (4 us bei 16 MHz). Der
+     Wert laeuft nach 65536 Schritten ueber, die
+     Differenz zweier Zeitstempel ist fuer Inter-
+     valle bis ca. 260 ms gueltig
+   -------------------------------------------------- */
+uint16_t tick_fine(void)
+{
+  uint16_t ms;
+  uint8_t  cnt;
+
+  cli();
+  ms= tick_ms;
+  cnt= TCNT2;
+  // Compare-Match bereits erfolgt, Interrupt aber noch nicht bearbeitet
+  if ((TIFR2 & (1 << OCF2A)) && (cnt < (tick_fineperms / 2))) ms++;
+  sei();
+  return (ms * tick_fineperms) + cnt;
+}
+
+/* --------------------------------------------------
+     Empfang eines Datenrahmens, Aufbau:
+
+       SOH seq adrH adrL cnt data[cnt*4] crcH crcL
+
+       seq   : laufende Rahmennummer (0..255)
+       adr   : Word-Adresse des ersten Wordpaares
+       cnt   : Anzahl Wordpaare, 0 = Ende der
+               Uebertragung
+       data  : Words im Format Hi-Byte, Lo-Byte
+       crc   : CRC16 (Polynom 0x1021, Startwert
+               0xffff) ueber seq .. data
+
+     Der Empfang erfolgt nicht blockierend ueber
+     frame_poll, so dass waehrend des Flashens eines
+     Rahmens der naechste Rahmen empfangen werden
+     kann.
+   -------------------------------------------------- */
+#define frx_sync       0                 // warten auf SOH
+#define frx_head       1                 // seq, adr, cnt
+#define frx_data       2                 // Datenbytes
+#define frx_crc        3                 // CRC
+#define frx_flush      4                 // nach Fehler: Zeichen verwerfen bis Ruhe
+#define frx_done       5                 // Rahmen fehlerfrei empfangen
+#define frx_error      6                 // Rahmen fehlerhaft
+#define frx_abort      7                 // Abbruch durch Host (CAN)
+
+uint8_t  frx_state;
+uint8_t  *frx_buf;
+uint8_t  frx_hdr[4];
+uint16_t frx_idx;
+uint16_t frx_len;
+uint16_t frx_crcsum;
+uint16_t frx_time;                       // Zeitpunkt des letzten empfangenen Zeichens
+
+/* --------------------------------------------------
+                     frame_rxstart
+
+     beginnt den Empfang eines neuen Rahmens in den
+     Puffer buf
+   -------------------------------------------------- */
+void frame_rxstart(uint8_t *buf)
+{
+  frx_buf= buf;
+  frx_state= frx_sync;
+  frx_time= tick_get();
+}
+
+/* --------------------------------------------------
+                      frame_poll
+
+     verarbeitet alle im Empfangspuffer der UART
+     vorhandenen Zeichen, kehrt sofort zurueck.
+
+     Nach einem Fehler (CRC, Timeout innerhalb eines
+     Rahmens, ungueltige Laenge) werden alle Zeichen
+     verworfen bis fuer frame_tout ms Ruhe auf der
+     Leitung ist, erst dann wird frx_error gesetzt
+     (Resynchronisation).
+   -------------------------------------------------- */
+void frame_poll(void)
+{
+  uint8_t ch;
+
+  while (uart_ischar() && (frx_state < frx_done))
+  {
+    ch= uart_getchar();
+    frx_time= tick_get();
+
+    switch (frx_state)
+    {
+      case frx_sync :
+      {
+        if (ch == frame_soh)
+        {
+          frx_crcsum= 0xffff;
+          frx_idx= 0;
+          frx_state= frx_head;
+        }
+        if (ch == frame_can) frx_state= frx_abort;
+        break;
+      }
+      case frx_head :
+      {
+        frx_hdr[frx_idx++]= ch;
+        frx_crcsum= _crc_xmodem_update(frx_crcsum, ch);
+        if (frx_idx == 4)
+        {
+          frx_idx= 0;
+          frx_len= frx_hdr[3] * 4;
+          if (frx_hdr[3] > frame_maxpairs) frx_state= frx_flush;
+          else if (frx_len) frx_state= frx_data;
+          else frx_state= frx_crc;
+        }
+        break;
+      }
+      case frx_data :
+      {
+        frx_buf[frx_idx++]= ch;
+        frx_crcsum= _crc_xmodem_update(frx_crcsum, ch);
+        if (frx_idx == frx_len)
+        {
+          frx_idx= 0;
+          frx_state= frx_crc;
+        }
+        break;
+      }
+      case frx_crc :
+      {
+        frx_crcsum= _crc_xmodem_update(frx_crcsum, ch);
+        if (++frx_idx == 2)
+        {
+          // CRC inklusive empfangener CRC muss 0 ergeben
+          if (frx_crcsum) frx_state= frx_flush; else frx_state= frx_done;
+        }
+        break;
+      }
+      default : break;                   // frx_flush: Zeichen verwerfen
+    }
+  }
+
+  if ((frx_state > frx_sync) && (frx_state < frx_done))
+  {
+    if ((uint16_t)(tick_get() - frx_time) > frame_tout)
+    {
+      if (frx_state == frx_flush) frx_state= frx_error; else frx_state= frx_flush;
+      frx_time= tick_get();
+    }
+  }
+}
+
+/* --------------------------------------------------
+                   uart_getchar_tout
+
+     wartet maximal tout Millisekunden auf ein
+     Zeichen der seriellen Schnittstelle.
+
+     Rueckgabe:
+        gelesenes Zeichen, -1 bei Timeout
+   -------------------------------------------------- */
+int16_t uart_getchar_tout(uint16_t tout)
+{
+  uint16_t t0;
+
+  t0= tick_get();
+  while (!uart_ischar())
+  {
+    if ((uint16_t)(tick_get() - t0) > tout) return -1;
+  }
+  return uart_getchar();
+}
+
+/* --------------------------------------------------
+                     baud_change
+
+     Kommando 'b': schaltet auf die Baudrate mit
+     der Kennziffer code ('0'..'3') um.
+
+     Die Umschaltung wird mit 'b' und Kennziffer
+     (noch mit der bisherigen Baudrate) bestaetigt.
+     Danach muss der Host mit der neuen Baudrate
+     ein 'U' gefolgt von baud_testlen Bytes Test-
+     muster und deren CRC16 senden. Ist das Muster
+     fehlerfrei, wird mit 'K' quittiert, ansonsten
+     wird ohne Antwort auf die Standardbaudrate
+     zurueckgeschaltet.
+
+     Rueckgabe:
+        1 : neue Baudrate aktiv
+        0 : Standardbaudrate aktiv
+   -------------------------------------------------- */
+uint8_t baud_change(uint8_t code)
+{
+  int16_t  ch;
+  uint8_t  i;
+  uint16_t crc;
+
+  if ((code < '0') || (code > '3')) return 0;
+
+  uart_putchar('b');
+  uart_putchar(code);
+  uart_setbaud(baudrates[code - '0']);
+
+  // Zeichen, die waehrend des Umschaltens eintrafen, verwerfen
+  do
+  {
+    ch= uart_getchar_tout(baud_tout);
+  } while ((ch >= 0) && (ch != 'U'));
+
+  if (ch >= 0)
+  {
+    crc= 0xffff;
+    for (i= 0; i< baud_testlen + 2; i++)
+    {
+      ch= uart_getchar_tout(frame_tout);
+      if (ch < 0) break;
+      crc= _crc_xmodem_update(crc, ch);
+    }
+    if ((ch >= 0) && (!crc))
+    {
+      uart_putchar('K');
+      return 1;
+    }
+  }
+
+  uart_setbaud(BAUDRATE);
+  return 0;
+}
+
+/* --------------------------------------------------
+                      frame_answer
+
+     sendet eine Quittung (ACK / NAK) mit der
+     zugehoerigen Rahmennummer
+   -------------------------------------------------- */
+void frame_answer(uint8_t code, uint8_t seq)
+{
+  uart_putchar(code);
+  uart_putchar(seq);
+}
+
 /* -------------------------------------------------
                     pwm_vpp_init
 
@@ -463,6 +828,75 @@ void testvoltage_set(void)
 }
 
 
+/* ------------------------------------------------
+                       tck_set
+
+     stellt den ICSP-Takt ein, half ist die Warte-
+     zeit je halbem SCK-Takt (siehe tck_default,
+     0xff = Voreinstellung), pulse die Dauer eines
+     Programmierimpulses in us (0 = Voreinstellung)
+   ------------------------------------------------ */
+void tck_set(uint8_t half, uint8_t pulse)
+{
+  if (half == 0xff) half= tck_default;
+  tck_half= half;
+  tck_read= half - (half / 3);
+  tck_hold= half / 3;
+
+  if (!pulse) pulse= wrpulse_default;
+  wr_pulse= pulse;
+  wr_loops= (uint16_t)pulse * (F_CPU / 4000000);
+}
+
+/* ------------------------------------------------
+                     gang_setmask
+
+     waehlt die Targets (Bit n = Target n), deren
+     SDA-Leitungen ab jetzt gemeinsam bedient
+     werden. Alle anderen SDA-Leitungen werden
+     Eingang.
+   ------------------------------------------------ */
+void gang_setmask(uint8_t targets)
+{
+  uint8_t t;
+
+  sda_in_init();
+  gang_act= targets;
+  gang_maskd= 0;
+  gang_maskc= 0;
+  gang_first= 0;
+  for (t= gang_max; t > 0; t--)
+  {
+    if (targets & (1 << (t-1)))
+    {
+      gang_maskd |= gang_dmask[t-1];
+      gang_maskc |= gang_cmask[t-1];
+      gang_first= t-1;
+    }
+  }
+  sda_in_init();
+}
+
+/* ------------------------------------------------
+                     gang_word
+
+     setzt das von Target t zuletzt empfangene
+     Datum aus den Bitscheiben von pfs_receiveword
+     zusammen
+   ------------------------------------------------ */
+uint16_t gang_word(uint8_t t)
+{
+  uint8_t  i;
+  uint16_t word = 0;
+
+  for (i= 0; i < rxs_len; i++)
+  {
+    word <<= 1;
+    if ((rxs_d[i] & gang_dmask[t]) || (rxs_c[i] & gang_cmask[t])) word |= 0x01;
+  }
+  return word;
+}
+
 /* ------------------------------------------------
                      pfs_init
 
@@ -504,9 +938,9 @@ void pfs_sendword(uint16_t word, uint8_t length)
     sck_clr();
     if (word & 0x8000) sda_set(); else sda_clr();
     word <<= 1;
-    _delay_us(3);
+    tck_wait(tck_half);
     sck_set();
-    _delay_us(3);
+    tck_wait(tck_half);
   }
 
   sck_clr();
@@ -519,32 +953,38 @@ void pfs_sendword(uint16_t word, uint8_t length)
 
      Liest ein Datum mit der Bitlaenge "length"
      vom Target ein
+
+     Die SDA-Leitungen aller Targets werden je Bit
+     gemeinsam als Portabbild gelesen (bitsliced),
+     gang_word() setzt daraus das Datum eines
+     einzelnen Targets zusammen. Rueckgabewert ist
+     das Datum des ersten aktiven Targets.
    ------------------------------------------------ */
 uint16_t pfs_receiveword(uint8_t length)
 {
   uint8_t  i;
-  uint16_t word = 0;
 
   for (i= 0; i < length; i++)
   {
     sck_clr();
-    _delay_us(3);
+    tck_wait(tck_half);
     sck_set();
-    _delay_us(2);
+    tck_wait(tck_read);
 
-    word <<= 1;
-    if (is_sda()) word |= 0x01;        // lesen nach dem Delay um das erste Bit zu fixen
-    _delay_us(1);
+    rxs_d[i]= PIND;                    // lesen nach dem Delay um das erste Bit zu fixen
+    rxs_c[i]= PINC;
+    tck_wait(tck_hold);
   }
+  rxs_len= length;
 
   sck_clr();
-  _delay_us(2);
+  tck_wait(tck_read);
   sck_set();                           // Lesezugriffe haben einen zusaetzlichen Taktzyklus, warum ?
-  _delay_us(2);
+  tck_wait(tck_read);
   sck_clr();
-  _delay_us(2);
+  tck_wait(tck_read);
 
-  return word;
+  return gang_word(gang_first);
 }
 
 /* ------------------------------------------------
@@ -664,12 +1104,15 @@ void pfs_erasedevice(void)
                      pfs_writewords
 
      schreibt 2 Words ins Target, Schreibmodus
-     muss aktiviert sein
+     muss aktiviert sein. Die Dauer wird fuer die
+     Zeitmessung (Kommando 's') aufsummiert
    ------------------------------------------------ */
 void pfs_writewords(uint16_t word1, uint16_t word2, uint16_t address)
 {
-  uint8_t i;
+  uint8_t  i;
+  uint16_t t0;
 
+  t0= tick_fine();
   if (address & 0x0002)                   // schreibt entweder den Upper oder Lower
                                           // Teil der Page zur gleichen Zeit
   {
@@ -699,14 +1142,583 @@ void pfs_writewords(uint16_t word1, uint16_t word2, uint16_t address)
   for (i= 0; i < 8; i++)
   {
     sck_set();
-    _delay_us(22);
+    _delay_loop_2(wr_loops);            // Programmierimpuls, Voreinstellung 22 us
     sck_clr();
-    _delay_us(22);
+    _delay_loop_2(wr_loops);
   }
   _delay_us(1);
 
   sda_in_init();
   pfs_sendword(0,1);                     // fuehrende Null senden
+
+  stat_wrsum += (uint16_t)(tick_fine() - t0);
+}
+
+
+/* ------------------------------------------------
+                     pfs_writemode
+
+     aktiviert den Schreibmodus und legt die
+     Programmierspannungen an
+   ------------------------------------------------ */
+void pfs_writemode(void)
+{
+  pfs_enterpgmmode(0xa7);                              // write mode
+
+  vdd_set(5.8);
+  delay(10);
+  vpp_set(device_vpp_write);
+  delay(10);
+}
+
+/* ------------------------------------------------
+                     pfs_verifywords
+
+     liest cnt Wordpaare ab der Word-Adresse adr
+     im Read-Mode zurueck und vergleicht sie mit
+     den Daten in buf (Format wie im Rahmen, Hi-
+     Byte zuerst, unbeschrieben = 0xffff). Nur die
+     14 Datenbits werden verglichen.
+
+     Im Gang-Betrieb wird jedes aktive Target ge-
+     prueft, ein abweichendes Target wird mit
+     Fehleradresse in gang_erradr / gang_errword
+     vermerkt und deaktiviert.
+
+     Solange noch ein Target aktiv ist, wird an-
+     schliessend wieder der Schreibmodus aktiviert.
+
+     Rueckgabe:
+        0xffff wenn noch ein Target aktiv ist,
+        sonst die Adresse der letzten Abweichung,
+        der gelesene Wert steht dann in vfy_word
+   ------------------------------------------------ */
+uint16_t vfy_word;
+
+uint16_t pfs_verifywords(uint8_t *buf, uint16_t adr, uint8_t cnt)
+{
+  uint8_t  i, t;
+  uint16_t w, soll;
+
+  vpp_set(0.02);
+  vdd_set(0.02);
+  delay(10);
+  pfs_enterpgmmode(0xa6);                              // read mode
+
+  for (i= 0; i < (cnt*2); i++)
+  {
+    pfs_readword(adr);
+    soll= ((buf[0] << 8) | buf[1]) & 0x3fff;
+    for (t= 0; t < gang_max; t++)
+    {
+      if (!(gang_act & (1 << t))) continue;
+      w= gang_word(t) & 0x3fff;
+      if (w != soll)
+      {
+        gang_erradr[t]= adr;
+        gang_errword[t]= w;
+        gang_act &= ~(1 << t);
+        vfy_word= w;
+      }
+    }
+    if (!gang_act) return adr;
+    buf += 2;
+    adr++;
+  }
+
+  gang_setmask(gang_act);                              // fehlerhafte Targets nicht mehr flashen
+  pfs_writemode();
+  return 0xffff;
+}
+
+/* ------------------------------------------------
+                     gang_idcheck
+
+     wertet die zuletzt gelesene Device-ID fuer
+     jedes konfigurierte Target aus, Targets mit
+     falscher ID werden deaktiviert.
+
+     Rueckgabe:
+        ID des ersten aktiven Targets, bzw. des
+        ersten konfigurierten, wenn keines eine
+        gueltige ID liefert
+   ------------------------------------------------ */
+uint16_t gang_idcheck(void)
+{
+  uint8_t t, act;
+
+  act= 0;
+  for (t= 0; t < gang_max; t++)
+  {
+    gang_id[t]= gang_word(t) & 0xfff;
+    gang_erradr[t]= 0xffff;
+    gang_errword[t]= 0;
+    if ((gang_cfg & (1 << t)) && (gang_id[t] == device_id)) act |= (1 << t);
+  }
+  if (act) gang_setmask(act);
+
+  return gang_id[gang_first];
+}
+
+/* ------------------------------------------------
+                     gang_report
+
+     sendet fuer jedes konfigurierte Target eine
+     Zeile "id erradr errword" an den Host,
+     erradr == ffff: kein Verify-Fehler
+   ------------------------------------------------ */
+void gang_report(void)
+{
+  uint8_t t;
+
+  for (t= 0; t < gang_max; t++)
+  {
+    if (gang_cfg & (1 << t))
+      printf("%x %x %x\r\n", gang_id[t], gang_erradr[t], gang_errword[t]);
+  }
+}
+
+/* ------------------------------------------------
+                      stat_report
+
+     sendet nach einem Programmierkommando mit ein-
+     geschalteter Zeitmessung die Dauer der einzelnen
+     Phasen in ms:
+
+       "S id erase xfer write fin"
+
+       id    : Kommando bis Device-ID gesendet
+       erase : Programmlaenge empfangen bis Target
+               geloescht und Schreibmodus aktiv
+       xfer  : Uebertragung und Flashen aller Daten
+       write : davon Summe der Schreibvorgaenge
+               (pfs_writewords)
+       fin   : Abschalten der Programmierspannungen
+   ------------------------------------------------ */
+void stat_report(void)
+{
+  uint16_t t;
+
+  t= tick_get();
+  printf("S %d %d %d %d %d\r\n", stat_tid - stat_tstart, stat_terase - stat_tlen,
+         stat_txfer - stat_terase, (uint16_t)(stat_wrsum / tick_fineperms), t - stat_txfer);
+}
+
+/* ------------------------------------------------
+                     frame_sendbyte
+
+     sendet ein Byte eines Datenrahmens und
+     aktualisiert dessen CRC
+   ------------------------------------------------ */
+void frame_sendbyte(uint8_t b, uint16_t *crc)
+{
+  uart_putchar(b);
+  *crc= _crc_xmodem_update(*crc, b);
+}
+
+/* ------------------------------------------------
+                     pfs_readframes
+
+     liest count Words ab der Word-Adresse adr aus
+     dem Target (Read-Mode muss aktiv sein) und
+     sendet diese im Rahmenformat des Kommandos 'F'
+     (max. frame_maxpairs Wordpaare je Rahmen) an
+     den Host. Die Words werden waehrend des
+     Sendens gelesen, ein Rahmenpuffer wird nicht
+     benoetigt.
+
+     Rahmen werden nicht quittiert. Bei einem
+     fehlerhaften Rahmen wiederholt der Host den
+     gesamten Lesevorgang (readretry, bis zu 3 mal).
+     Ein Rahmen mit 0 Wordpaaren beendet die
+     Uebertragung.
+   ------------------------------------------------ */
+void pfs_readframes(uint16_t adr, uint16_t count)
+{
+  uint8_t  seq, cnt, i;
+  uint16_t crc, w;
+
+  adr &= 0xfffe;                               // Wordpaare beginnen auf gerader Adresse
+  count= (count + 1) / 2;                      // Anzahl Wordpaare
+  seq= 0;
+  do
+  {
+    cnt= frame_maxpairs;
+    if (count < cnt) cnt= count;
+    if (adr > device_memend) cnt= 0;
+    else if ((adr + (cnt*2)) > (device_memend+1)) cnt= ((device_memend+1) - adr) / 2;
+
+    uart_putchar(frame_soh);
+    crc= 0xffff;
+    frame_sendbyte(seq, &crc);
+    frame_sendbyte(adr >> 8, &crc);
+    frame_sendbyte(adr & 0xff, &crc);
+    frame_sendbyte(cnt, &crc);
+    for (i= 0; i< (cnt*2); i++)
+    {
+      w= pfs_readword(adr++);
+      frame_sendbyte(w >> 8, &crc);
+      frame_sendbyte(w & 0xff, &crc);
+    }
+    w= crc;
+    uart_putchar(w >> 8);
+    uart_putchar(w & 0xff);
+
+    count -= cnt;
+    seq++;
+  } while (cnt);
+}
+
+/* ------------------------------------------------
+                     tck_pattern
+
+     Testmuster fuer die Charakterisierung: ab-
+     wechselnd 0x2aaa / 0x1555 mit einem wandernden
+     invertierten Bit
+   ------------------------------------------------ */
+uint16_t tck_pattern(uint16_t adr)
+{
+  return (((adr & 1) ? 0x1555 : 0x2aaa) ^ (1 << (adr % 14)));
+}
+
+/* ------------------------------------------------
+                      tck_test
+
+     loescht das Target, schreibt das Testmuster
+     mit dem ICSP-Takt tck und liest es mit dem
+     gleichen Takt zurueck.
+
+     Rueckgabe:
+        Anzahl fehlerhafter Words
+   ------------------------------------------------ */
+uint16_t tck_test(uint8_t tck)
+{
+  uint16_t adr, errs;
+
+  tck_set(tck, wr_pulse);
+
+  pfs_init();
+  delay(50);
+  pfs_erasedevice();
+  delay(50);
+  pfs_writemode();
+  for (adr= 0; adr < tck_testlen; adr += 2)
+  {
+    pfs_writewords(tck_pattern(adr), tck_pattern(adr+1), adr);
+  }
+
+  pfs_init();
+  vpp_set(0.02);
+  vdd_set(0.02);
+  delay(10);
+  errs= 0;
+  if (pfs_enterpgmmode(0xa6) != device_id) return tck_testlen;    // read mode
+  for (adr= 0; adr < tck_testlen; adr++)
+  {
+    if ((pfs_readword(adr) & 0x3fff) != tck_pattern(adr)) errs++;
+  }
+  return errs;
+}
+
+/* ------------------------------------------------
+                  pfs_characterize
+
+     sucht den schnellsten zuverlaessigen ICSP-
+     Takt: fuer die Werte aus tck_steps (absteigend)
+     wird je ein Testmuster geschrieben und zurueck-
+     gelesen, die Suche endet beim ersten Fehler.
+     Eingestellt wird der Wert eine Stufe ueber dem
+     schnellsten fehlerfreien (Reserve), er bleibt
+     bis zum naechsten 't' oder Reset aktiv.
+
+     Die Dauer des Programmierimpulses wird nicht
+     veraendert, ein zu kurzer Impuls laesst sich
+     durch Zuruecklesen nicht sicher erkennen.
+
+     Achtung: der Flashspeicher des Targets wird
+     geloescht !
+
+     Ausgabe an den Host:
+        0x<id>\r\n          Device-ID
+        <tck> <fehler>\r\n  je Versuch
+        =<tck>\r\n          Ergebnis
+        =none\r\n          kein Wert fehlerfrei
+   ------------------------------------------------ */
+void pfs_characterize(void)
+{
+  uint8_t  i, best;
+  uint16_t errs;
+
+  printfkomma= 3;
+  vpp_set(0.02);
+  vdd_set(0.02);
+  delay(40);
+
+  led_set();
+  tck_set(tck_default, wr_pulse);
+  pfs_init();
+  printf("0x%x\r\n", pfs_read_device_id_seq());
+
+  best= 0xff;
+  for (i= 0; i < sizeof(tck_steps); i++)
+  {
+    errs= tck_test(tck_steps[i]);
+    printf("%x %x\r\n", tck_steps[i], errs);
+    if (errs) break;
+    best= i;
+  }
+
+  if (best != 0xff)
+  {
+    if (best) best--;                    // eine Stufe Reserve
+    best= tck_steps[best];
+    tck_set(best, wr_pulse);
+  }
+  else
+  {
+    tck_set(tck_default, wr_pulse);
+  }
+
+  // Testmuster wieder loeschen
+  pfs_init();
+  delay(50);
+  pfs_erasedevice();
+
+  if (best != 0xff)
+    printf("=%x\r\n", best);
+  else
+    printf("=none\r\n");
+
+  pfs_init();
+  vpp_set(0.05);
+  vdd_set(0.03);
+  led_clr();
+}
+
+/* ------------------------------------------------
+                      pgm_start
+
+     gemeinsamer Beginn der Programmierkommandos
+     'P' und 'F': Device-ID an den Host senden,
+     Programmlaenge empfangen, Target loeschen und
+     in den Schreibmodus versetzen.
+
+     Im Gang-Betrieb folgt auf die ID-Zeile je
+     konfiguriertem Target eine Zeile (gang_report),
+     Targets ohne gueltige ID werden nicht geflasht.
+
+     Rueckgabe:
+        vom Host gesendete Programmlaenge
+   ------------------------------------------------ */
+uint16_t pgm_start(void)
+{
+  uint16_t DeviceID;
+  uint16_t proglen;
+
+  stat_tstart= tick_get();
+  stat_wrsum= 0;
+  printfkomma= 3;
+
+  vpp_set(0.02);
+  vdd_set(0.02);
+  delay(40);
+
+  pfs_init();
+
+  gang_setmask(gang_cfg);
+  pfs_read_device_id_seq();
+  DeviceID= gang_idcheck();
+  printf("0x%x\r\n", DeviceID);
+  if (gang_cfg != 0x01) gang_report();           // IDs der einzelnen Targets
+  stat_tid= tick_get();
+  proglen= uart_gethexword();
+  stat_tlen= tick_get();
+
+  led_set();
+  pfs_init();
+  delay(50);
+  pfs_erasedevice();
+  delay(50);
+
+  pfs_writemode();
+  stat_terase= tick_get();
+
+  printf("%x\r", proglen);
+
+  return proglen;
+}
+
+/* ------------------------------------------------
+                   pfs_frameprogram
+
+     empfaengt die Programmdaten im Rahmenprotokoll
+     und flasht diese.
+
+     Es werden 2 Rahmenpuffer verwendet: waehrend
+     der Inhalt des einen Puffers Wordpaar fuer
+     Wordpaar ins Target geschrieben wird, wird
+     zwischen den einzelnen Schreibvorgaengen der
+     naechste Rahmen in den anderen Puffer
+     empfangen.
+
+     Ein Rahmen wird mit ACK quittiert, sobald er
+     fehlerfrei empfangen ist und mit dessen
+     Flashen begonnen wird (der Host sendet daraufhin
+     bereits den naechsten Rahmen). Ein fehlerhafter
+     Rahmen wird mit NAK und der erwarteten Rahmen-
+     nummer beantwortet, der Host wiederholt nur
+     diesen einen Rahmen.
+
+     Ein Rahmen mit 0 Wordpaaren beendet die
+     Uebertragung, er wird erst quittiert wenn alle
+     vorhergehenden Rahmen geflasht sind.
+
+     Da jeder Rahmen seine Startadresse enthaelt,
+     kann der Host Luecken im Programm ueberspringen
+     (sparse). Wordpaare mit 0xffff / 0xffff inner-
+     halb eines Rahmens werden nicht geflasht.
+
+     Mit verify != 0 wird jeder Rahmen nach dem
+     Flashen im Read-Mode zurueckgelesen (ein Um-
+     schalten Write- / Read-Mode je Wordpaar dauert
+     zu lange). Die Pruefung erfolgt erst, wenn der
+     naechste Rahmen vollstaendig empfangen ist und
+     noch nicht quittiert wurde, der Host sendet
+     waehrenddessen also nichts. Bei einer Abwei-
+     chung wird statt einer Quittung
+
+       frame_verr adrH adrL wordH wordL
+
+     (erste fehlerhafte Adresse und gelesener Wert)
+     gesendet und sofort abgebrochen. Im Gang-Betrieb
+     wird ein fehlerhaftes Target nur deaktiviert,
+     abgebrochen wird erst, wenn kein Target mehr
+     aktiv ist.
+   ------------------------------------------------ */
+void pfs_frameprogram(uint8_t verify)
+{
+  uint8_t  *rxbuf;
+  uint8_t  *wrbuf;
+  uint8_t  *vfybuf;
+  uint8_t  seq, expseq, cnt, errcnt;
+  uint8_t  wrcnt;                              // noch zu flashende Wordpaare in wrbuf
+  uint8_t  vfycnt;                             // noch zu pruefende Wordpaare in vfybuf
+  uint16_t adr, wradr, vfyadr, w1, w2;
+
+  expseq= 0;
+  errcnt= 0;
+  wrcnt= 0;
+  vfycnt= 0;
+  vfybuf= blockmem;
+  vfyadr= 0;
+  wrbuf= blockmem;
+  rxbuf= blockmem;
+  wradr= 0;
+
+  frame_rxstart(rxbuf);
+  while (errcnt < frame_maxretry)
+  {
+    frame_poll();
+
+    if (frx_state == frx_abort) return;
+
+    if (frx_state == frx_error)
+    {
+      frame_answer(frame_nak, expseq);
+      errcnt++;
+      frame_rxstart(rxbuf);
+      continue;
+    }
+
+    // solange noch geflasht wird, zwischen jedem Wordpaar den Empfang bedienen
+    if (wrcnt)
+    {
+      w1= (wrbuf[0] << 8) | wrbuf[1];
+      w2= (wrbuf[2] << 8) | wrbuf[3];
+
+      // unbeschriebene Wordpaare sind durch das Loeschen bereits
+      // gesetzt und muessen nicht geflasht werden
+      if ((w1 != 0xffff) || (w2 != 0xffff)) pfs_writewords(w1, w2, wradr);
+      wrbuf += 4;
+      wradr += 2;
+      wrcnt--;
+      continue;
+    }
+
+    // fertig geflashten Rahmen pruefen, sobald der naechste Rahmen da ist
+    if ((vfycnt) && (frx_state == frx_done))
+    {
+      adr= pfs_verifywords(vfybuf, vfyadr, vfycnt);
+      if (adr != 0xffff)
+      {
+        uart_putchar(frame_verr);
+        uart_putchar(adr >> 8);
+        uart_putchar(adr & 0xff);
+        uart_putchar(vfy_word >> 8);
+        uart_putchar(vfy_word & 0xff);
+        return;
+      }
+      vfycnt= 0;
+    }
+
+    if (frx_state != frx_done)
+    {
+      // kein Rahmen vom Host (Host abgebrochen ?)
+      if ((frx_state == frx_sync) && ((uint16_t)(tick_get() - frx_time) > frame_idletout))
+      {
+        frame_answer(frame_nak, expseq);
+        errcnt++;
+        frame_rxstart(rxbuf);
+      }
+      continue;
+    }
+
+    // vollstaendiger Rahmen in rxbuf, der vorherige ist fertig geflasht
+    seq= frx_hdr[0];
+    adr= (frx_hdr[1] << 8) | frx_hdr[2];
+    cnt= frx_hdr[3];
+
+    // Wiederholung des zuletzt quittierten Rahmens (ACK ging verloren),
+    // nicht erneut flashen, nur quittieren
+    if (seq == (uint8_t)(expseq-1))
+    {
+      frame_answer(frame_ack, seq);
+      frame_rxstart(rxbuf);
+      continue;
+    }
+
+    if ((seq != expseq) || (adr & 0x0001) || ((adr + (cnt*2)) > (device_memend+1)))
+    {
+      frame_answer(frame_nak, expseq);
+      errcnt++;
+      frame_rxstart(rxbuf);
+      continue;
+    }
+    errcnt= 0;
+
+    if (!cnt)                                  // Ende der Uebertragung
+    {
+      frame_answer(frame_ack, seq);
+      return;
+    }
+
+    // Rahmen zum Flashen uebernehmen, quittieren und den naechsten
+    // Rahmen in den jeweils anderen Puffer empfangen
+    wrbuf= rxbuf;
+    wradr= adr;
+    wrcnt= cnt;
+    if (verify)
+    {
+      vfybuf= rxbuf;
+      vfyadr= adr;
+      vfycnt= cnt;
+    }
+    frame_answer(frame_ack, seq);
+    expseq++;
+
+    if (rxbuf == blockmem) rxbuf= blockmem + frame_bufsize; else rxbuf= blockmem;
+    frame_rxstart(rxbuf);
+  }
 }
 
 
@@ -717,14 +1729,21 @@ int main(void)
 {
   int       i;
   uint8_t   b, ch;
-  uint16_t  DeviceID;
   uint16_t  proglen;
   uint16_t  w1, w2;
   uint16_t  pc;
   uint16_t  mcx;
+  uint8_t   highbaud;
+  int16_t   rx;
+  uint8_t   setupcmd;
+
+  highbaud= 0;
+  setupcmd= 0;
 
   delay(150);
   uart_init();
+  tick_init();
+  tck_set(tck_default, wrpulse_default);
   calib_init();
 
   adc_init(3,2);
@@ -766,25 +1785,99 @@ int main(void)
     gain_vdd= eeprom_read_float((float*)eep_adr_gain_vdd);
   }
 
+  // Bereitmeldung: der Host wartet hierauf anstatt einer festen Zeit fuer
+  // Bootloader und Initialisierung. Bis hierher empfangene Zeichen (Abfragen
+  // des Hosts, Reste fuer den Bootloader) werden verworfen, danach wird das
+  // erste Kommando ohne Verwerfen angenommen, weil der Host sofort sendet
+  while (uart_ischar()) ch= uart_getchar();
+  printf("\r\n%s\r\n", ready_banner);
+  setupcmd= 1;
+
   while(1)
   {
     // eventuelle Zeichen die noch illegalerweise kommen lesen
-    // und verwerfen
-    do
+    // und verwerfen, bis 10 ms Ruhe ist. Es wird jeweils der
+    // gesamte Empfangspuffer geleert: fragt der Host die Bereit-
+    // schaft zyklisch ab (Einstellkommando 't' alle 50 ms), kaemen
+    // sonst die Zeichen schneller als sie verworfen werden.
+    // Nach den Einstellkommandos 'b', 'g', 't' und 's' folgt das
+    // naechste Kommando sofort und darf nicht verworfen werden
+    if (!setupcmd)
     {
-      if (uart_ischar()) ch= uart_getchar();
-      delay(10);
-    } while (uart_ischar());
+      do
+      {
+        while (uart_ischar()) ch= uart_getchar();
+        delay(10);
+      } while (uart_ischar());
+    }
+    setupcmd= 0;
 
 
     // auf regulaeres Kommando warten
     do
     {
-      ch= uart_getchar();
-    } while ((ch != 'P') && (ch != 'R') && (ch != 'r') && (ch != 'i'));
+      rx= uart_getchar_tout(baud_idletout);
+      if (rx < 0)
+      {
+        // nach einer Baudratenumschaltung kommt kein Kommando (Host
+        // abgebrochen ?): zurueck auf die Standardbaudrate
+        if (highbaud)
+        {
+          uart_setbaud(BAUDRATE);
+          highbaud= 0;
+        }
+        ch= 0;
+      }
+      else
+      {
+        ch= rx;
+      }
+    } while ((ch != 'P') && (ch != 'F') && (ch != 'R') && (ch != 'r') && (ch != 'i') &&
+             (ch != 'b') && (ch != 'D') && (ch != 'V') && (ch != 'g') &&
+             (ch != 't') && (ch != 'c') && (ch != 's'));
 
     switch (ch)
     {
+      // Baudrate fuer das naechste Kommando umschalten
+      case 'b' :
+      {
+        highbaud= baud_change(uart_getchar_tout(frame_tout));
+        setupcmd= 1;
+        continue;               // ohne Wartezeit und ohne Rueckschalten
+      }
+      // Targets fuer Gang-Programmierung waehlen (Bit n = Target n)
+      case 'g' :
+      {
+        gang_cfg= uart_gethex() & ((1 << gang_max)-1);
+        if (!gang_cfg) gang_cfg= 0x01;
+        gang_setmask(gang_cfg);
+        printf("%x\r", gang_cfg);
+        setupcmd= 1;
+        continue;               // Baudrate bleibt fuer das folgende Kommando
+      }
+      // ICSP-Takt und Programmierimpuls einstellen
+      case 't' :
+      {
+        b= uart_gethex();
+        tck_set(b, uart_gethex());
+        printf("%x %x\r", tck_half, wr_pulse);
+        setupcmd= 1;
+        continue;               // Baudrate bleibt fuer das folgende Kommando
+      }
+      // Zeitmessung fuer das folgende Programmierkommando ein- / ausschalten
+      case 's' :
+      {
+        stat_on= uart_gethex();
+        printf("%x\r", stat_on);
+        setupcmd= 1;
+        continue;               // Zeitmessung gilt fuer das folgende Kommando
+      }
+      // schnellsten zuverlaessigen ICSP-Takt ermitteln
+      case 'c' :
+      {
+        pfs_characterize();
+        break;
+      }
       case 'i' :
       {
         calibrate();
@@ -795,17 +1888,7 @@ int main(void)
       // Programm device
       case 'P' :
       {
-        printfkomma= 3;
-
-        vpp_set(0.02);
-        vdd_set(0.02);
-        delay(40);
-
-        pfs_init();
-
-        DeviceID= pfs_read_device_id_seq();
-        printf("0x%x\r\n", DeviceID);
-        proglen= uart_gethexword();
+        proglen= pgm_start();
         {
 
           // Anzahl Datenbloecke ermitteln
@@ -814,21 +1897,6 @@ int main(void)
           // einen Block mehr erwarten
           if (proglen % blksize) blkanz++;
 
-          led_set();
-          pfs_init();
-          delay(50);
-          pfs_erasedevice();
-          delay(50);
-
-          DeviceID= pfs_enterpgmmode(0xa7);                    // write mode
-
-          vdd_set(5.8);
-          delay(10);
-          vpp_set(device_vpp_write);
-          delay(10);
-
-          printf("%x\r", proglen);
-
           pc= 0;
           for (i= 0; i< blkanz; i++)                    // Anzahl Bloecke
           {
@@ -852,6 +1920,50 @@ int main(void)
             uart_putchar('x');
           }
         }
+        stat_txfer= tick_get();
+        gang_setmask(gang_cfg);
+
+        pfs_init();
+        vpp_set(0.05);
+        vdd_set(0.03);
+        led_clr();
+        if (stat_on) stat_report();
+        break;
+      }
+      // Programm device, Rahmenprotokoll mit CRC16 und ACK / NAK,
+      // 'V' prueft zusaetzlich jeden geflashten Rahmen
+      case 'F' :
+      case 'V' :
+      {
+        pgm_start();
+        pfs_frameprogram(ch == 'V');
+        stat_txfer= tick_get();
+        if (gang_cfg != 0x01) gang_report();        // Ergebnis je Target
+        gang_setmask(gang_cfg);
+
+        pfs_init();
+        vpp_set(0.05);
+        vdd_set(0.03);
+        led_clr();
+        if (stat_on) stat_report();
+        break;
+      }
+      // Flashspeicher des Targets auslesen
+      case 'D' :
+      {
+        pc= uart_gethexword();                 // Startadresse (Words)
+        proglen= uart_gethexword();            // Anzahl Words
+
+        printfkomma= 3;
+        vpp_set(0.02);
+        vdd_set(0.02);
+        delay(40);
+
+        led_set();
+        gang_setmask(gang_cfg);                // liest das erste konfigurierte Target
+        pfs_init();
+        printf("0x%x\r\n", pfs_enterpgmmode(0xa6));     // read mode
+        pfs_readframes(pc, proglen);
 
         pfs_init();
         vpp_set(0.05);
@@ -882,7 +1994,15 @@ int main(void)
       default : break;
 
     }
+    stat_on= 0;                 // gilt ebenfalls nur fuer ein Kommando
     delay(500);
+
+    // eine mit 'b' eingestellte Baudrate gilt nur fuer ein Kommando
+    if (highbaud)
+    {
+      uart_setbaud(BAUDRATE);
+      highbaud= 0;
+    }
   }
 
 }
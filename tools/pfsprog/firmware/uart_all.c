@@ -80,6 +80,8 @@
     #define UDRE0       UDRE
     #define UDR0        UDR
     #define RXC0        RXC
+    #define RXCIE0      RXCIE
+    #define TXC0        TXC
 
   #endif
 
@@ -497,6 +499,40 @@
             __AVR_ATmega328__ ||                                                                    \
             __AVR_ATmega8__   || __AVR_ATmega8515__
 
+  #if (rxbuf_enable == 1)
+
+    #if defined USART_RX_vect
+      #define uart_rx_vect   USART_RX_vect
+    #else
+      #define uart_rx_vect   USART_RXC_vect
+    #endif
+
+    #define rxbuf_mask       (rxbuf_size - 1)
+
+    volatile uint8_t rxbuf[rxbuf_size];
+    volatile uint8_t rxbuf_head = 0;
+    volatile uint8_t rxbuf_tail = 0;
+
+    /* --------------------------------------------------
+        Empfangsinterrupt: Zeichen in den Ringpuffer
+        schreiben. Ist der Puffer voll, wird das
+        Zeichen verworfen.
+       -------------------------------------------------- */
+    ISR (uart_rx_vect)
+    {
+      uint8_t ch, next;
+
+      ch= UDR0;
+      next= (rxbuf_head + 1) & rxbuf_mask;
+      if (next != rxbuf_tail)
+      {
+        rxbuf[rxbuf_head]= ch;
+        rxbuf_head= next;
+      }
+    }
+
+  #endif
+
   /* --------------------------------------------------
       Initialisierung der seriellen Schnittstelle:
 
@@ -531,9 +567,37 @@
     UCSR0B = (1<<RXEN0)|(1<<TXEN0);                       // Transmitter und Receiver enable
     UCSR0C = (3<<UCSZ00);                                 // 8 Datenbit, 1 Stopbit
 
+  #endif
+
+  #if (rxbuf_enable == 1)
+
+    UCSR0B |= (1<<RXCIE0);                                // Empfangsinterrupt enable
+    sei();
+
   #endif
   }
 
+  /* --------------------------------------------------
+      Baudrate zur Laufzeit umschalten (immer mit
+      doppelter Geschwindigkeit U2X, ergibt bei
+      16 MHz exakt 250000, 500000 und 1000000 Bd).
+
+      Ein noch in Ausgabe befindliches Zeichen wird
+      vor dem Umschalten vollstaendig gesendet.
+     -------------------------------------------------- */
+  void uart_setbaud(uint32_t baud)
+  {
+    uint16_t ubrr;
+
+    while (!( UCSR0A & (1<<UDRE0)));                      // Transmitterpuffer leer und
+    while (!( UCSR0A & (1<<TXC0)));                       // letztes Zeichen hinausgeschoben
+
+    ubrr= (((F_CPU / 4) / baud) - 1) / 2;                 // gerundet auf naechsten Teiler
+    UCSR0A |= 1<<U2X0;
+    UBRR0H = (uint8_t)(ubrr>>8);
+    UBRR0L = (uint8_t)ubrr;
+  }
+
   /* --------------------------------------------------
       Zeichen ueber die serielle Schnittstelle senden
      -------------------------------------------------- */
@@ -541,6 +605,7 @@
   void uart_putchar(uint8_t ch)
   {
     while (!( UCSR0A & (1<<UDRE0)));                      // warten bis Transmitterpuffer leer ist
+    UCSR0A = (UCSR0A & (1<<U2X0)) | (1<<TXC0);            // TXC loeschen (fuer uart_setbaud)
     UDR0 = ch;                                            // Zeichen senden
   }
 
@@ -551,7 +616,15 @@
 
   uint8_t uart_ischar( void )
   {
+  #if (rxbuf_enable == 1)
+
+    return (rxbuf_head != rxbuf_tail);
+
+  #else
+
     return (UCSR0A & (1<<RXC0));
+
+  #endif
   }
 
   /* --------------------------------------------------
@@ -560,20 +633,28 @@
 
   uint8_t uart_getchar( void )
   {
-    while(!(UCSR0A & (1<<RXC0)));                         // warten bis Zeichen eintrifft
+    char ch;
 
-  #if (echo_enable == 1)
+  #if (rxbuf_enable == 1)
 
-    char ch;
-    ch= UDR0;
-    uart_putchar(ch);
-    return ch;
+    while (rxbuf_head == rxbuf_tail);                     // warten bis Zeichen im Puffer
+    ch= rxbuf[rxbuf_tail];
+    rxbuf_tail= (rxbuf_tail + 1) & rxbuf_mask;
 
   #else
 
-    return UDR0;
+    while(!(UCSR0A & (1<<RXC0)));                         // warten bis Zeichen eintrifft
+    ch= UDR0;
+
+  #endif
+
+  #if (echo_enable == 1)
+
+    uart_putchar(ch);
 
   #endif
+
+    return ch;
   }
 
 /* ##########################################################
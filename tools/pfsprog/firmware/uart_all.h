@@ -59,6 +59,12 @@
   #define echo_enable     0
   #define readint_enable  1
 
+  // nur Hardware-UART: Empfang interruptgesteuert in einen Ringpuffer, so
+  // dass waehrend laengerer Aktionen des Hauptprogramms keine Zeichen ver-
+  // loren gehen
+  #define rxbuf_enable    1
+  #define rxbuf_size      256             // Zweierpotenz, maximal 256
+
   /* -----------------------------------------------------------------------
       Moegliche Baudratenkombinationen fuer ATtiny24 - 84, ATtiny25 - 85
 
@@ -81,6 +87,7 @@
                                   Prototypen
      ----------------------------------------------------------------------- */
   void uart_init(void);
+  void uart_setbaud(uint32_t baud);
   void uart_putchar(uint8_t ch);
   uint8_t uart_ischar( void );
   uint8_t uart_getchar( void );
@@ -18,12 +18,33 @@ const
   dtime_chsend    = 10;
   dtime_send      = 200;
 
+  frame_soh       = $01;                       // Beginn eines Datenrahmens
+  frame_ack       = $06;                       // Rahmen vom Programmer korrekt empfangen
+  frame_nak       = $15;                       // Rahmen fehlerhaft, wiederholen
+  frame_can       = $18;                       // Uebertragung abbrechen
+  frame_verr      = $19;                       // Verify-Fehler beim Flashen (Kommando 'V')
+  frame_maxpairs  = 64;                        // max. Anzahl Wordpaare pro Rahmen
+  frame_tout      = 1000;                      // Timeout auf Quittung in ms
+  frame_rxtout    = 50;                        // Zeichentimeout im Rahmen (Firmware) in ms
+  frame_maxretry  = 10;                        // max. Wiederholungen eines Rahmens
+
+  baud_testlen    = 32;                        // Testmuster nach Baudratenumschaltung
+
+  device_words    = $800;                      // Groesse Flashspeicher PFS154 in Words
+  gang_max        = 7;                         // max. Anzahl Targets (Gang-Programmierung)
+
+  // Baudraten des Kommandos 'b', Index = Kennziffer '0'..'3'. 250000 Bd
+  // ist mit synaser nicht einstellbar und wird nicht verwendet
+  baudrates       : array[0..3] of longint = (115200, 250000, 500000, 1000000);
+
 var
 
   sport       : string;
   sparity     : char;
   sdbit,ssbit : byte;
   sbaud       : longint;
+  maxbaud     : longint;                       // hoechste auszuhandelnde Baudrate
+  curbaud     : longint;                       // aktuell ausgehandelte Baudrate
   ser         : tblockserial;
   portname    : string;
 
@@ -32,6 +53,26 @@ var
 
   nowait      : boolean;
   withpbar    : boolean;
+  legacy      : boolean;
+  sparse      : boolean;                       // unbeschriebene Wordpaare nicht senden
+  doverify    : boolean;                       // nach dem Flashen verifizieren
+  verifyfail  : boolean;                       // Programmer hat Verify-Fehler gemeldet
+  verifyadr   : word;                          // erste fehlerhafte Adresse (Words)
+  verifyword  : word;                          // dort gelesener Wert
+  gang        : byte;                          // Anzahl gleichzeitig geflashter Targets
+  gangid      : array[0..gang_max-1] of word;  // Device-ID je Target
+  gangerradr  : array[0..gang_max-1] of word;  // erste Verify-Fehleradresse, $ffff = ok
+  gangerrword : array[0..gang_max-1] of word;  // dort gelesener Wert
+  tck         : byte;                          // ICSP-Takt, $ff = Voreinstellung Firmware
+  wrpulse     : byte;                          // Programmierimpuls in us, 0 = Voreinstellung
+  dostats     : boolean;                       // Zeitmessung der Programmierphasen
+
+  // Zeitmessung (Option stats): Zeitpunkte in ms (gettickcount64) und
+  // Anzahl der waehrend der Uebertragung gesendeten / empfangenen Bytes
+  st_open, st_ready, st_cmd,
+  st_id, st_erase, st_xfer    : qword;
+  st_wire     : longint;
+  st_words    : word;
 
 type
   mcumem = array[0..4096] of byte;
@@ -39,8 +80,11 @@ type
 var
   flashmem    : mcumem;                        // in diesem Array wird ein Speicherabbild
                                                // wie es spaeter im Target geflasht ist
+  readmem     : mcumem;                        // aus dem Target gelesenes Speicherabbild
+                                               // (gleiches Format wie flashmem)
 
   maxadr      : word;
+  frameresent : word;                          // Anzahl wiederholter Rahmen
 
   blksize     : word = 500;
   blkanz      : byte;
@@ -468,6 +512,1015 @@ begin
 end;
 
 
+{ -------------------------------------------------------------
+                         crc16_update
+
+    berechnet eine CRC16 (Polynom $1021) fortlaufend ueber
+    ein Byte (identisch zu _crc_xmodem_update der avr-libc)
+  ------------------------------------------------------------- }
+function crc16_update(crc : word; b : byte) : word;
+var
+  i : byte;
+begin
+  crc:= crc xor (word(b) shl 8);
+  for i:= 1 to 8 do
+  begin
+    if ((crc and $8000) <> 0) then
+      crc:= word((crc shl 1) xor $1021)
+    else
+      crc:= word(crc shl 1);
+  end;
+  crc16_update:= crc;
+end;
+
+{ -------------------------------------------------------------
+                           sendframe
+
+    sendet einen Datenrahmen des Rahmenprotokolls
+    (Kommando 'F'):
+
+      SOH seq adrH adrL cnt data[cnt*4] crcH crcL
+
+    adr ist die Word-Adresse des ersten Wordpaares, cnt die
+    Anzahl der Wordpaare (0 = Ende der Uebertragung). Die
+    Datenbytes werden dem Speicherabbild flashmem ab der
+    Byteadresse adr*2 entnommen. Die CRC wird ueber seq bis
+    einschliesslich des letzten Datenbytes gebildet.
+  ------------------------------------------------------------- }
+procedure sendframe(seq : byte; adr : word; cnt : byte);
+var
+  frame : array[0..(frame_maxpairs*4)+6] of byte;
+  crc   : word;
+  i, n  : word;
+begin
+  frame[0]:= frame_soh;
+  frame[1]:= seq;
+  frame[2]:= hi(adr);
+  frame[3]:= lo(adr);
+  frame[4]:= cnt;
+  n:= 5;
+  i:= 0;
+  while (i < (cnt*4)) do
+  begin
+    frame[n]:= flashmem[(adr*2)+i];
+    inc(n);
+    inc(i);
+  end;
+
+  crc:= $ffff;
+  for i:= 1 to n-1 do crc:= crc16_update(crc, frame[i]);
+  frame[n]:= hi(crc);
+  frame[n+1]:= lo(crc);
+
+  ser.sendbuffer(@frame[0], n+2);
+  st_wire:= st_wire + n + 2;
+end;
+
+{ -------------------------------------------------------------
+                          frameanswer
+
+    liest die Quittung des Programmers auf einen Rahmen.
+
+    Rueckgabe:
+      frame_ack oder frame_nak, 0 bei Timeout
+      seq enthaelt die vom Programmer gesendete Rahmennummer
+
+      frame_verr wenn der Programmer beim Zuruecklesen eine
+      Abweichung festgestellt hat, Adresse und gelesener Wert
+      stehen dann in verifyadr und verifyword
+  ------------------------------------------------------------- }
+function frameanswer(var seq : byte) : byte;
+var
+  code : byte;
+  buf  : array[0..3] of byte;
+begin
+  frameanswer:= 0;
+  code:= ser.recvbyte(frame_tout);
+  if (ser.lasterror <> 0) then exit;
+
+  if (code = frame_verr) then
+  begin
+    if (ser.recvbufferex(@buf[0], 4, frame_tout) <> 4) then exit;
+    verifyadr:= (word(buf[0]) shl 8) or buf[1];
+    verifyword:= (word(buf[2]) shl 8) or buf[3];
+    verifyfail:= true;
+    frameanswer:= code;
+    exit;
+  end;
+
+  seq:= ser.recvbyte(frame_tout);
+  if (ser.lasterror <> 0) then exit;
+  st_wire:= st_wire + 2;
+  frameanswer:= code;
+end;
+
+{ -------------------------------------------------------------
+                           pairblank
+
+    liefert true, wenn das Wordpaar p (Byteadresse p*4) im
+    Speicherabbild flashmem unbeschrieben ist (alle 4 Bytes
+    $ff)
+  ------------------------------------------------------------- }
+function pairblank(p : word) : boolean;
+begin
+  pairblank:= (flashmem[p*4]   = $ff) and (flashmem[(p*4)+1] = $ff) and
+              (flashmem[(p*4)+2] = $ff) and (flashmem[(p*4)+3] = $ff);
+end;
+
+{ -------------------------------------------------------------
+                           nextframe
+
+    ermittelt ab dem Wordpaar p den naechsten zu sendenden
+    Rahmen (maximal frame_maxpairs Wordpaare).
+
+    Im sparse-Modus werden unbeschriebene Wordpaare ueber-
+    sprungen: p zeigt danach auf das erste beschriebene
+    Wordpaar, cnt ist die Laenge des zusammenhaengenden
+    Laufs beschriebener Wordpaare ab p.
+
+    cnt = 0 wenn bis zum Wordpaar pairs keine Daten mehr zu
+    senden sind.
+  ------------------------------------------------------------- }
+procedure nextframe(pairs : word; var p : word; var cnt : byte);
+begin
+  if sparse then
+    while ((p < pairs) and pairblank(p)) do inc(p);
+
+  cnt:= 0;
+  while (((p + cnt) < pairs) and (cnt < frame_maxpairs)) do
+  begin
+    if (sparse and pairblank(p + cnt)) then break;
+    inc(cnt);
+  end;
+end;
+
+{ -------------------------------------------------------------
+                          usedwords
+
+    liefert die Anzahl der Words in den beschriebenen
+    Wordpaaren des Speicherabbildes bis Byteadresse maxadr
+  ------------------------------------------------------------- }
+function usedwords : word;
+var
+  p, n, pairs : word;
+begin
+  pairs:= (maxadr + 3) div 4;
+  if (pairs > 1024) then pairs:= 1024;
+  n:= 0; p:= 0;
+  while (p < pairs) do
+  begin
+    if not(pairblank(p)) then n:= n + 2;
+    inc(p);
+  end;
+  usedwords:= n;
+end;
+
+{ -------------------------------------------------------------
+                            trybaud
+
+    versucht, Host und Programmer auf die Baudrate mit dem
+    Index idx umzuschalten: nach der Bestaetigung durch den
+    Programmer wird mit der neuen Baudrate ein Testmuster
+    gesendet, das der Programmer mit 'K' quittiert.
+
+    Schlaegt dieses fehl, schalten beide auf die Standard-
+    baudrate zurueck.
+  ------------------------------------------------------------- }
+function trybaud(idx : byte) : boolean;
+var
+  test   : array[0..baud_testlen+2] of byte;
+  b1, b2 : byte;
+  crc    : word;
+  i      : word;
+begin
+  trybaud:= false;
+  clr_inpuffer;
+
+  ser.sendbyte(ord('b'));
+  ser.sendbyte(ord('0') + idx);
+  b1:= ser.recvbyte(300);
+  if (ser.lasterror <> 0) then exit;           // Firmware ohne Baudratenumschaltung
+  b2:= ser.recvbyte(100);
+  if (ser.lasterror <> 0) or (b1 <> ord('b')) or (b2 <> ord('0') + idx) then exit;
+
+  ser.config(baudrates[idx],sdbit,sparity,ssbit,false,false);
+  sleep(5);
+
+  test[0]:= ord('U');
+  crc:= $ffff;
+  for i:= 1 to baud_testlen do
+  begin
+    test[i]:= byte((i * 37) xor $a5);
+    crc:= crc16_update(crc, test[i]);
+  end;
+  test[baud_testlen+1]:= hi(crc);
+  test[baud_testlen+2]:= lo(crc);
+  ser.sendbuffer(@test[0], baud_testlen+3);
+
+  b1:= ser.recvbyte(300);
+  if (ser.lasterror = 0) and (b1 = ord('K')) then
+  begin
+    trybaud:= true;
+    exit;
+  end;
+
+  // fehlgeschlagen: der Programmer schaltet nach seinem Timeout
+  // ebenfalls auf die Standardbaudrate zurueck
+  ser.config(sbaud,sdbit,sparity,ssbit,false,false);
+  sleep(400);
+  clr_inpuffer;
+end;
+
+{ -------------------------------------------------------------
+                         negotiatebaud
+
+    handelt die hoechste Baudrate bis maxbaud aus, die die
+    Verbindung (USB-Seriell Bridge) fehlerfrei uebertraegt.
+    Die Baudrate gilt fuer das naechste Kommando.
+
+    Rueckgabe: ausgehandelte Baudrate
+  ------------------------------------------------------------- }
+function negotiatebaud : longint;
+var
+  idx : integer;
+begin
+  negotiatebaud:= sbaud;
+  for idx:= 3 downto 2 do
+  begin
+    if (baudrates[idx] > maxbaud) then continue;
+    if trybaud(idx) then
+    begin
+      negotiatebaud:= baudrates[idx];
+      exit;
+    end;
+  end;
+end;
+
+{ -------------------------------------------------------------
+                          framecancel
+
+    bricht eine Uebertragung im Rahmenprotokoll ab und
+    schaltet auf die Standardbaudrate zurueck
+
+    CAN wertet der Programmer nur zwischen zwei Rahmen aus.
+    Steckt er noch in einem unvollstaendigen Rahmen, verwirft
+    er diesen erst nach frame_rxtout ms ohne Zeichen und
+    weiteren frame_rxtout ms Ruhe, vorher gesendete CAN
+    gingen als Rahmendaten verloren.
+  ------------------------------------------------------------- }
+procedure framecancel;
+var
+  i : byte;
+begin
+  sleep(3 * frame_rxtout);
+  clr_inpuffer;
+  for i:= 1 to 3 do ser.sendbyte(frame_can);
+  sleep(800);                                  // Programmer beendet das Kommando
+  ser.config(sbaud,sdbit,sparity,ssbit,false,false);
+  curbaud:= sbaud;
+  clr_inpuffer;
+end;
+
+{ -------------------------------------------------------------
+                          frameupload
+
+    uebertraegt das Speicherabbild flashmem bis zur Byte-
+    adresse maxadr im Rahmenprotokoll. Ein nicht oder mit
+    NAK quittierter Rahmen wird (nur dieser) wiederholt.
+
+    Der Programmer quittiert einen Rahmen sobald er mit dem
+    Flashen beginnt und empfaengt den naechsten Rahmen
+    waehrend des Flashens (Doppelpufferung). Der Endrahmen
+    wird erst nach dem Flashen aller Rahmen quittiert.
+
+    Im sparse-Modus werden nur die Laeufe beschriebener
+    Wordpaare (Adresse, Laenge) gesendet, Luecken im Speicher-
+    abbild (bspw. vor den Kalibrierwords am Ende des Flash-
+    speichers) werden uebersprungen.
+
+    Rueckgabe:
+      true bei Erfolg, false wenn ein Rahmen auch nach
+      frame_maxretry Versuchen nicht quittiert wurde
+  ------------------------------------------------------------- }
+function frameupload(startzeit : comp) : boolean;
+var
+  pairs, p       : word;
+  fanz, fnr      : word;
+  cnt, seq, aseq : byte;
+  code, retry    : byte;
+begin
+  frameupload:= false;
+  frameresent:= 0;
+  verifyfail:= false;
+  st_wire:= 0;
+  st_words:= 0;
+
+  pairs:= (maxadr + 3) div 4;                        // Anzahl Wordpaare im Speicherabbild
+  if (pairs > 1024) then pairs:= 1024;
+
+  // Anzahl Rahmen (inkl. Endrahmen) fuer die Progressbar ermitteln
+  fanz:= 1; p:= 0;
+  repeat
+    nextframe(pairs, p, cnt);
+    p:= p + cnt;
+    if (cnt > 0) then inc(fanz);
+  until (cnt = 0);
+
+  p:= 0; seq:= 0; fnr:= 0;
+  repeat
+    nextframe(pairs, p, cnt);
+    if (cnt = 0) then p:= 0;                         // Endrahmen
+
+    retry:= 0;
+    repeat
+      sendframe(seq, p*2, cnt);
+      code:= frameanswer(aseq);
+      if ((code = frame_ack) and (aseq = seq)) then break;
+      if (code = frame_verr) then exit;
+      inc(retry);
+      inc(frameresent);
+      clr_inpuffer;
+    until (retry = frame_maxretry);
+    if (retry = frame_maxretry) then exit;
+
+    inc(seq);
+    p:= p + cnt;
+    st_words:= st_words + (cnt*2);
+    inc(fnr);
+
+    // Progressbar
+    if withpbar= true then txpbar(startzeit, fanz, fnr, '#', 50);
+  until (cnt = 0);
+
+  frameupload:= true;
+end;
+
+
+{ -------------------------------------------------------------
+                          sendhexword
+
+    sendet einen 16-Bit Wert als 4 Hexziffern (ohne die
+    Wartezeit von uart_sendword16)
+  ------------------------------------------------------------- }
+procedure sendhexword(val16 : word);
+begin
+  ser.sendstring(word2hex(val16));
+end;
+
+{ -------------------------------------------------------------
+                          hexfield
+
+    entnimmt s das erste durch Leerzeichen getrennte Feld
+    und liefert dessen Wert als Hexzahl. Der Programmer
+    gibt Werte mit my_printf ("%x") aus, Werte bis 0xff
+    haben dabei nur 2 Ziffern, deshalb werden die Felder
+    nicht an festen Spalten gelesen.
+  ------------------------------------------------------------- }
+function hexfield(var s : string) : word;
+var
+  p   : byte;
+  v   : word;
+  err : word;
+begin
+  s:= trimleft(s);
+  p:= pos(' ', s);
+  if (p = 0) then p:= length(s) + 1;
+  val('$'+copy(s, 1, p-1), v, err);
+  if (err <> 0) then v:= 0;
+  delete(s, 1, p);
+  hexfield:= v;
+end;
+
+{ -------------------------------------------------------------
+                           cmdfinish
+
+    wartet, bis der Programmer ein Kommando abgeschlossen
+    hat und schaltet wieder auf die Standardbaudrate
+  ------------------------------------------------------------- }
+procedure cmdfinish;
+begin
+  sleep(600);
+  if (curbaud <> sbaud) then
+  begin
+    ser.config(sbaud,sdbit,sparity,ssbit,false,false);
+    curbaud:= sbaud;
+  end;
+  clr_inpuffer;
+end;
+
+{ -------------------------------------------------------------
+                           waitready
+
+    wartet nach dem Oeffnen der Schnittstelle, bis die Firm-
+    ware Kommandos annimmt: nach einem Reset des AVR meldet
+    sie sich mit "PFSPROG READY". Wurde der AVR nicht zurueck-
+    gesetzt, antwortet sie auf das alle 50 ms gesendete Ein-
+    stellkommando 't' (Voreinstellung ICSP-Takt).
+
+    Eine aeltere Firmware antwortet nicht, dann wird nach
+    tout ms (der bisherigen festen Wartezeit) fortgefahren.
+
+    Rueckgabe:
+      true, wenn der Programmer sich gemeldet hat
+  ------------------------------------------------------------- }
+function waitready(tout : word) : boolean;
+var
+  t0 : qword;
+  s  : string;
+begin
+  waitready:= false;
+  t0:= gettickcount64;
+  repeat
+    ser.sendstring('tff00');
+    s:= ser.recvTerminated(50, chr(13));
+    if (ser.lasterror = 0) then
+    begin
+      sleep(20);                               // Rest der Meldung, weitere Antworten
+      clr_inpuffer;
+      waitready:= true;
+      exit;
+    end;
+  until ((gettickcount64 - t0) >= tout);
+  clr_inpuffer;
+end;
+
+{ -------------------------------------------------------------
+                           sendsetup
+
+    stellt im Programmer die Anzahl Targets (Kommando 'g')
+    und den ICSP-Takt (Kommando 't') ein. Wird vor jedem
+    Kommando des Rahmenprotokolls gesendet, damit Einstel-
+    lungen eines frueheren Aufrufs nicht stehen bleiben.
+
+    Rueckgabe:
+      true, wenn der Programmer beide Einstellungen
+      bestaetigt hat
+  ------------------------------------------------------------- }
+function sendsetup : boolean;
+var
+  recstring : string;
+begin
+  sendsetup:= false;
+
+  ser.sendbyte(ord('g'));
+  ser.sendstring(byte2hex((1 shl gang) - 1));
+  if (uart_getstring(recstring, 13) > 0) then exit;
+
+  ser.sendbyte(ord('t'));
+  ser.sendstring(byte2hex(tck) + byte2hex(wrpulse));
+  if (uart_getstring(recstring, 13) > 0) then exit;
+
+  sendsetup:= true;
+end;
+
+{ -------------------------------------------------------------
+                          characterize
+
+    laesst den Programmer den schnellsten zuverlaessigen
+    ICSP-Takt ermitteln (Kommando 'c') und gibt das Ergeb-
+    nis aus. Der Flashspeicher des Targets wird dabei
+    geloescht.
+  ------------------------------------------------------------- }
+procedure characterize;
+var
+  s         : string;
+  v, errs   : word;
+  err       : word;
+begin
+  clr_inpuffer;
+  if not(sendsetup) then
+  begin
+    writeln('communication error...');
+    ser.free;
+    halt;
+  end;
+
+  ser.sendbyte(ord('c'));
+  s:= trim(ser.recvTerminated(1000, chr(13)));
+  if (s <> '0x0AA1') then
+  begin
+    writeln('Unknown ID: ', s);
+    writeln('Programm terminated...');
+    ser.free;
+    halt;
+  end;
+  writeln(' ID: 0x0aa1 found, PFS154 present...');
+  writeln(' Characterizing ICSP timing (flash of target will be erased)...');
+  writeln;
+
+  repeat
+    s:= trim(ser.recvTerminated(2000, chr(13)));
+    if (ser.lasterror <> 0) then
+    begin
+      writeln('communication error...');
+      ser.free;
+      halt;
+    end;
+    if (copy(s, 1, 1) <> '=') then
+    begin
+      v:= hexfield(s);
+      errs:= hexfield(s);
+      if (errs = 0) then
+        writeln('   tck=', v:3, ' : OK')
+      else
+        writeln('   tck=', v:3, ' : ', errs, ' words failed');
+    end;
+  until (copy(s, 1, 1) = '=');
+
+  // "=<tck>" bzw. "=none", wenn kein Wert fehlerfrei war (aeltere
+  // Firmware: "=ff")
+  val('$'+copy(s, 2, 4), v, err);
+  writeln;
+  if ((err <> 0) or (v = $ff)) then
+    writeln(' No reliable timing found, check the fixture')
+  else
+    writeln(' Recommended setting (one step margin): tck=', v);
+  writeln;
+end;
+
+{ -------------------------------------------------------------
+                           recvframe
+
+    empfaengt einen Datenrahmen (Format wie beim Kommando
+    'F') vom Programmer und traegt die Daten ab der Byte-
+    adresse adr*2 in readmem ein.
+
+    Rueckgabe:
+      0 : fehlerfrei, 1 : Timeout, 2 : CRC / Formatfehler
+  ------------------------------------------------------------- }
+function recvframe(var seq : byte; var adr : word; var cnt : byte) : byte;
+var
+  hdr  : array[0..3] of byte;
+  buf  : array[0..(frame_maxpairs*4)+1] of byte;
+  crc  : word;
+  i, n : word;
+  b    : byte;
+begin
+  recvframe:= 1;
+
+  // auf Rahmenbeginn warten
+  repeat
+    b:= ser.recvbyte(frame_tout);
+    if (ser.lasterror <> 0) then exit;
+  until (b = frame_soh);
+
+  if (ser.recvbufferex(@hdr[0], 4, frame_tout) <> 4) then exit;
+  seq:= hdr[0];
+  adr:= (word(hdr[1]) shl 8) or hdr[2];
+  cnt:= hdr[3];
+
+  recvframe:= 2;
+  if (cnt > frame_maxpairs) then exit;
+
+  n:= (cnt*4) + 2;
+  if (ser.recvbufferex(@buf[0], n, frame_tout) <> n) then
+  begin
+    recvframe:= 1;
+    exit;
+  end;
+
+  crc:= $ffff;
+  for i:= 0 to 3 do crc:= crc16_update(crc, hdr[i]);
+  for i:= 0 to n-1 do crc:= crc16_update(crc, buf[i]);
+  if (crc <> 0) then exit;
+
+  i:= 0;
+  while (i < (cnt*4)) do
+  begin
+    if (((adr*2)+i) <= 4096) then readmem[(adr*2)+i]:= buf[i];
+    inc(i);
+  end;
+  recvframe:= 0;
+end;
+
+{ -------------------------------------------------------------
+                          readdevice
+
+    liest words Words ab der Word-Adresse startadr aus dem
+    Target (Kommando 'D') nach readmem
+
+    Rueckgabe:
+      true bei Erfolg
+  ------------------------------------------------------------- }
+function readdevice(startadr, words : word) : boolean;
+var
+  recstring     : string;
+  seq, expseq   : byte;
+  cnt           : byte;
+  adr           : word;
+  err           : word;
+begin
+  readdevice:= false;
+  clr_inpuffer;
+
+  curbaud:= sbaud;
+  if (maxbaud > sbaud) then curbaud:= negotiatebaud;
+  if not(sendsetup) then exit;
+
+  ser.sendbyte(10);
+  recstring:= ser.recvTerminated(200, chr(13));
+  ser.sendbyte(ord('D'));
+  sendhexword(startadr);
+  sendhexword(words);
+
+  err:= uart_getstring(recstring, 13);
+  if (err > 0) then exit;
+  if (recstring <> '0x0AA1') then
+  begin
+    writeln('Unknown ID: ', recstring);
+    exit;
+  end;
+
+  expseq:= 0;
+  repeat
+    if (recvframe(seq, adr, cnt) <> 0) then exit;
+    if (seq <> expseq) then exit;
+    inc(expseq);
+  until (cnt = 0);
+
+  readdevice:= true;
+end;
+
+{ -------------------------------------------------------------
+                          readretry
+
+    liest den Flashspeicher des Targets nach readmem, bei
+    einem Uebertragungsfehler wird der Lesevorgang bis zu
+    3 mal wiederholt.
+  ------------------------------------------------------------- }
+function readretry(startadr, words : word) : boolean;
+var
+  i : word;
+  n : byte;
+begin
+  for i:= 0 to 4096 do readmem[i]:= $ff;
+
+  readretry:= true;
+  for n:= 1 to 3 do
+  begin
+    if readdevice(startadr, words) then
+    begin
+      cmdfinish;
+      exit;
+    end;
+    writeln(' read error, retrying...');
+    sleep(1000);                               // Programmer sendet evtl. noch
+    cmdfinish;
+  end;
+  readretry:= false;
+end;
+
+{ -------------------------------------------------------------
+                          verifyimage
+
+    vergleicht die ersten words Words von flashmem und
+    readmem (14 Bit Words, unbeschrieben = $3fff) und gibt
+    die ersten 10 Abweichungen aus.
+
+    Rueckgabe: Anzahl abweichender Words
+  ------------------------------------------------------------- }
+function verifyimage(words : word) : word;
+var
+  w, soll, ist, errs : word;
+begin
+  errs:= 0;
+  w:= 0;
+  while (w < words) do
+  begin
+    soll:= ((word(flashmem[w*2]) shl 8) or flashmem[(w*2)+1]) and $3fff;
+    ist:= ((word(readmem[w*2]) shl 8) or readmem[(w*2)+1]) and $3fff;
+    if (soll <> ist) then
+    begin
+      if (errs < 10) then
+        writeln(' Verify error at 0x', word2hex(w), ': expected 0x', word2hex(soll),
+                ', read 0x', word2hex(ist));
+      inc(errs);
+    end;
+    inc(w);
+  end;
+  verifyimage:= errs;
+end;
+
+{ -------------------------------------------------------------
+                           verifyrun
+
+    liest das Target bis zur hoechsten Adresse der Hexdatei
+    und vergleicht es mit dem Speicherabbild. Bei Abwei-
+    chungen wird das Programm mit Exitcode 1 beendet.
+  ------------------------------------------------------------- }
+procedure verifyrun;
+var
+  words, errs : word;
+begin
+  words:= (maxadr + 1) div 2;
+  if (words > device_words) then words:= device_words;
+
+  writeln(' Verifying ', words, ' words...');
+  if not(readretry(0, words)) then
+  begin
+    writeln('communication error while reading...');
+    ser.free;
+    halt(1);
+  end;
+
+  errs:= verifyimage(words);
+  if (errs > 0) then
+  begin
+    writeln(' Verify FAILED, ', errs, ' words differ');
+    ser.free;
+    halt(1);
+  end;
+  writeln(' Verify OK');
+end;
+
+{ -------------------------------------------------------------
+                          writehexfile
+
+    schreibt die ersten words Words von readmem als Intel-
+    Hexdatei (16 Datenbytes je Zeile, Lo-Byte zuerst).
+    Zeilen, die nur unbeschriebene Words ($3fff) enthalten,
+    werden nicht geschrieben.
+  ------------------------------------------------------------- }
+procedure writehexfile(datnam : string; words : word);
+var
+  f      : text;
+  adr, i : word;
+  sum, b : byte;
+  line   : string;
+  blank  : boolean;
+begin
+  assign(f, datnam);
+  {$i-} rewrite(f); {$i+}
+  if (ioresult <> 0) then
+  begin
+    writeln('Error: cannot create file ', datnam);
+    exit;
+  end;
+
+  adr:= 0;
+  while (adr < (words*2)) do
+  begin
+    blank:= true;
+    for i:= 0 to 7 do
+      if ((((word(readmem[adr+(i*2)]) shl 8) or readmem[adr+(i*2)+1]) and $3fff) <> $3fff) then
+        blank:= false;
+
+    if not(blank) then
+    begin
+      line:= ':10' + word2hex(adr) + '00';
+      sum:= byte($10 + hi(adr) + lo(adr));
+      for i:= 0 to 7 do
+      begin
+        b:= readmem[adr+(i*2)+1];
+        line:= line + byte2hex(b);
+        sum:= byte(sum + b);
+        b:= readmem[adr+(i*2)];
+        line:= line + byte2hex(b);
+        sum:= byte(sum + b);
+      end;
+      line:= line + byte2hex(byte(256 - sum));
+      writeln(f, line);
+    end;
+    adr:= adr + 16;
+  end;
+  writeln(f, ':00000001FF');
+  close(f);
+end;
+
+{ -------------------------------------------------------------
+                           gangread
+
+    liest fuer jedes Target eine Statuszeile des Programmers
+    ("id erradr errword", jeweils 4 Hexziffern)
+
+    Rueckgabe:
+      true bei Erfolg, false bei Timeout
+  ------------------------------------------------------------- }
+function gangread : boolean;
+var
+  t   : byte;
+  s   : string;
+begin
+  gangread:= false;
+  for t:= 0 to gang-1 do
+  begin
+    if (uart_getstring(s, 13) > 0) then exit;
+    gangid[t]:= hexfield(s);
+    gangerradr[t]:= hexfield(s);
+    gangerrword[t]:= hexfield(s);
+  end;
+  gangread:= true;
+end;
+
+{ -------------------------------------------------------------
+                          gangresult
+
+    liest nach dem Flashen den Status aller Targets und gibt
+    ihn aus.
+
+    Rueckgabe:
+      Anzahl fehlerhafter Targets
+  ------------------------------------------------------------- }
+function gangresult : byte;
+var
+  t, fails : byte;
+begin
+  if not(gangread) then
+  begin
+    writeln('communication error, no target status...');
+    gangresult:= gang;
+    exit;
+  end;
+
+  fails:= 0;
+  for t:= 0 to gang-1 do
+  begin
+    write(' Target ', t, ': ID 0x', word2hex(gangid[t]), '  ');
+    if (gangid[t] <> $0aa1) then
+    begin
+      writeln('no device');
+      inc(fails);
+    end else
+    if (gangerradr[t] <> $ffff) then
+    begin
+      writeln('verify error at 0x', word2hex(gangerradr[t]), ', read 0x', word2hex(gangerrword[t]));
+      inc(fails);
+    end else
+      writeln('OK');
+  end;
+  gangresult:= fails;
+end;
+
+{ -------------------------------------------------------------
+                           statprint
+
+    liest nach dem Flashen die Zeitmessung des Programmers
+    ("S id erase xfer write fin", ms) und gibt sie zusammen
+    mit den auf dem Host gemessenen Zeiten sowie dem Durch-
+    satz der Uebertragung aus
+  ------------------------------------------------------------- }
+procedure statprint;
+var
+  s      : string;
+  fw     : array[0..4] of word;
+  i, p   : byte;
+  err    : word;
+  st_end : qword;
+  xfer   : qword;
+begin
+  if ((uart_getstring(s, 13) > 0) or (copy(s, 1, 2) <> 'S ')) then
+  begin
+    writeln(' no timing statistics from programmer...');
+    writeln;
+    exit;
+  end;
+  st_end:= gettickcount64;
+
+  for i:= 0 to 4 do
+  begin
+    delete(s, 1, pos(' ', s));
+    p:= pos(' ', s);
+    if (p = 0) then p:= length(s) + 1;
+    val(copy(s, 1, p-1), fw[i], err);
+  end;
+
+  xfer:= st_xfer - st_erase;
+  if (xfer < 1) then xfer:= 1;
+
+  writeln(' Timing                     host   programmer');
+  writeln('   port open / wait   : ', (st_ready - st_open):6, ' ms');
+  writeln('   device ID          : ', (st_id - st_cmd):6, ' ms  ', fw[0]:6, ' ms');
+  writeln('   erase              : ', (st_erase - st_id):6, ' ms  ', fw[1]:6, ' ms');
+  writeln('   transfer           : ', xfer:6, ' ms  ', fw[2]:6, ' ms');
+  writeln('     flash write      :            ', fw[3]:6, ' ms');
+  writeln('   finalize           : ', (st_end - st_xfer):6, ' ms  ', fw[4]:6, ' ms');
+  writeln('   total              : ', (st_end - st_open):6, ' ms');
+  writeln;
+  writeln(' Words: ', st_words, ', ', (qword(st_words) * 1000) div xfer, ' words/s');
+  writeln(' Wire : ', st_wire, ' bytes, ', (qword(st_wire) * 1000) div xfer, ' bytes/s at ', curbaud, ' baud');
+  writeln;
+end;
+
+{ -------------------------------------------------------------
+                            pgmstart
+
+    beginnt einen Programmiervorgang: Device-ID des Targets
+    pruefen, Programmlaenge senden und deren Echo pruefen
+    (der Programmer loescht daraufhin das Target). Bei einem
+    Fehler wird das Programm beendet.
+  ------------------------------------------------------------- }
+procedure pgmstart;
+var
+  recstring : string;
+  err       : word;
+  dummyw    : word;
+  i         : byte;
+begin
+  clr_inpuffer;
+
+  // schnellste Baudrate aushandeln (nur Rahmenprotokoll)
+  curbaud:= sbaud;
+  if (not(legacy) and (maxbaud > sbaud)) then
+  begin
+    curbaud:= negotiatebaud;
+    if (curbaud > sbaud) then writeln(' Baudrate: ', curbaud);
+  end;
+
+  // Anzahl Targets und ICSP-Takt einstellen
+  if not(legacy) then
+  begin
+    if not(sendsetup) then
+    begin
+      writeln('communication error...');
+      ser.free;
+      halt;
+    end;
+  end;
+
+  ser.sendbyte(10);
+  // eventuelle "Reste" im seriellen Puffer
+  recstring:= ser.recvTerminated(200, chr(13));
+
+  // Zeitmessung fuer das folgende Kommando einschalten
+  if dostats then
+  begin
+    ser.sendstring('s01');
+    if ((uart_getstring(recstring, 13) > 0) or (recstring <> '01')) then
+    begin
+      writeln('programmer does not support timing statistics...');
+      ser.free;
+      halt;
+    end;
+  end;
+
+  st_cmd:= gettickcount64;
+  if legacy then
+    ser.sendbyte(ord('P'))
+  else
+  if doverify then
+    ser.sendbyte(ord('V'))                     // Rahmenprotokoll mit Verify beim Flashen
+  else
+    ser.sendbyte(ord('F'));
+  err:= uart_getstring(recstring, 13);
+  st_id:= gettickcount64;
+  if err> 0 then
+  begin
+    writeln('communication error...');
+    ser.free;
+    halt;
+  end else
+  begin
+    if recstring= '0x0AA1' then
+    begin
+      writeln(' ID: 0x0aa1 found, PFS154 present...');
+      if (gang > 1) then
+      begin
+        if not(gangread) then
+        begin
+          writeln('communication error...');
+          ser.free;
+          halt;
+        end;
+        for i:= 0 to gang-1 do
+        begin
+          if (gangid[i] = $0aa1) then
+            writeln('   Target ', i, ': ID 0x', word2hex(gangid[i]))
+          else
+            writeln('   Target ', i, ': ID 0x', word2hex(gangid[i]), ' (no device, skipped)');
+        end;
+      end;
+    end else
+    begin
+      writeln('Unknown ID: ', recstring);
+      writeln('Programm terminated...');
+      ser.free;
+      halt;
+    end;
+  end;
+  writeln(' Words to flash: ', maxadr div 2);
+  if (sparse and not(legacy)) then
+    writeln(' Non-blank words: ', usedwords);
+  writeln;
+  uart_sendword16(maxadr);
+  err:= uart_getstring(recstring, 13);
+  st_erase:= gettickcount64;
+  if err> 0 then
+  begin
+    writeln('communication error...');
+    ser.free;
+    halt;
+  end;
+  recstring:= '$'+recstring;
+  val(recstring, dummyw, err);
+  if (dummyw<> maxadr) then
+  begin
+    writeln('wrong answer from programmer, expected: ',maxadr, ' but get: ',dummyw);
+    writeln('Programm terminated...');
+    halt;
+  end;
+end;
+
+
 { ---------------------------------------------------------------
                            Main - Program
   --------------------------------------------------------------- }
@@ -476,6 +1529,7 @@ var
   b            : byte;
   ch           : char;
   runmcu       : boolean;
+  uploadok     : boolean;
   err, errcnt  : word;
   dummyw       : word;
   w1, w2,
@@ -486,15 +1540,19 @@ var
 begin
   runmcu:= false;
   if (paramcount= 2) then
-    if (paramstr(1) = 'run') then
+    if (paramstr(1) = 'run') or (paramstr(1) = 'char') then
       runmcu:= true;
   if ((paramcount< 3) and not(runmcu)) then
   begin
     writeln('Syntax:');
-    writeln('pfsprog action port filename [nowait]'); writeln();
+    writeln('pfsprog action port filename [nowait] [legacy] [full] [verify] [gang=n]');
+    writeln('        [tck=n] [wrpulse=n] [maxbaud=n] [stats]'); writeln();
     writeln('  action    : wr    = upload (write) file to mcu');
     writeln('              txwr  = upload (write) file to mcu (with bargraph)');
-//    writeln('              rd  = read (download) MCU to file');
+    writeln('              rd    = read (download) MCU to file');
+    writeln('              verify= compare MCU with file');
+    writeln('              char  = find fastest reliable ICSP timing');
+    writeln('                      (erases the MCU, no filename needed)');
     writeln('              run   = run the microcontroller');
     writeln('              stop  = stop a running program');
     writeln('  port      : port were this adapter is connected to');
@@ -502,6 +1560,20 @@ begin
     writeln('  nowait    : optional parameter: don'+chr(39)+'delay programstart');
     writeln('              You can use this option if you have');
     writeln('              a programmer WITHOUT a bootloader');
+    writeln('  legacy    : optional parameter: upload with the old');
+    writeln('              block protocol (no CRC, no retransmit)');
+    writeln('  full      : optional parameter: send blank (erased)');
+    writeln('              words too, default is to skip them');
+    writeln('  verify    : optional parameter: verify after writing');
+    writeln('  gang=n    : optional parameter: program n targets (1..7) at');
+    writeln('              the same time');
+    writeln('  tck=n     : optional parameter: ICSP half clock period');
+    writeln('              (value from action char)');
+    writeln('  wrpulse=n : optional parameter: programming pulse in us');
+    writeln('  maxbaud=n : optional parameter: highest baudrate to');
+    writeln('              negotiate (500000, 1000000), 115200 = off');
+    writeln('  stats     : optional parameter: time spent in each phase');
+    writeln('              of flashing and effective throughput');
     writeln();
     writeln('  Example   : pfsprog txwr /dev/ttyUSB0 helloworld.ihx nowait');
     writeln();
@@ -513,11 +1585,35 @@ begin
   filename:= paramstr(3);
 
   portname:= paramstr(2);
-  if (paramcount= 4) then
-    if (paramstr(4)= 'nowait') then
-      nowait:= true
-    else
-      nowait:= false;
+  nowait:= false;
+  legacy:= false;
+  sparse:= true;
+  doverify:= false;
+  gang:= 1;
+  tck:= $ff;
+  wrpulse:= 0;
+  dostats:= false;
+  maxbaud:= baudrates[3];
+  for i:= 4 to paramcount do
+  begin
+    if (copy(paramstr(i),1,8)= 'maxbaud=') then
+      val(copy(paramstr(i),9,10), maxbaud, err);
+    if (paramstr(i)= 'nowait') then nowait:= true;
+    if (paramstr(i)= 'legacy') then legacy:= true;
+    if (paramstr(i)= 'full') then sparse:= false;
+    if (paramstr(i)= 'verify') then doverify:= true;
+    if (paramstr(i)= 'stats') or (paramstr(i)= '--stats') then dostats:= true;
+    if (copy(paramstr(i),1,4)= 'tck=') then
+      val(copy(paramstr(i),5,10), tck, err);
+    if (copy(paramstr(i),1,8)= 'wrpulse=') then
+      val(copy(paramstr(i),9,10), wrpulse, err);
+    if (copy(paramstr(i),1,5)= 'gang=') then
+    begin
+      val(copy(paramstr(i),6,10), gang, err);
+      if ((gang < 1) or (gang > gang_max)) then gang:= 1;
+    end;
+  end;
+  if legacy then gang:= 1;                     // das Blockprotokoll kennt kein 'g'
 
   if (paramstr(1) = 'run') and (paramstr(3) = 'nowait') then nowait:= true;
   if (paramstr(1) = 'stop') and (paramstr(3) = 'nowait') then nowait:= true;
@@ -528,6 +1624,7 @@ begin
   sparity:= 'N';
   sport:= portname;
 
+  st_open:= gettickcount64;
   ser:= tblockserial.create;
   ser.raiseExcept:= false;
   ser.linuxlock:= false;
@@ -535,17 +1632,21 @@ begin
   ser.config(sbaud,sdbit,sparity,ssbit,false,false);
 
   writeln(' waiting for programmer...');
-  if (nowait= false) then 
+  if (nowait= false) then
   begin
-    sleep(3200);
+    waitready(3200);
   end else
   begin
-    sleep(300);
-  end;  
+    waitready(300);
+  end;
+  st_ready:= gettickcount64;
   writeln;
 
   clr_inpuffer;
   case paramstr(1) of
+    'char': begin
+              characterize;
+            end;
     'run' : begin
               ser.sendbyte(ord('R'));
               writeln('PFS - Controller is running...');
@@ -564,83 +1665,103 @@ begin
 
               converthexfile(filename);
 
-              clr_inpuffer;
-
-              ser.sendbyte(10);
-              // eventuelle "Reste" im seriellen Puffer
-              recstring:= ser.recvTerminated(200, chr(13));
-              ser.sendbyte(ord('P'));
-              err:= uart_getstring(recstring, 13);
-              if err> 0 then
-              begin
-                writeln('communication error...');
-                ser.free;
-                halt;
-              end else
-              begin
-                if recstring= '0x0AA1' then
-                begin
-                  writeln(' ID: 0x0aa1 found, PFS154 present...');
-                end else
-                begin
-                  writeln('Unknown ID: ', recstring);
-                  writeln('Programm terminated...');
-                  ser.free;
-                  halt;
-                end;
-              end;
-              writeln(' Words to flash: ', maxadr div 2);
-              writeln;
-              uart_sendword16(maxadr);
-              err:= uart_getstring(recstring, 13);
-              if err> 0 then
-              begin
-                writeln('communication error...');
-                ser.free;
-                halt;
-              end;
-              recstring:= '$'+recstring;
-              val(recstring, dummyw, err);
-              if (dummyw<> maxadr) then
-              begin
-                writeln('wrong answer from programmer, expected: ',maxadr, ' but get: ',dummyw);
-                writeln('Programm terminated...');
-                halt;
-              end;
+              pgmstart;
 
              ts:= DateTimeToTimeStamp(Now);
              lz:= TimeStampToMSecs(ts);
 
-              // Anzahl Datenbytebloecke ermitteln
-              blkanz:= maxadr div blksize;
-              if ((maxadr mod blksize)<> 0) then blkanz:= blkanz+1;
-
               if withpbar= true then txpbarscala(50);
 
-              mcx:= 0;                        // Memory counter
-              for i:= 1 to blkanz do
+              if not(legacy) then
               begin
-                for cnt:= 1 to blksize do
+                uploadok:= frameupload(lz);
+
+                // bei Uebertragungsfehlern mit hoher Baudrate den Vorgang
+                // mit der Standardbaudrate wiederholen
+                if (not(uploadok) and not(verifyfail) and (curbaud > sbaud)) then
                 begin
-                  b:= flashmem[mcx];
-                  inc(mcx);
-                  ser.sendbyte(b);
-//                  sleep(dtime_chsend);
+                  writeln;
+                  writeln(' transfer errors at ', curbaud, ' baud, retrying with ', sbaud, ' baud...');
+                  framecancel;
+                  maxbaud:= sbaud;
+                  pgmstart;
+                  if withpbar= true then txpbarscala(50);
+                  uploadok:= frameupload(lz);
                 end;
-                sleep(dtime_send);
-                sleep(dtime_send);
+                st_xfer:= gettickcount64;
 
-                ch:= chr(ser.recvbyte(1));
-                if (ch<> 'x') then
+                if (verifyfail and (gang > 1)) then
                 begin
-                  writeln('communication error...');
+                  writeln;
+                  writeln(' Verify FAILED on all targets');
+                  gangresult;
                   ser.free;
-                  halt;
+                  halt(1);
                 end;
 
-                // Progressbar
-                if withpbar= true then txpbar(lz,blkanz, i, '#', 50);
+                if verifyfail then
+                begin
+                  writeln;
+                  writeln(' Verify FAILED at 0x', word2hex(verifyadr), ': expected 0x',
+                          word2hex(((word(flashmem[verifyadr*2]) shl 8) or flashmem[(verifyadr*2)+1]) and $3fff),
+                          ', read 0x', word2hex(verifyword));
+                  writeln(' Programming aborted');
+                  ser.free;
+                  halt(1);
+                end;
+
+                if not(uploadok) then
+                begin
+                  writeln;
+                  writeln('communication error, frame not acknowledged...');
+                  framecancel;
+                  ser.free;
+                  halt(1);
+                end;
 
+                if (gang > 1) then
+                begin
+                  writeln;
+                  if (gangresult > 0) then
+                  begin
+                    ser.free;
+                    halt(1);
+                  end;
+                end;
+              end else
+              begin
+                // Anzahl Datenbytebloecke ermitteln
+                blkanz:= maxadr div blksize;
+                if ((maxadr mod blksize)<> 0) then blkanz:= blkanz+1;
+                st_words:= maxadr div 2;
+                st_wire:= longint(blkanz) * (blksize + 1);
+
+                mcx:= 0;                        // Memory counter
+                for i:= 1 to blkanz do
+                begin
+                  for cnt:= 1 to blksize do
+                  begin
+                    b:= flashmem[mcx];
+                    inc(mcx);
+                    ser.sendbyte(b);
+//                    sleep(dtime_chsend);
+                  end;
+                  sleep(dtime_send);
+                  sleep(dtime_send);
+
+                  ch:= chr(ser.recvbyte(1));
+                  if (ch<> 'x') then
+                  begin
+                    writeln('communication error...');
+                    ser.free;
+                    halt;
+                  end;
+
+                  // Progressbar
+                  if withpbar= true then txpbar(lz,blkanz, i, '#', 50);
+
+                end;
+                st_xfer:= gettickcount64;
               end;
 
               if withpbar= true then
@@ -655,12 +1776,39 @@ begin
                 lz2:= TimeStampToMSecs(ts);
                 writeln (' All is done, used time: ',((lz2 - lz) / 1000):3:2,'s  ');
               end;
+              if (frameresent > 0) then
+                writeln(' Frames resent: ', frameresent);
               writeln('');
+              if dostats then statprint;
+
+              // beim Rahmenprotokoll hat der Programmer bereits beim Flashen
+              // verifiziert, das alte Blockprotokoll kennt kein 'V'
+              if (doverify and legacy) then
+              begin
+                cmdfinish;
+                verifyrun;
+                writeln('');
+              end;
             end;
-{*
+
     'rd'  : begin
+              if not(readretry(0, device_words)) then
+              begin
+                writeln('communication error while reading...');
+                ser.free;
+                halt(1);
+              end;
+              writehexfile(filename, device_words);
+              writeln(' Flash read to file ', filename);
+              writeln('');
+            end;
+
+    'verify' :
+            begin
+              converthexfile(filename);
+              verifyrun;
+              writeln('');
             end;
-*}
   end;
 
   ser.free;
@@ -6,6 +6,12 @@
       aus und ermittelt den Speicherbedarf im Flashspeicher
       des Controllers.
 
+      Mit dem Parameter "report" wird zusaetzlich der Bedarf
+      an Flash (Words) und RAM (Bytes) je Modul (Projekt-
+      datei, src/xxx.c, Bibliothek) und je Funktion / Variable
+      aus den von SDCC erzeugten .lk, .sym und .map Dateien
+      ermittelt und als Tabelle bzw. JSON ausgegeben.
+
       Compiler: GCC
 
       16.11.2020
@@ -20,7 +26,14 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-#define mcuanz       6
+#include "ihex.h"
+
+#define mcuanz       9
+#define hexmem_size  0x4000              // ausgewerteter Adressbereich der Hexdatei (Bytes)
+
+#define rep_maxmod   64                  // Report: max. Anzahl Module
+#define rep_maxsym   1024                // Report: max. Anzahl Symbole
+#define rep_maxarea  32                  // Report: max. Anzahl Areas je Modul
 
 struct mcudefs
 {
@@ -36,44 +49,13 @@ struct mcudefs mculib [mcuanz] =
   "PFS173",     0x1800,   256,
   "PMS152",     0x0a00,    80,
   "PMS154",     0x1000,   128,
-  "PMS171",     0x0c00,    96
+  "PMS171",     0x0c00,    96,
+  // Bezeichnungen wie in pdk/device.h
+  "PMS154B",    0x1000,   128,
+  "PMS154C",    0x1000,   128,
+  "PMS171B",    0x0c00,    96
 };
 
-/* ----------------------------------------------------------
-                              strdel
-
-     loescht eine Anzahl n Zeichen aus dem String s ab der
-     Position pos (inklusive des Zeichens an pos)
-     Erstes Zeichen hat Postion (pos) = 1 (und nicht 0) !!!
-   ----------------------------------------------------------*/
-char *strdel(char *s, int pos, int n)
-{
-  pos--;
-  if (pos> strlen(s)) return s;
-  if ((pos+n) > strlen(s))
-  {
-    n= strlen(s)-pos;
-  }
-  memmove(s+pos, s+pos+n, strlen(s)-pos-n+1);
-  return s;
-}
-
-/* ----------------------------------------------------------
-                              strspos
-
-     sucht den String srcstr nach dem Substring substr ab
-     und liefert die erste Position an der der Substring
-     enthalten ist (0 bei Nichtvorhandensein)
-   ----------------------------------------------------------*/
-int strspos(char *srcstr, char *substr)
-// liefert 0 zurueck, wenn Teilstring nicht vorhanden
-{
-  char *p;
-  p= strstr(srcstr, substr);
-  if ((p-srcstr+1)> strlen(srcstr)) return 0;
-  return (p-srcstr+1);
-}
-
 /* ----------------------------------------------------------
                               strcpos
 
@@ -155,82 +137,33 @@ char existfile(char *dname)
 /* --------------------------------------------------
                        readhexfile
 
-     liest Intel-Hexdatei und stellt die hoechste
-     verwendete Seicheradresse fest.
+     liest die Intel-Hexdatei mit dem gemeinsamen
+     Loader (../ihex) und stellt die hoechste ver-
+     wendete Speicheradresse fest. Die Configuration
+     Words (ab Byteadresse 0x4000) liegen ausserhalb
+     des Abbilds und werden nicht mitgezaehlt.
 
      dname  :        zu lesende Datei auf Massenspeicher
+
+     Rueckgabe:
+        hoechste belegte Byteadresse + 1, bzw. der
+        negative Fehlercode von ihex_load
    -------------------------------------------------- */
 int readhexfile(char* dname)
 {
-  FILE     *tdat;
-  char     tx[256], cpybuffer[256];
-  int      zeil;
-  int      b, b2, banz;
-  uint8_t  codbyte, cb;
-  int      fadress, highestadr;
-
-
-  zeil= 0;
-  tdat= fopen(dname,"r");
-  if (tdat== 0)
+  static uint16_t words[hexmem_size / 2];
+  ihex_image      img;
+  int             err;
+
+  img.words= words;
+  img.wordcnt= hexmem_size / 2;
+  err= ihex_load(dname, &img);
+  if (err)
   {
-//    printf("\n\r%s: no such file\n\r",dname);
-    return 1;
+    if (img.errline) printf("\n   %s, line %u\n\n", ihex_errstr(err), img.errline);
+    return -err;
   }
-
-  b= 0;
-  highestadr= 0;
-  do
-  {
-    fgets(tx,255,tdat);
-
-    do                                 // CR entfernen
-    {
-      b= strcpos(tx,0x0d);
-      if (b) strdel(tx,b,1);
-    } while (b);
-    do                                 // LF entfernen
-    {
-      b= strcpos(tx,0x0a);
-      if (b) strdel(tx,b,1);
-    } while (b);
-
-//    printf("\n%s",tx);
-
-    // Hier jede gelesene Zeile der Hexdatei interpretieren und die hoechste
-    // und niedrigste Speicheradresse speichern
-    if (tx[0]== ':')                   // korrekter Beginn einer Hexzeile ?
-    {
-      strcopy(tx,cpybuffer,8,2);
-      if (!(strcmp(cpybuffer,"00")))   // wenn es normale Datenbytes sind...
-      {                                // ... diese auswerten
-        zeil++;
-
-        strcopy(tx,cpybuffer,2,2);                // Anzahl Datenbytes in dieser Zeile
-        banz= strtol(cpybuffer,0,16);             // hexstring to longint, Basis 16 (Hex)
-
-        strcopy(tx,cpybuffer,4,4);                // Speicheradresse der Datenbytes dieser Zeile
-        fadress= strtol(cpybuffer,0,16);
-
-        for (b= 0; b< banz; b++)
-        {
-          codbyte= strtol(cpybuffer,0,16);
-          fadress++;
-
-          // die Configuration Words fuer hoechste Programmadresse ignorieren
-          if (!( ((fadress >= 0x400e) && (fadress <= 0x4012))   ||
-                 ((fadress >= 0x10010) && (fadress <= 0x10014))    ))
-          {
-            if (fadress> highestadr) highestadr= fadress;
-          }
-        }
-      }
-    }
-
-  }while (!feof(tdat));
-  fclose(tdat);
-
-  return highestadr;
+  return img.maxadr;
 }
 
 /* --------------------------------------------------
@@ -282,6 +215,413 @@ int mapfile_parse(char* dname)
 }
 
 
+/* ---------------------------------------------------------------------------
+                 Report: Speicherbedarf je Modul und je Symbol
+
+     Quellen (von SDCC beim Uebersetzen und Linken erzeugt):
+
+       projekt.lk   : Linkerskript, enthaelt alle gelinkten .rel Dateien
+                      (Projektdatei und die Module aus ../src)
+       modul.sym    : Symboltabelle des Assemblers je Modul. Die
+                      "Area Table" enthaelt den Bedarf des Moduls je
+                      Area, die Symboltabelle die Offsets aller Symbole
+                      (auch statischer Funktionen) in ihrer Area
+       projekt.map  : Map des Linkers, hieraus werden die globalen
+                      Symbole der Bibliotheksmodule (pdk14.lib etc.)
+                      mit ihren Adressen gelesen
+
+     Groessen in den .sym / .map Dateien sind Bytes, im Flash belegt
+     ein Word 2 Bytes.
+   --------------------------------------------------------------------------- */
+
+struct repmodule
+{
+  char     name[64];
+  int      flash;                        // Bytes im Flash
+  int      ram;                          // Bytes im RAM
+  char     fromsym;                      // aus .sym ermittelt (sonst .map)
+};
+
+struct repsymbol
+{
+  char     name[64];
+  int      module;                       // Index in repmod
+  int      area;                         // 0 : Flash, 1 : RAM
+  int      size;                         // Bytes
+};
+
+struct repmodule repmod[rep_maxmod];
+struct repsymbol repsym[rep_maxsym];
+int    repmodanz = 0;
+int    repsymanz = 0;
+char   repsort = 's';                    // 's' : nach Groesse, 'n' : nach Name
+
+/* --------------------------------------------------
+                       area_class
+
+     ordnet eine Area von SDCC (pdk) dem Flash oder
+     dem RAM zu
+
+     Rueckgabe:
+        0 : Flash, 1 : RAM, -1 : weder noch (ABS etc.)
+   -------------------------------------------------- */
+int area_class(char *name)
+{
+  static const char *flashareas[] = { "CODE", "HOME", "GSINIT", "GSFINAL", "CONST",
+                                      "HEADER", "INITIALIZER", "CABS", 0 };
+  static const char *ramareas[]   = { "DATA", "OSEG", "SSEG", "PREG", "RSEG0", "RSEG",
+                                      "INITIALIZED", "IDATA", 0 };
+  int i;
+
+  if (*name == '_') name++;
+  for (i= 0; flashareas[i]; i++) if (!strcmp(name, flashareas[i])) return 0;
+  for (i= 0; ramareas[i]; i++) if (!strcmp(name, ramareas[i])) return 1;
+  return -1;
+}
+
+/* --------------------------------------------------
+                        rep_addsym
+
+     traegt ein Symbol mit size Bytes ein, ein
+     fuehrender Unterstrich (C-Name) wird entfernt
+   -------------------------------------------------- */
+void rep_addsym(char *name, int module, int area, int size)
+{
+  struct repsymbol *sym;
+
+  if ((repsymanz >= rep_maxsym) || (size <= 0)) return;
+  sym= &repsym[repsymanz++];
+  if (*name == '_') name++;
+  snprintf(sym->name, sizeof(sym->name), "%s", name);
+  sym->module= module;
+  sym->area= area;
+  sym->size= size;
+}
+
+/* --------------------------------------------------
+                        symfile_parse
+
+     liest die Symboltabelle eines Moduls (.sym):
+     Bedarf je Area aus der "Area Table", Groesse
+     eines Symbols = Abstand zum naechsten Symbol
+     der gleichen Area bzw. zum Ende der Area
+
+     Rueckgabe:
+        0 : fehlerfrei, 1 : Datei nicht vorhanden
+   -------------------------------------------------- */
+int symfile_parse(char *dname, int module)
+{
+  FILE  *tdat;
+  char  tx[512], *field, *next;
+  char  name[64], val[32], flags[16], aname[64];
+  int   radix, section, idx, n, i, j;
+  long  v;
+  int   areasize[rep_maxarea], areacls[rep_maxarea];
+  int   symanz;
+  long  symoff[rep_maxsym];
+  int   symarea[rep_maxsym];
+  char  symname[rep_maxsym][64];
+
+  tdat= fopen(dname, "r");
+  if (!tdat) return 1;
+
+  for (i= 0; i < rep_maxarea; i++) { areasize[i]= 0; areacls[i]= -1; }
+  radix= 16;
+  section= 0;                            // 1 : Symbol Table, 2 : Area Table
+  symanz= 0;
+
+  while (fgets(tx, sizeof(tx), tdat))
+  {
+    if (strstr(tx, "Octal")) radix= 8;
+    if (strstr(tx, "Decimal")) radix= 10;
+    if (strstr(tx, "Symbol Table")) { section= 1; continue; }
+    if (strstr(tx, "Area Table")) { section= 2; continue; }
+
+    if (section == 1)
+    {
+      // mehrere Symbole je Zeile sind durch '|' getrennt:
+      //   "  2 _main      000000 GR  |     _putchar   ****** GX"
+      field= tx;
+      while (field)
+      {
+        next= strchr(field, '|');
+        if (next) *next++= 0;
+        for (j= 0; field[j]; j++) if (field[j] == '=') field[j]= ' ';
+        n= sscanf(field, "%d %63s %31s %15s", &idx, name, val, flags);
+        if ((n == 4) && (idx >= 0) && (idx < rep_maxarea) && (strchr(flags, 'R')) &&
+            (!strchr(flags, 'X')) && (symanz < rep_maxsym) && (name[0] != '.'))
+        {
+          symoff[symanz]= strtol(val, 0, radix);
+          symarea[symanz]= idx;
+          snprintf(symname[symanz], 64, "%s", name);
+          symanz++;
+        }
+        field= next;
+      }
+    }
+    if (section == 2)
+    {
+      //   "   1 DATA             size        2   flags    0"
+      if ((sscanf(tx, "%d %63s size %31s", &idx, aname, val) == 3) &&
+          (idx >= 0) && (idx < rep_maxarea))
+      {
+        areasize[idx]= strtol(val, 0, radix);
+        areacls[idx]= area_class(aname);
+      }
+    }
+  }
+  fclose(tdat);
+
+  for (i= 0; i < rep_maxarea; i++)
+  {
+    if (areacls[i] == 0) repmod[module].flash += areasize[i];
+    if (areacls[i] == 1) repmod[module].ram += areasize[i];
+  }
+  repmod[module].fromsym= 1;
+
+  // Symbolgroessen: naechstes Symbol der gleichen Area
+  for (i= 0; i < symanz; i++)
+  {
+    if (areacls[symarea[i]] < 0) continue;
+    v= areasize[symarea[i]];
+    for (j= 0; j < symanz; j++)
+    {
+      if ((symarea[j] == symarea[i]) && (symoff[j] > symoff[i]) && (symoff[j] < v)) v= symoff[j];
+    }
+    rep_addsym(symname[i], module, areacls[symarea[i]], v - symoff[i]);
+  }
+  return 0;
+}
+
+/* --------------------------------------------------
+                       rep_findmod
+
+     liefert den Index des Moduls name, legt es bei
+     Bedarf an (-1 wenn kein Platz mehr)
+   -------------------------------------------------- */
+int rep_findmod(char *name)
+{
+  int i;
+
+  for (i= 0; i < repmodanz; i++)
+    if (!strcmp(repmod[i].name, name)) return i;
+  if (repmodanz >= rep_maxmod) return -1;
+  snprintf(repmod[repmodanz].name, sizeof(repmod[0].name), "%s", name);
+  repmod[repmodanz].flash= 0;
+  repmod[repmodanz].ram= 0;
+  repmod[repmodanz].fromsym= 0;
+  return repmodanz++;
+}
+
+/* --------------------------------------------------
+                        lkfile_parse
+
+     liest die Module aus dem Linkerskript (.lk) und
+     deren Symboltabellen (.sym im gleichen Verzeich-
+     nis wie die .rel Datei)
+
+     Rueckgabe:
+        Anzahl gelesener Module
+   -------------------------------------------------- */
+int lkfile_parse(char *dname)
+{
+  FILE *tdat;
+  char tx[512], symname[512 + 4], *p, *base;     // symname: tx + ".sym"
+  int  anz, m;
+
+  tdat= fopen(dname, "r");
+  if (!tdat) return 0;
+
+  anz= 0;
+  while (fgets(tx, sizeof(tx), tdat))
+  {
+    tx[strcspn(tx, "\r\n")]= 0;
+    p= strstr(tx, ".rel");
+    if ((tx[0] == '-') || (!p) || (p[4])) continue;
+
+    *p= 0;
+    base= strrchr(tx, '/');
+    base= base ? base + 1 : tx;
+    m= rep_findmod(base);
+    if (m < 0) break;
+    snprintf(symname, sizeof(symname), "%s.sym", tx);
+    if (!symfile_parse(symname, m)) anz++;
+  }
+  fclose(tdat);
+  return anz;
+}
+
+/* --------------------------------------------------
+                     mapfile_symbols
+
+     liest aus der Map des Linkers die globalen
+     Symbole der Module, fuer die keine .sym Datei
+     vorliegt (Bibliothek). Groesse eines Symbols =
+     Abstand zur naechsten Adresse in der Area.
+
+       "CODE      00000046    000001CA =   458. bytes (REL,CON)"
+       "     000000A4  __divuint                          _divuint"
+   -------------------------------------------------- */
+void mapfile_symbols(char *dname)
+{
+  FILE  *tdat;
+  char  tx[512], aname[64], name[64], modname[64];
+  long  astart, asize, adr;
+  int   acls, i, j, m, anz;
+  long  symadr[rep_maxsym];
+  char  symname[rep_maxsym][64];
+  int   symmod[rep_maxsym];
+  long  v;
+
+  tdat= fopen(dname, "r");
+  if (!tdat) return;
+
+  acls= -1;
+  astart= 0; asize= 0; anz= 0;
+  while (1)
+  {
+    if (!fgets(tx, sizeof(tx), tdat)) tx[0]= 0;
+
+    // neue Area oder Dateiende: Symbole der vorherigen Area auswerten
+    if ((!tx[0]) || ((sscanf(tx, "%63s %lx %lx =", aname, &astart, &asize) == 3) &&
+                     isalpha((unsigned char)tx[0])))
+    {
+      for (i= 0; i < anz; i++)
+      {
+        if (repmod[symmod[i]].fromsym) continue;
+        v= astart + asize;
+        for (j= 0; j < anz; j++)
+          if ((symadr[j] > symadr[i]) && (symadr[j] < v)) v= symadr[j];
+        rep_addsym(symname[i], symmod[i], acls, v - symadr[i]);
+        repmod[symmod[i]].flash += (acls == 0) ? v - symadr[i] : 0;
+        repmod[symmod[i]].ram += (acls == 1) ? v - symadr[i] : 0;
+      }
+      anz= 0;
+      if (!tx[0]) break;
+      acls= area_class(aname);
+      continue;
+    }
+
+    if ((acls >= 0) && (anz < rep_maxsym) &&
+        (sscanf(tx, " %lx %63s %63s", &adr, name, modname) == 3) && (name[0] == '_'))
+    {
+      m= rep_findmod(modname);
+      if (m < 0) continue;
+      symadr[anz]= adr;
+      snprintf(symname[anz], 64, "%s", name);
+      symmod[anz]= m;
+      anz++;
+    }
+  }
+  fclose(tdat);
+}
+
+/* --------------------------------------------------
+                      rep_cmpmod / rep_cmpsym
+
+     Sortierung fuer qsort: nach Flashbedarf (dann
+     RAM) absteigend oder nach Name
+   -------------------------------------------------- */
+int rep_cmpmod(const void *a, const void *b)
+{
+  const struct repmodule *ma = a, *mb = b;
+
+  if (repsort == 'n') return strcmp(ma->name, mb->name);
+  if (mb->flash != ma->flash) return mb->flash - ma->flash;
+  return mb->ram - ma->ram;
+}
+
+int rep_cmpsym(const void *a, const void *b)
+{
+  const struct repsymbol *sa = a, *sb = b;
+
+  if (sa->area != sb->area) return sa->area - sb->area;
+  if (repsort == 'n') return strcmp(sa->name, sb->name);
+  return sb->size - sa->size;
+}
+
+/* --------------------------------------------------
+                        rep_print
+
+     gibt die Tabellen je Modul und je Symbol aus,
+     flashbytes ist der Gesamtbedarf laut Hexdatei
+   -------------------------------------------------- */
+void rep_print(int flashbytes, int flashsize)
+{
+  int i, sum, m;
+  struct repmodule sorted[rep_maxmod];
+
+  // Symbole verweisen auf den Modulindex, daher eine sortierte Kopie
+  for (i= 0; i < repmodanz; i++) sorted[i]= repmod[i];
+  qsort(sorted, repmodanz, sizeof(struct repmodule), rep_cmpmod);
+  qsort(repsym, repsymanz, sizeof(struct repsymbol), rep_cmpsym);
+
+  fprintf(stderr, "\nModule                              Flash [words]       Ram [bytes]\n");
+  fprintf(stderr, "----------------------------------  ------------------  -----------\n");
+  sum= 0;
+  for (i= 0; i < repmodanz; i++)
+  {
+    if ((!sorted[i].flash) && (!sorted[i].ram)) continue;
+    fprintf(stderr, "%-34s  %6d", sorted[i].name, sorted[i].flash / 2);
+    if (flashsize) fprintf(stderr, " (%5.1f%%)", (float)(sorted[i].flash * 100) / flashsize);
+    else fprintf(stderr, "         ");
+    fprintf(stderr, "   %6d\n", sorted[i].ram);
+    sum += sorted[i].flash;
+  }
+  if (flashbytes > sum)
+    fprintf(stderr, "%-34s  %6d\n", "(startup, not attributed)", (flashbytes - sum) / 2);
+
+  fprintf(stderr, "\nSymbol                              Module              Flash [words] / Ram [bytes]\n");
+  fprintf(stderr, "----------------------------------  ------------------  ---------------------------\n");
+  for (i= 0; i < repsymanz; i++)
+  {
+    m= repsym[i].module;
+    if (repsym[i].area == 0)
+      fprintf(stderr, "%-34s  %-18s  %6d words\n", repsym[i].name, repmod[m].name, repsym[i].size / 2);
+    else
+      fprintf(stderr, "%-34s  %-18s  %6d bytes ram\n", repsym[i].name, repmod[m].name, repsym[i].size);
+  }
+  fprintf(stderr, "\n");
+}
+
+/* --------------------------------------------------
+                        rep_json
+
+     schreibt den Report als JSON in die Datei dname
+   -------------------------------------------------- */
+int rep_json(char *dname, char *device, int flashbytes, int flashsize, int rambytes, int ramsize)
+{
+  FILE *tdat;
+  int  i, m, first;
+
+  tdat= fopen(dname, "w");
+  if (!tdat) return 1;
+
+  fprintf(tdat, "{\n  \"device\": \"%s\",\n", device);
+  fprintf(tdat, "  \"flash_words\": %d,\n  \"flash_size_words\": %d,\n", flashbytes / 2, flashsize / 2);
+  fprintf(tdat, "  \"ram_bytes\": %d,\n  \"ram_size_bytes\": %d,\n", rambytes, ramsize);
+  fprintf(tdat, "  \"modules\": [\n");
+  first= 1;
+  for (i= 0; i < repmodanz; i++)
+  {
+    if ((!repmod[i].flash) && (!repmod[i].ram)) continue;
+    fprintf(tdat, "%s    { \"name\": \"%s\", \"flash_words\": %d, \"ram_bytes\": %d }",
+            first ? "" : ",\n", repmod[i].name, repmod[i].flash / 2, repmod[i].ram);
+    first= 0;
+  }
+  fprintf(tdat, "\n  ],\n  \"symbols\": [\n");
+  for (i= 0; i < repsymanz; i++)
+  {
+    m= repsym[i].module;
+    fprintf(tdat, "    { \"name\": \"%s\", \"module\": \"%s\", \"%s\": %d }%s\n",
+            repsym[i].name, repmod[m].name, repsym[i].area ? "ram_bytes" : "flash_words",
+            repsym[i].area ? repsym[i].size : repsym[i].size / 2, (i < (repsymanz-1)) ? "," : "");
+  }
+  fprintf(tdat, "  ]\n}\n");
+  fclose(tdat);
+  return 0;
+}
+
 /* ---------------------------------------------------------------------------
                                     M A I N
    --------------------------------------------------------------------------- */
@@ -297,6 +637,10 @@ int main(int argc, char **argv)
   int        ramsize;
   uint8_t    namelen;
   char       found;
+  char       report;
+  char       jsonname[256];
+  char       lkname[256];
+  int        i;
 
 
   if (argc < 3)
@@ -304,10 +648,35 @@ int main(int argc, char **argv)
     printf("\n Syntax: pfsreadhex device projectfile");
     printf("\n\n Note: enter name of projectfile WITHOUT any extensions");
     printf("\n\n     Example: pfsreadhex PFS154 myprog");
-    printf("\n\n This will analyse filenames myprog.ihx and myprog.map \n\n");
+    printf("\n\n This will analyse filenames myprog.ihx and myprog.map \n");
+    printf("\n Options (after projectfile):");
+    printf("\n     report        : flash / ram usage per module and per symbol");
+    printf("\n                     (needs myprog.lk and the .sym files of the modules)");
+    printf("\n     json=file     : write report as JSON to file");
+    printf("\n     sort=size     : sort report by size (default)");
+    printf("\n     sort=name     : sort report by name\n\n");
     return 1;
   }
 
+  report= 0;
+  jsonname[0]= 0;
+  for (i= 3; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "report")) report= 1;
+    else if (!strncmp(argv[i], "json=", 5))
+    {
+      report= 1;
+      snprintf(jsonname, sizeof(jsonname), "%s", argv[i]+5);
+    }
+    else if (!strcmp(argv[i], "sort=name")) repsort= 'n';
+    else if (!strcmp(argv[i], "sort=size")) repsort= 's';
+    else
+    {
+      printf("\n   Unknown option: %s\n\n", argv[i]);
+      return 1;
+    }
+  }
+
   strcpy(filename,argv[2]);
   strcpy(filename2, filename);
   strcat(filename,".ihx");
@@ -343,6 +712,7 @@ int main(int argc, char **argv)
 
   rambytes= mapfile_parse(&filename2[0]);
   flashbytes= readhexfile(&filename[0]);
+  if (flashbytes < 0) return 2;
 
   if (found)
   {
@@ -361,6 +731,31 @@ int main(int argc, char **argv)
     {
       fprintf(stderr,"Ram    : %d bytes used\n",rambytes);
     }
+    flashsize= 0;
+    ramsize= 0;
+  }
+
+  if (report)
+  {
+    snprintf(lkname, sizeof(lkname), "%s.lk", argv[2]);
+    if (!lkfile_parse(lkname))
+    {
+      // kein Linkerskript: nur die .sym Datei des Projekts
+      snprintf(lkname, sizeof(lkname), "%s.sym", argv[2]);
+      i= rep_findmod(argv[2]);
+      if ((i < 0) || (symfile_parse(lkname, i)))
+      {
+        fprintf(stderr,"\nReport : no %s.lk / %s.sym found, nothing to report\n", argv[2], argv[2]);
+        return 0;
+      }
+    }
+    mapfile_symbols(&filename2[0]);
+    rep_print(flashbytes, flashsize);
+    if (jsonname[0])
+    {
+      if (rep_json(jsonname, devicename, flashbytes, flashsize, rambytes, ramsize))
+        fprintf(stderr,"Report : cannot write %s\n", jsonname);
+    }
   }
   return 0;
 }
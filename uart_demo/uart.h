@@ -52,6 +52,21 @@
 
   #define uart_delfak    22               // 19200 Bd [F_CPU== 8 MHz]
 
+  /* ---------------------------------------------------------------------------
+                             Bittakt aus einem Timer
+
+      Mit uart_timer 2 bzw. 3 wird der Bittakt im blockierenden Betrieb nicht
+      aus der Warteschleife (uart_delfak), sondern aus dem 8-Bit Timer2 bzw.
+      Timer3 abgeleitet, der Teiler wird aus F_CPU und uart_baud berechnet.
+      Die Baudrate haengt dann nicht von Compiler und Optimierung ab und
+      Interrupts waehrend eines Zeichens verfaelschen das Timing nicht, mit
+      F_CPU 16 MHz sind auch 57600 und 115200 Bd moeglich. Der gewaehlte Timer
+      steht dem Projekt nicht mehr zur Verfuegung.
+     --------------------------------------------------------------------------- */
+
+  #define uart_timer     2                // 0 : Warteschleife, 2 : Timer2, 3 : Timer3
+  #define uart_baud      19200            // fuer uart_timer 2 / 3 und uart_irq 2 / 16
+
 
   /* --------------------------------------------------
                        Prototypen